@@ -0,0 +1,34 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * CPU and NUMA placement of the workers
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _AFFINITY_H
+#define _AFFINITY_H
+
+#include <stddef.h>
+#include <sched.h>
+
+#define AFFINITY_AUTO "auto" // the cpus of the device's NUMA node
+#define AFFINITY_MAX_NODES 1024
+
+int affinity_parse(const char *list, cpu_set_t *set);
+int affinity_format(const cpu_set_t *set, char *buf, size_t size);
+int affinity_dev_node(const char *path);
+int affinity_node_cpus(int node, cpu_set_t *set);
+int affinity_set_node(const cpu_set_t *set);
+int affinity_bind(void *addr, size_t len, int node);
+
+#endif
@@ -0,0 +1,49 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * User space reaping of the libaio completion ring
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _AIO_RING_H
+#define _AIO_RING_H
+
+#include <libaio.h>
+
+/*
+ * io_setup() maps the completion ring of a context at the address it
+ * returns as the context, see aio_setup_ring() in fs/aio.c. The kernel
+ * appends at tail and only reads head, so the one reaper of a context can
+ * take the completions without io_getevents() while the ring has any.
+ */
+#define AIO_RING_MAGIC 0xa10a10a1
+#define AIO_RING_INCOMPAT_FEATURES 0
+
+struct aio_ring {
+        unsigned int id;
+        unsigned int nr; // io_events entries
+        unsigned int head;
+        unsigned int tail;
+        unsigned int magic;
+        unsigned int compat_features;
+        unsigned int incompat_features;
+        unsigned int header_length;
+        struct io_event io_events[0];
+};
+
+int aio_ring_usable(io_context_t ctx);
+int aio_ring_peek(io_context_t ctx, struct io_event *events, int max);
+int aio_ring_getevents(io_context_t ctx, int use_ring, int min, int max,
+                       struct io_event *events);
+
+#endif
@@ -0,0 +1,76 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Arrival processes of the synthetic workloads
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _ARRIVAL_H
+#define _ARRIVAL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Arrival times, in ms since the start, of the requests of a synthetic
+ * trace by ticket, so they are paced like the ones of a trace file.
+ *
+ * const:IOPS                   one request every 1 / IOPS s
+ * poisson:IOPS                 exponential gaps of mean 1 / IOPS s
+ * onoff:IOPS,ON_MS,OFF_MS      poisson at IOPS for ON_MS, then nothing for
+ *                              OFF_MS, over and over
+ * mmpp:IOPS0,MS0,IOPS1,MS1     poisson at IOPS0 or IOPS1, switching to the
+ *                              other after an exponential time of mean MS0
+ *                              or MS1
+ *
+ * Apart from const, an arrival depends on the one before it, so the times
+ * are generated in order, ARRIVAL_BATCH under one lock, and the last
+ * ARRIVAL_RING of them are kept for the workers to look up.
+ */
+#define ARRIVAL_RING 4096 // a power of 2
+#define ARRIVAL_BATCH 64
+#define ARRIVAL_SEED 0xa771
+
+enum arrival_type {
+        ARRIVAL_CONST = 0,
+        ARRIVAL_POISSON,
+        ARRIVAL_ONOFF,
+        ARRIVAL_MMPP,
+};
+
+struct arrival_slot {
+        long long ticket; // -1 while it is rewritten
+        double time; // in ms
+};
+
+struct arrival {
+        int type;
+        double rate[2]; // requests per ms in either state
+        double dwell[2]; // ms in either state, the mean of mmpp
+
+        pthread_mutex_t lock;
+        long long next; // the first ticket not generated yet
+        double clock; // the last arrival
+        double state_end;
+        int state;
+        uint64_t rand[2];
+        double evicted; // the last arrival out of the ring
+        struct arrival_slot *ring;
+};
+
+struct arrival *arrival_create(const char *spec, uint64_t seed);
+double arrival_time(struct arrival *arrival, long long ticket);
+int arrival_format(const struct arrival *arrival, char *buf, int len);
+void arrival_destroy(struct arrival *arrival);
+
+#endif
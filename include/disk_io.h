@@ -19,5 +19,7 @@
 #define _DISK_IO_H
 int disk_open(const char *dev, int flag);
 void disk_close(int fd);
+int file_prepare(const char *path, long long size, int prewrite, int *flags,
+                 long long *capacity);
 
 #endif
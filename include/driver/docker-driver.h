@@ -78,7 +78,14 @@
                 "\t\tname: %s\n"                                               \
                 "\t\ttrace_replay_path: %s\n"                                  \
                 "\t\ttrace_data_path: %s\n"                                    \
-                "\t\tdevice: %s\n"                                             \
+                "\t\tdevice: %s (devno_map: %s)\n"                             \
+                "\t\tfile: %s (file_size: %u, prewrite: %u)\n"                 \
+                "\t\tengine: %s (sqpoll: %u, iopoll: %u)\n"                    \
+                "\t\thist_log: %u (io_log: %u)\n"                              \
+                "\t\tcpus: %s\n"                                               \
+                "\t\tskew: %s\n"                                               \
+                "\t\tarrival: %s\n"                                            \
+                "\t\trate_limit: %s (thread: %s)\n"                            \
                 "\t\tglobal_config: %p\n"                                      \
                 "\t\tnext: %p\n",                                              \
                 (info), (info)->pid, (info)->time, (info)->q_depth,            \
@@ -88,6 +95,12 @@
                 (info)->prefix_cgroup_name, (info)->scheduler,                 \
                 (info)->cgroup_id, (info)->trace_replay_path,                  \
                 (info)->trace_data_path, (info)->device,                       \
+                (info)->devno_map, (info)->file, (info)->file_size,            \
+                (info)->prewrite,                                              \
+                (info)->engine, (info)->sqpoll, (info)->iopoll,                \
+                (info)->hist_log, (info)->io_log,                              \
+                (info)->cpus, (info)->skew, (info)->arrival,                   \
+                (info)->rate_limit, (info)->thread_rate_limit,                 \
                 (info)->global_config, (info)->next);
 #endif
 
@@ -148,15 +161,35 @@ struct docker_info {
         unsigned int wss; /**< Working set size. */
         unsigned int utilization; /**< utilization of task. */
         unsigned int iosize; /**< I/O size of task. */
+        unsigned int
+                sqpoll; /**< Use the kernel submission polling thread (`io_uring` only). */
+        unsigned int
+                iopoll; /**< Use the polled I/O completion (`io_uring` only). */
+        unsigned int
+                hist_log; /**< Log the latency histograms of every second to `<result>.hist`. */
+        unsigned int
+                io_log; /**< Log one in `io_log` completions to `<result>.io`. 0 means no log. */
+        unsigned int
+                file_size; /**< Size of the `file` in MB. 0 means the size of the existing file. */
+        unsigned int
+                prewrite; /**< Write the whole `file` once before the replay. */
 
         char prefix_cgroup_name
                 [NAME_MAX]; /**< Cgroup prefix which will be made inside of `/sys/fs/cgroup/blkio` */
         char device[NAME_MAX]; /**< Device name.(e.g. sda, sdb) WARNING, you must not contain the `/dev/` */
+        char devno_map[NAME_MAX]; /**< Devices of the trace's devnos(e.g. 1:sdc,2:sdd) without the `/dev/`. The other devnos go to `device`. Empty means all of them go to `device`. */
+        char file[PATH_MAX]; /**< File on a filesystem which is replayed on instead of `device`(e.g. /mnt/xfs/c1.dat). A directory gets a file of each task named by its `cgroup_id`. `device` is still the one of the scheduler. */
         char scheduler[NAME_MAX]; /**< Scheduler name(e.g. none, bfq, kyber). */
         char cgroup_id
                 [NAME_MAX]; /**< Current cgroup name. This value must be unique. */
         char trace_replay_path[PATH_MAX]; /**< `trace-replay` binary path */
         char trace_data_path[PATH_MAX]; /**< `trace-replay` trace data path */
+        char engine[NAME_MAX]; /**< I/O engine of `trace-replay`(e.g. libaio, io_uring). Empty means the default engine. */
+        char cpus[NAME_MAX]; /**< CPU list of the `trace-replay` workers(e.g. 0-7,16), `auto` for the device's NUMA node. Empty means not pinned. */
+        char skew[NAME_MAX]; /**< Parameters of a skewed synthetic workload(e.g. 0.99 for zipf, 20,80 for hotspot). Empty means the defaults. */
+        char arrival[NAME_MAX]; /**< Arrival process of a synthetic workload(e.g. poisson:5000, onoff:5000,100,900). Empty means as fast as possible. */
+        char rate_limit[NAME_MAX]; /**< Token bucket of the whole task(e.g. 5000:32,200:4 for 5000 IOPS in bursts of 32 and 200MB/s in bursts of 4MB). Empty means no limit. */
+        char thread_rate_limit[NAME_MAX]; /**< Token bucket of each `trace-replay` thread, in the format of `rate_limit`. Empty means no limit. */
 
         void *global_config; /**< runner's global_config information */
         struct docker_info *next; /**< Contain the next `docker_info` pointer */
@@ -0,0 +1,82 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Binary log of the latency histograms over time
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _HIST_LOG_H
+#define _HIST_LOG_H
+
+#include <stdint.h>
+
+#include <latency_hist.h>
+
+/*
+ * An append-only file of histogram deltas, one record per trace and report
+ * interval. The file starts with a struct hist_log_header and every record
+ * is a varint length followed by that many bytes of varints:
+ *
+ *   trace, time delta (us), nr_buckets, then nr_buckets pairs of
+ *   (bucket index delta, count delta)
+ *
+ * Only the buckets which changed since the last record of the trace are
+ * written, with their index relative to the previous one, so a record is a
+ * few bytes per bucket in use whatever the IOPS. A zero length (the unused
+ * end of the mapping) ends the log.
+ */
+#define HIST_LOG_MAGIC "TRHIST\r\n"
+#define HIST_LOG_VERSION 1
+#define HIST_LOG_GROW (1024 * 1024) // bytes mapped at a time
+#define HIST_LOG_VARINT_MAX 10
+
+struct hist_log_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t sub_bits; // HIST_SUB_BITS of the writer
+        uint32_t max_bits; // HIST_MAX_BITS of the writer
+        uint32_t nr_trace;
+        uint64_t start_time; // us since the epoch
+};
+
+struct hist_log {
+        int fd;
+        int nr_trace;
+        unsigned char *map;
+        size_t map_size;
+        size_t len; // bytes written
+        unsigned long long last_us; // time of the last record
+        unsigned char *record; // scratch of the largest record
+        struct latency_hist *last; // per trace, as of its last record
+};
+
+struct hist_log_reader {
+        const unsigned char *map;
+        size_t size;
+        size_t pos;
+        int nr_trace;
+        unsigned long long start_time; // us since the epoch
+        unsigned long long time_us; // of the last record read
+};
+
+struct hist_log *hist_log_create(const char *path, int nr_trace);
+int hist_log_append(struct hist_log *log, int trace, unsigned long long now_us,
+                    const struct latency_hist *hist);
+void hist_log_close(struct hist_log *log);
+
+int hist_log_open(struct hist_log_reader *reader, const char *path);
+int hist_log_next(struct hist_log_reader *reader, int *trace,
+                  struct latency_hist *delta);
+void hist_log_reader_close(struct hist_log_reader *reader);
+
+#endif
@@ -0,0 +1,122 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Per-I/O completion log with a writer thread
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _IO_LOG_H
+#define _IO_LOG_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Every worker puts a record of each completion (or of one in sample) into
+ * a ring of its own, and a writer thread moves the rings to the file in
+ * IO_LOG_BUF_SIZE blocks, with O_DIRECT where the file system has it. The
+ * worker never waits: a record which finds its ring full is dropped and
+ * counted.
+ *
+ * The file is a IO_LOG_HEADER_SIZE block holding a struct io_log_header
+ * and then the records, in order for every thread.
+ */
+#define IO_LOG_MAGIC "TRIOLOG\n"
+#define IO_LOG_VERSION 2
+#define IO_LOG_HEADER_SIZE 4096
+#define IO_LOG_ALIGN 4096
+#define IO_LOG_RING 8192 // records per worker, a power of 2
+#define IO_LOG_BUF_SIZE (1024 * 1024)
+#define IO_LOG_POLL_US 1000
+
+struct io_log_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t rec_size;
+        uint32_t nr_thread;
+        uint32_t per_thread; // thread / per_thread is the trace
+        uint32_t sample; // 1 in sample completions is logged
+        uint32_t reserved;
+        uint64_t start_time; // us since the epoch, the ns below count from it
+};
+
+struct io_log_rec {
+        uint64_t submit_ns; // since the replay start
+        uint64_t complete_ns;
+        int64_t offset; // in bytes
+        uint32_t bytes;
+        uint16_t thread : 12; // below MAX_THREADS
+        uint16_t dev : 4; // index in the devices of the trace, below MAX_DEVS
+        uint16_t depth : 14; // in flight at the submission, this one included
+        uint16_t read : 1;
+        uint16_t error : 1;
+};
+
+struct io_log_ring {
+        struct io_log_rec *recs;
+        int sample;
+        int sample_left; // worker only
+        unsigned long long nr_dropped; // worker only
+        unsigned long long head __attribute__((aligned(64))); // worker
+        unsigned long long tail __attribute__((aligned(64))); // writer
+};
+
+struct io_log {
+        int fd;
+        int nr_thread;
+        struct io_log_ring *rings;
+        char *buf; // IO_LOG_BUF_SIZE, aligned for O_DIRECT
+        size_t buf_len;
+        long long offset; // of buf in the file
+        long long nr_written; // records
+        int error;
+        int stop;
+        pthread_t writer;
+};
+
+struct io_log_reader {
+        const struct io_log_header *header;
+        const struct io_log_rec *recs;
+        long long nr_recs;
+        size_t size;
+};
+
+/* worker side, rec->thread names the ring */
+static inline void io_log_record(struct io_log *log,
+                                 const struct io_log_rec *rec)
+{
+        struct io_log_ring *ring = &log->rings[rec->thread];
+        unsigned long long head = ring->head;
+
+        if (ring->sample > 1) {
+                if (--ring->sample_left)
+                        return;
+                ring->sample_left = ring->sample;
+        }
+        if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >=
+            IO_LOG_RING) {
+                ring->nr_dropped++;
+                return;
+        }
+        ring->recs[head & (IO_LOG_RING - 1)] = *rec;
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+struct io_log *io_log_create(const char *path, int nr_thread, int per_thread,
+                             int sample);
+void io_log_close(struct io_log *log);
+
+int io_log_open(struct io_log_reader *reader, const char *path);
+void io_log_reader_close(struct io_log_reader *reader);
+
+#endif
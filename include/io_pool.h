@@ -0,0 +1,58 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Per-thread io_job and I/O buffer pool
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _IO_POOL_H
+#define _IO_POOL_H
+
+#include <sys/uio.h>
+#include <trace_replay.h>
+
+/* buffer class k holds (PAGE_SIZE << k) bytes, up to MAX_BYTES */
+#define IO_POOL_MAX_CLASSES 19
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+struct io_pool_class {
+        char *arena;
+        size_t arena_size;
+        size_t buf_size;
+        int hugepage;
+        int nr_carved;
+        int nr_free;
+        char **free_bufs;
+};
+
+struct io_pool {
+        int nr_jobs;
+        struct io_job *jobs;
+        struct io_job **free_jobs;
+        int nr_free_jobs;
+
+        int nr_classes;
+        struct io_pool_class classes[IO_POOL_MAX_CLASSES];
+};
+
+int io_pool_class(size_t bytes);
+struct io_pool *io_pool_create(int nr_jobs, size_t max_bytes, int hugepage);
+struct io_job *io_pool_get_job(struct io_pool *pool);
+void io_pool_put_job(struct io_pool *pool, struct io_job *job);
+char *io_pool_get_buf(struct io_pool *pool, size_t bytes, int *buf_class);
+void io_pool_put_buf(struct io_pool *pool, char *buf, int buf_class);
+int io_pool_iovecs(struct io_pool *pool, struct iovec *iov, int max);
+int io_pool_bind(struct io_pool *pool, int node);
+void io_pool_destroy(struct io_pool *pool);
+
+#endif
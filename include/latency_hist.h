@@ -0,0 +1,80 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Log-linear latency histogram
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _LATENCY_HIST_H
+#define _LATENCY_HIST_H
+
+/*
+ * Values (in ns) below 2 * HIST_SUB_COUNT get a bucket each. Every
+ * following power of two is split into HIST_SUB_COUNT buckets, so the
+ * relative error stays below 1 / HIST_SUB_COUNT (0.8%) up to
+ * 2^HIST_MAX_BITS ns (about 37 minutes). Larger values land in the last
+ * bucket.
+ */
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 41
+#define HIST_NR_BUCKETS                                                        \
+        (2 * HIST_SUB_COUNT +                                                  \
+         (HIST_MAX_BITS - HIST_SUB_BITS - 1) * HIST_SUB_COUNT)
+
+struct latency_hist {
+        unsigned long long total_count;
+        unsigned long long counts[HIST_NR_BUCKETS];
+};
+
+static inline int latency_hist_index(unsigned long long value)
+{
+        int shift;
+        int index;
+
+        if (value < 2 * HIST_SUB_COUNT)
+                return (int)value;
+
+        shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+        index = 2 * HIST_SUB_COUNT + (shift - 1) * HIST_SUB_COUNT +
+                (int)((value >> shift) - HIST_SUB_COUNT);
+        if (index >= HIST_NR_BUCKETS)
+                index = HIST_NR_BUCKETS - 1;
+        return index;
+}
+
+/*
+ * Only the owner thread records. The reporter reads the counters without
+ * a lock, so each one is a plain relaxed load/store instead of an RMW.
+ */
+static inline void latency_hist_record(struct latency_hist *hist,
+                                       unsigned long long value)
+{
+        unsigned long long *count = &hist->counts[latency_hist_index(value)];
+
+        __atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&hist->total_count,
+                         __atomic_load_n(&hist->total_count, __ATOMIC_RELAXED) +
+                                 1,
+                         __ATOMIC_RELAXED);
+}
+
+unsigned long long latency_hist_value(int index);
+void latency_hist_reset(struct latency_hist *hist);
+void latency_hist_merge(struct latency_hist *dst,
+                        const struct latency_hist *src);
+unsigned long long latency_hist_percentile(const struct latency_hist *hist,
+                                           double percentile);
+
+#endif
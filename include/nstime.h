@@ -0,0 +1,93 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Monotonic nanosecond clock
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _NSTIME_H
+#define _NSTIME_H
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define NSTIME_HAVE_TSC
+#endif
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+/*
+ * Every timestamp of the replay is an integer ns of CLOCK_MONOTONIC_RAW,
+ * which NTP does not slew. nstime_init(1) switches to the TSC when it is
+ * invariant, calibrated against CLOCK_MONOTONIC_RAW, so a timestamp is a
+ * single rdtsc instead of a vDSO call.
+ */
+#define NSTIME_TSC_SHIFT 32
+#define NSTIME_CALIBRATE_NS (20 * NSEC_PER_MSEC)
+
+struct nstime_tsc {
+        int enabled;
+        unsigned long long base_tsc;
+        unsigned long long base_ns;
+        unsigned long long mult; // ns per cycle << NSTIME_TSC_SHIFT
+};
+
+extern struct nstime_tsc nstime_tsc;
+
+static inline unsigned long long nstime_raw(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (unsigned long long)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline unsigned long long nstime_now(void)
+{
+#ifdef NSTIME_HAVE_TSC
+        if (nstime_tsc.enabled) {
+                unsigned long long delta = __rdtsc() - nstime_tsc.base_tsc;
+
+                return nstime_tsc.base_ns +
+                       (unsigned long long)(((unsigned __int128)delta *
+                                             nstime_tsc.mult) >>
+                                            NSTIME_TSC_SHIFT);
+        }
+#endif
+        return nstime_raw();
+}
+
+/* seconds between two timestamps, for the reports */
+static inline double nstime_sec(unsigned long long start,
+                                unsigned long long end)
+{
+        return end > start ? (double)(end - start) / NSEC_PER_SEC : 0.0;
+}
+
+static inline void nstime_relax(void)
+{
+#ifdef NSTIME_HAVE_TSC
+        _mm_pause();
+#endif
+}
+
+int nstime_init(int use_tsc);
+const char *nstime_source(void);
+void nstime_monotonic(unsigned long long deadline, unsigned long long early,
+                      struct timespec *ts);
+void nstime_sleep_until(unsigned long long deadline,
+                        unsigned long long spin_ns);
+
+#endif
@@ -0,0 +1,52 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Write payloads of a given compressibility and dedupe ratio
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _PAYLOAD_H
+#define _PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Every PAYLOAD_BLOCK of a write starts with a 16 byte stamp, and of the
+ * rest the first (100 - compress)% is random and the others are zeros. A
+ * unique block has a stamp nobody else has, a duplicate is one of the
+ * PAYLOAD_DUP_BLOCKS blocks of the pool, the same in every worker.
+ */
+#define PAYLOAD_BLOCK 4096
+#define PAYLOAD_STAMP 16
+#define PAYLOAD_DUP_BLOCKS 1024
+#define PAYLOAD_REFILL 16 // writes between new random data in a buffer
+#define PAYLOAD_SEED 0x5eed
+
+struct payload {
+        char *pool; // PAYLOAD_DUP_BLOCKS blocks
+        int compress; // % of every block which is zeros
+        int dedupe; // % of the blocks which are duplicates
+        int refill;
+        size_t random_bytes; // per block, after the stamp
+        uint64_t id; // in the top bits of the unique stamps
+        uint64_t seq;
+        uint64_t nr_fills;
+        uint64_t rand[2];
+};
+
+struct payload *payload_create(int id, int compress, int dedupe, int refill);
+void payload_fill(struct payload *payload, char *buf, size_t bytes);
+void payload_destroy(struct payload *payload);
+
+#endif
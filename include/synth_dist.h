@@ -0,0 +1,73 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Skewed spatial distributions of the synthetic workloads
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _SYNTH_DIST_H
+#define _SYNTH_DIST_H
+
+#include <stdint.h>
+
+/*
+ * Picks which of n io_size items of the working set a synthetic request
+ * goes to, in O(1) per sample and from the request's ticket alone, so the
+ * workers need no shared state and a seed gives the same sequence again.
+ *
+ * rand: ticket t is item synth_perm(t % n) of a Feistel permutation keyed
+ *       by the seed and the repeat t / n, every item once per repeat
+ *
+ * The skewed ones draw a rank, 0 being the most popular item, which is
+ * spread over the working set by a stride coprime with n so the hot items
+ * are not all next to each other.
+ *
+ * zipf: P(rank k) ~ 1 / (k + 1)^theta, by rejection-inversion
+ *       (Hormann and Derflinger), theta > 0, default 0.99
+ * pareto: a Pareto of shape alpha bounded to [1, n + 1), default 1.16,
+ *         the 80/20 rule
+ * hotspot: ACCESS% of the requests go uniformly to the first HOT% of the
+ *          ranks, the others to the rest, default 20,80
+ */
+#define SYNTH_SEED 0x5eed5eed // plus the trace index
+#define SYNTH_PERM_ROUNDS 4
+
+enum synth_dist_type {
+        SYNTH_UNIFORM = 0,
+        SYNTH_ZIPF,
+        SYNTH_PARETO,
+        SYNTH_HOTSPOT,
+};
+
+struct synth_dist {
+        int type;
+        long long n;
+        double param[2];
+        double h_x1, h_n, s; // zipf
+        double pareto_c; // 1 - (n + 1)^-alpha
+        long long hot; // hotspot items
+        long long stride;
+        int perm_bits; // of a half of the Feistel network
+        uint64_t seed;
+};
+
+int synth_dist_type(const char *name, const char **op);
+int synth_dist_init(struct synth_dist *dist, int type, long long n,
+                    const char *param, uint64_t seed);
+uint64_t synth_perm(uint64_t x, uint64_t n, int half_bits, uint64_t key);
+uint64_t synth_dist_hash(const struct synth_dist *dist, long long ticket);
+long long synth_dist_rank(const struct synth_dist *dist, long long ticket);
+long long synth_dist_item(const struct synth_dist *dist, long long ticket);
+int synth_dist_format(const struct synth_dist *dist, char *buf, int len);
+
+#endif
@@ -0,0 +1,53 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Token bucket rate limits of the dispatch
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _TOKEN_BUCKET_H
+#define _TOKEN_BUCKET_H
+
+/*
+ * A token bucket kept as the time it is full again (GCRA), in ns since the
+ * start, so taking and returning tokens is a CAS or an add and the workers
+ * of a trace can share one.
+ *
+ * A rate limit is "IOPS[:BURST][,MBPS[:BURST_MB]]", 0 for no limit on
+ * either, with bursts of 1ms of the rate by default. The requests are
+ * counted before they are claimed, so a batch never takes more than the
+ * bucket holds. Their bytes are only known afterwards and are charged
+ * then, so a batch may go beyond the burst and the next one waits it off.
+ */
+#define RATE_LIMIT_BURST_NS 1000000
+
+struct token_bucket {
+        long long full; // ns, the bucket is full from then on
+        double ns_per_token; // 0 without a limit
+        long long burst_ns; // the size of the bucket
+};
+
+struct rate_limit {
+        struct token_bucket iops __attribute__((aligned(64)));
+        struct token_bucket bytes __attribute__((aligned(64)));
+};
+
+struct rate_limit *rate_limit_create(const char *spec);
+long long rate_limit_delay(struct rate_limit *limit, long long now);
+int rate_limit_take(struct rate_limit *limit, long long now, int want);
+void rate_limit_done(struct rate_limit *limit, long long now, int unused,
+                     long long bytes);
+int rate_limit_format(const struct rate_limit *limit, char *buf, int len);
+void rate_limit_destroy(struct rate_limit *limit);
+
+#endif
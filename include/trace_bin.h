@@ -0,0 +1,58 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Binary trace format
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _TRACE_BIN_H
+#define _TRACE_BIN_H
+
+#include <trace_replay.h>
+
+/*
+ * A binary trace is a trace_bin_header followed by nr_records packed
+ * struct trace_io_req, so the records can be mmap()ed as trace_buf as is.
+ * The records are already trimmed with the overlap window in the header.
+ * A text trace leaves a cache of itself at <path>.trbin, which is valid
+ * while the size and mtime of the text trace match src_size/src_mtime.
+ */
+#define TRACE_BIN_MAGIC "TRACEBIN"
+#define TRACE_BIN_MAGIC_LEN 8
+#define TRACE_BIN_VERSION 1
+#define TRACE_BIN_SUFFIX ".trbin"
+
+struct trace_bin_header {
+        char magic[TRACE_BIN_MAGIC_LEN];
+        unsigned int version;
+        unsigned int record_size;
+        long long nr_records;
+        long long window; // overlap trimming window, 0 for raw records
+        long long src_size; // text trace size, 0 if not a cache
+        long long src_mtime; // text trace mtime in ns, 0 if not a cache
+        char reserved[16];
+};
+
+int trace_bin_probe(const char *path);
+int trace_bin_map(const char *path, struct trace_bin_header *hdr, void **map,
+                  size_t *map_size);
+struct trace_io_req *trace_bin_records(void *map);
+void trace_bin_unmap(void *map, size_t map_size);
+void trace_bin_header_init(struct trace_bin_header *hdr, long long nr_records,
+                           long long window, long long src_size,
+                           long long src_mtime);
+int trace_bin_write(const char *path, const struct trace_io_req *reqs,
+                    long long nr_records, long long window, long long src_size,
+                    long long src_mtime);
+
+#endif
@@ -0,0 +1,58 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Interval index of the overlap trimming window
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _TRACE_INDEX_H
+#define _TRACE_INDEX_H
+
+#include <trace_replay.h>
+
+/*
+ * The last `window` requests of a trace, kept in a treap ordered by
+ * (devno, first sector) and augmented with the largest last sector of each
+ * subtree. Request seq lives in buf[seq & mask] of the caller and in
+ * nodes[seq % window] here, so adding a request drops the one which left
+ * the window.
+ */
+struct trace_index_node {
+        long long lo; // extent as a closed range, [blkno, blkno + bcount]
+        long long hi;
+        long long max_hi;
+        long long seq;
+        unsigned int prio;
+        int devno;
+        int left;
+        int right;
+        int used;
+};
+
+struct trace_index {
+        struct trace_index_node *nodes;
+        long long *found;
+        int window;
+        int root;
+        unsigned int seed;
+};
+
+struct trace_index *trace_index_create(int window);
+void trace_index_reset(struct trace_index *index);
+int trace_index_trim(struct trace_index *index, struct trace_io_req *buf,
+                     long long mask, struct trace_io_req *req);
+void trace_index_add(struct trace_index *index, long long seq,
+                     const struct trace_io_req *req);
+void trace_index_destroy(struct trace_index *index);
+
+#endif
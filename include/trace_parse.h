@@ -0,0 +1,38 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * DiskSim ascii trace parser
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _TRACE_PARSE_H
+#define _TRACE_PARSE_H
+
+#include <trace_replay.h>
+
+/*
+ * A line is "arrival_time devno blkno bcount flags" as read by
+ * sscanf("%lf %d %lld %d %x"). The common forms are parsed by hand, anything
+ * else (exponents, overflowing numbers, ...) goes through sscanf so the
+ * results stay the same.
+ */
+#define TRACE_PARSE_MAX_THREADS 64
+#define TRACE_PARSE_MIN_CHUNK (4 * 1024 * 1024) // bytes per thread
+
+int trace_parse_line(const char *line, const char *end,
+                     struct trace_io_req *req);
+const char *trace_parse_eol(const char *p, const char *end);
+long long trace_parse_count_lines(const char *p, const char *end);
+int trace_parse_fd(struct trace_info_t *trace, int fd, int nr_threads);
+
+#endif
@@ -32,7 +32,12 @@
 #define GB (1024 * 1024 * 1024)
 #define MAX_QDEPTH (128 * 16)
 #define MAX_THREADS 512
+#define MAX_DEVS 16 // distinct devices of a replay
+#define MAX_TRACE_DEVS 8 // default device and devno map of a trace
+#define DEVNO_ANY (-1) // the devnos the map of a trace leaves out
 #define STR_SIZE 128
+#define PACE_SPIN_US 20 // spun before each arrival, see wait_arrive()
+#define LAG_THRESHOLD_US 1000 // lag tolerated before the lag policy acts
 
 #ifndef PAGE_SIZE
 #define PAGE_SIZE 4096
@@ -43,12 +48,60 @@
 
 #define PAGE_TO_MB(x) (x * PAGE_SIZE / MB)
 
+enum io_engine_type { IO_ENGINE_LIBAIO = 0, IO_ENGINE_URING };
+
+/* what make_jobs() does with requests claimed later than LAG_THRESHOLD_US */
+enum lag_policy_type {
+        LAG_BURST = 0, // issue them all at once
+        LAG_SHIFT, // move the rest of the trace back by the lag
+        LAG_DROP, // skip them
+        LAG_RATE, // issue them at lag_rate per second
+};
+
+/*
+ * A device of a trace: its requests with devno go there, to the part of
+ * the device the trace got. The part is the same for every devno a trace
+ * maps to one device.
+ */
+struct trace_dev {
+        int devno; // DEVNO_ANY for the default device
+        int dev; // index in the devices of the replay
+        long long start_partition; // in bytes
+        long long total_pages;
+};
+
+/* counted by the worker, read once it is done */
+struct dev_stat {
+        unsigned long long nr_ios;
+        unsigned long long total_bytes;
+        unsigned long long total_rbytes;
+        unsigned long long total_wbytes;
+        unsigned long long error_bytes;
+        unsigned long long latency_sum;
+        unsigned long long latency_min;
+        unsigned long long latency_max;
+};
+
+#define URING_SQPOLL 0x1
+#define URING_IOPOLL 0x2
+#define URING_REAPER 0x4 // a thread of its own reaps the completions
+
+struct uring_io;
+struct io_pool;
+struct latency_hist;
+struct trace_stream;
+struct trace_index;
+struct synth_dist;
+struct arrival;
+struct rate_limit;
+
+/* written by one worker only, see io_stat_read(), times in ns */
 struct io_stat_t {
-        pthread_spinlock_t stat_lock;
-        double latency_sum;
-        double latency_sum_sqr;
-        double latency_min;
-        double latency_max;
+        unsigned int seq;
+        unsigned long long latency_sum;
+        double latency_sum_sqr; // ns^2 overflows 64 bits
+        unsigned long long latency_min;
+        unsigned long long latency_max;
         unsigned int latency_count;
         unsigned long long total_operations;
         unsigned long long total_bytes;
@@ -58,36 +111,58 @@ struct io_stat_t {
         unsigned long long cur_rbytes;
         unsigned long long cur_wbytes;
         unsigned long long total_error_bytes;
-        struct timeval start_time, end_time;
-        double execution_time;
+        unsigned long long start_time, end_time;
+        unsigned long long execution_time;
         int trace_repeat_count;
-        double time_diff;
+        unsigned long long time_diff;
         unsigned int time_diff_cnt;
-};
+        unsigned long long queue_delay; // submission - arrival
+        unsigned int queue_delay_cnt;
+        unsigned long long lag; // behind the trace at the last claim
+        unsigned long long lag_max;
+        unsigned long long nr_lag_dropped;
+        unsigned long long nr_lag_shifted;
+        unsigned long long nr_verified; // stamped sectors read back
+        unsigned long long nr_verify_errors; // of those, the bad ones
+        unsigned long long token_wait; // ns held back by the rate limits
+        unsigned long long nr_token_waits;
+} __attribute__((aligned(64)));
 
 struct trace_io_req {
 #if 0
 	char line[201];
 #else
-        double arrival_time;
-        int devno;
-        int blkno;
-        int bcount;
-        int flags;
+        double arrival_time; // in ms
+        long long blkno; // in sectors
+        int bcount; // in sectors
+        short devno; // the parser rejects what does not fit
+        short flags; // 16 bits of them, nonzero for a read
 #endif
 };
 
 struct trace_info_t {
-        pthread_spinlock_t trace_lock;
-        FILE *trace_fp;
+        /* shared by the per_thread workers, see trace_io_claim() */
+        long long trace_ticket __attribute__((aligned(64)));
+        long long trace_ticket_end __attribute__((aligned(64)));
+        long long lag_shift __attribute__((aligned(64))); // ns, LAG_SHIFT
+        long long lag_next; // next catch-up slot in ns, LAG_RATE
+
+        FILE *trace_fp __attribute__((aligned(64)));
         int trace_buf_size;
         struct trace_io_req *trace_buf;
         int trace_io_cnt;
-        int trace_io_cur;
-        int trace_io_issue_count;
+        void *trace_map; // mmap()ed binary trace backing trace_buf
+        size_t trace_map_size;
+        struct trace_stream *stream; // streaming loader, NULL when loaded
+        int trace_window; // overlap trimming window in requests
+        struct trace_index *trace_index; // the window while loading
+        long long trace_src_size; // text trace size, keys the cache
+        long long trace_src_mtime; // text trace mtime in ns
         char tracename[STR_SIZE];
-        char filename[STR_SIZE];
+        char filename[STR_SIZE]; // the default device
         int fd;
+        struct trace_dev devs[MAX_TRACE_DEVS]; // devs[0] is the default
+        int nr_devs;
         int synthetic;
         long long wanted_io_count;
         int utilization; // % Percent
@@ -100,8 +175,13 @@ struct trace_info_t {
         int synth_read;
         int synth_write;
         int synth_mixed;
+        int synth_dist; // enum synth_dist_type
+        char synth_skew[STR_SIZE]; // distribution and parameters, zipf:0.99
+        struct synth_dist *synth; // generates the requests, no trace_buf
+        char synth_arrival[STR_SIZE]; // arrival process, poisson:5000
+        struct arrival *arrival; // NULL as fast as possible
+        struct rate_limit *rate_limit; // shared by the workers, NULL for none
 
-        int trace_repeat_count;
         int trace_repeat_num;
         long long total_capacity;
         long long total_pages;
@@ -109,7 +189,13 @@ struct trace_info_t {
         long long start_partition;
         long long start_page;
         double trace_timescale;
+        double trace_period; // ms a repeat adds to the arrivals, 0 for none
         double timeout;
+        size_t max_bytes; // largest request in bytes
+        unsigned int buf_classes; // bit k when a request needs io_pool class k
+
+        char cpus[STR_SIZE]; // cpulist of the workers, empty when not pinned
+        int numa_node; // of the I/O buffers, -1 when not bound
 };
 
 struct thread_info_t {
@@ -118,34 +204,55 @@ struct thread_info_t {
         //	struct flist_head queue;
         pthread_mutex_t mutex;
         pthread_cond_t cond_main, cond_sub;
+        int engine;
         io_context_t io_ctx;
         struct io_event events[MAX_QDEPTH];
+        struct uring_io *uring;
+        int aio_ring; // reap from the mapped completion ring first
+        int efd; // completion eventfd of the completer, -1 without
 
         int queue_depth;
         int queue_count;
         int active_count;
-        int fd;
+        int fd; // of the default device, fds[0]
+        int fds[MAX_TRACE_DEVS]; // one per trace->devs
         int fsync_period;
 
-        struct io_job *th_jobs[MAX_QDEPTH];
-        void *th_buf[MAX_QDEPTH];
-        int buf_cur;
+        struct io_pool *pool;
+        struct payload *payload; // write contents, NULL leaves them as is
+        struct rate_limit *rate_limit; // of this worker alone, NULL for none
+        unsigned int verify_generation; // writes stamped by this worker
 
         struct io_stat_t io_stat;
+        struct io_stat_t io_stat_last; // previous report, reporter only
+        struct latency_hist *lat_hist; // in ns, owned by this thread
+        struct latency_hist *pace_hist; // submission - arrival in ns
+        struct dev_stat dev_stat[MAX_TRACE_DEVS]; // one per trace->devs
 
         struct trace_info_t *trace;
 
+        /* open loop or completer, the reaper hands the completions back */
+        pthread_t reaper;
+        struct flist_head done_list;
+        long long nr_submitted;
+        int stop;
+
         int done;
-};
+} __attribute__((aligned(64)));
 
 struct io_job {
         struct iocb iocb;
         struct flist_head list;
-        struct timeval start_time, stop_time;
+        unsigned long long start_time, stop_time; // nstime_now()
+        unsigned long long due_time; // arrival, 0 when not paced
         long long offset; // in bytes
         size_t bytes;
         int rw; // is read
+        int depth; // in flight at the submission, this one included
+        int dev; // index in the devs of the trace
         char *buf;
+        int buf_class; // pool buffer class, -1 if not from the pool
+        long res;
 };
 
 #define BASE_KEY_PATHNAME_LEN PATH_MAX
@@ -166,6 +273,10 @@ struct realtime_log {
         double cur_bw;
         double lat;
         double time_diff;
+        double lag; // s behind the trace
+        unsigned long long nr_lag_dropped;
+        unsigned long long nr_lag_shifted;
+        unsigned long long nr_verify_errors; // bad sectors read
 };
 
 struct realtime_msg {
@@ -178,6 +289,12 @@ struct trace {
         double total_size; // in GB
         long long start_page;
         long long total_pages;
+        char cpus[STR_SIZE]; // cpulist of the workers, empty when not pinned
+        int numa_node; // of the I/O buffers, -1 when not bound
+        char rate_limit[STR_SIZE]; // of the trace, empty without one
+        char thread_rate_limit[STR_SIZE]; // of each of its workers
+        char device[STR_SIZE]; // the default one
+        char devno_map[STR_SIZE]; // devno:device,.., empty without one
 };
 
 struct config {
@@ -186,6 +303,7 @@ struct config {
         int nr_trace;
         int nr_thread;
         int per_thread;
+        int nr_dev;
         char result_file[201];
         struct trace traces[MAX_THREADS];
 };
@@ -195,6 +313,8 @@ struct synthetic {
         int utilization; // % Percent
         int touched_working_set_size; // in MB
         int io_size; // in KB
+        char distribution[STR_SIZE]; // of the blocks, zipf:0.99
+        char arrival[STR_SIZE]; // process, none or poisson:5000
 };
 
 struct trace_stat {
@@ -203,6 +323,23 @@ struct trace_stat {
         double avg_lat_var;
         double lat_min;
         double lat_max;
+        double lat_p50;
+        double lat_p99;
+        double lat_p999;
+        double lat_p9999;
+        double pace_err_p50; // submission - arrival
+        double pace_err_p99;
+        double pace_err_p999;
+        double pace_err_p9999;
+        double avg_queue_delay; // submission - arrival
+        double lag_max; // s behind the trace
+        double lag_shift; // s the trace was moved back by
+        double nr_lag_dropped;
+        double nr_lag_shifted;
+        double nr_verified; // stamped sectors read back
+        double nr_verify_errors;
+        double token_wait; // s held back by the rate limits, of all workers
+        double nr_token_waits;
         double iops;
         double total_bw; // MB/s
         double read_bw; // MB/s
@@ -210,6 +347,7 @@ struct trace_stat {
         double total_traffic; // in MB
         double read_traffic; // in MB
         double write_traffic; // in MB
+        double error_traffic; // failed or bad, in MB
         double read_ratio; // % Percent
         double total_avg_req_size; // in KB
         double read_avg_req_size; // in KB
@@ -231,8 +369,15 @@ struct aggr_result {
         struct trace_stat stats;
 };
 
+/* only the latencies (no percentiles), bandwidths and sizes are set */
+struct dev_result {
+        char name[STR_SIZE];
+        struct trace_stat stats;
+};
+
 struct result {
         struct trace_result per_trace[MAX_THREADS];
+        struct dev_result per_dev[MAX_DEVS];
         struct aggr_result aggr_result;
 };
 
@@ -262,6 +407,30 @@ typedef unsigned long long __u64;
 #define _ASM_GENERIC_INT_LL64_H // This for the Redhat Linux
 #endif
 long long get_total_bytes(int nr_trace, int nr_thread);
-void synthetic_mix(struct trace_info_t *trace);
+void io_stat_read(struct io_stat_t *io_stat, struct io_stat_t *snapshot);
+void *allocate_aligned_buffer(size_t size);
+void trace_reset(struct trace_info_t *trace);
+int trace_set_eof(struct trace_info_t *trace);
+int trace_eof(struct trace_info_t *trace);
+long long trace_issued(struct trace_info_t *trace);
+int trace_repeat_count(struct trace_info_t *trace);
+int trace_io_claim(struct trace_info_t *trace, struct io_stat_t *io_stat,
+                   long long now, int max, long long *ticket);
+struct trace_io_req *trace_next_req(struct trace_info_t *trace,
+                                    struct trace_io_req *scratch);
+int make_jobs(struct thread_info_t *t_info, struct iocb **ioq,
+              struct io_job **jobq, int depth);
+void release_job(struct thread_info_t *t_info, struct io_job *job);
+unsigned long long next_arrival(struct trace_info_t *trace);
+void trace_io_get(double *arrival_time, int *devno, long long *blkno,
+                  int *bcount, int *flags, struct trace_info_t *trace,
+                  long long ticket);
+int trace_io_put_req(struct trace_info_t *trace, struct trace_io_req *req);
+void trace_io_put_done(struct trace_info_t *trace);
+int trace_io_parse(char *line, struct trace_io_req *req);
+int trace_io_put(char *line, struct trace_info_t *trace);
+int trace_open(struct trace_info_t *trace);
+void trace_cache_write(struct trace_info_t *trace);
+int trace_convert(const char *src, const char *dst, int window);
 
 #endif
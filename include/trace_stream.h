@@ -0,0 +1,80 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Streaming trace loader
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _TRACE_STREAM_H
+#define _TRACE_STREAM_H
+
+#include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <trace_replay.h>
+
+struct trace_index;
+
+/*
+ * The loader parses a text trace into a ring of records while the workers
+ * replay it. Ticket t lives in ring[t & (ring_size - 1)]; the ring is
+ * handed back to the loader a chunk at a time, once every ticket of the
+ * chunk has been read. The last trace_window records stay unpublished
+ * while the trimming may still change them.
+ *
+ * Repeats replay the first pass from a spill file of the trimmed records,
+ * which also becomes the <trace>.trbin cache, or parse a regular file again
+ * when there is no spill file.
+ */
+#define TRACE_STREAM_CHUNK 4096 // records
+#define TRACE_STREAM_DEFAULT_MB 16
+#define TRACE_STREAM_MAX_BYTES (1024 * 1024) // I/O pool buffers when streaming
+
+struct trace_stream {
+        /* written by the loader, read by the workers */
+        long long published __attribute__((aligned(64)));
+        int done; // nothing will be published after published
+
+        struct trace_io_req *ring __attribute__((aligned(64)));
+        long long ring_size; // in records, a power of two
+        unsigned int *consumed; // per chunk, tickets read by the workers
+        int nr_chunks;
+        int stop;
+
+        long long produced; // loader only
+        struct trace_index *index; // trimming window of the current pass
+        long long pass_start;
+        int pass;
+        int seekable;
+
+        FILE *spill; // trimmed records of the first pass
+        int spill_failed;
+        char spill_path[PATH_MAX]; // temporary name of the cache
+        char cache_path[PATH_MAX];
+
+        pthread_mutex_t lock;
+        pthread_cond_t loaded;
+        pthread_cond_t freed;
+        pthread_t thread;
+};
+
+int trace_stream_start(struct trace_info_t *trace, size_t max_mem,
+                       int use_cache);
+int trace_stream_ready(struct trace_stream *stream, long long ticket);
+void trace_stream_wait(struct trace_stream *stream, long long ticket);
+void trace_stream_release(struct trace_stream *stream, long long ticket,
+                          int nr);
+void trace_stream_destroy(struct trace_info_t *trace);
+
+#endif
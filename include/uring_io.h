@@ -0,0 +1,31 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * io_uring submission/completion engine
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _URING_IO_H
+#define _URING_IO_H
+
+#include <trace_replay.h>
+
+int uring_io_init(struct thread_info_t *t_info, unsigned int flags);
+int uring_io_submit(struct thread_info_t *t_info, struct io_job **jobq,
+                    int cnt);
+int uring_io_reap(struct thread_info_t *t_info, struct io_job **jobq, int min,
+                  int max);
+void uring_io_exit(struct thread_info_t *t_info);
+long long uring_io_pinned(void);
+
+#endif
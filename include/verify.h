@@ -0,0 +1,57 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Sector stamps and CRC32C checks of the verify mode
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef _VERIFY_H
+#define _VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * With --verify every sector of a write ends with a verify_tail, and every
+ * sector of a read which carries one is checked against its crc and the
+ * sector it was read from. Sectors which were never written in verify mode
+ * have no magic and are skipped. Each sector stands alone, so requests of
+ * any size and alignment can read what others wrote.
+ */
+#define VERIFY_MAGIC 0x76726679 // "yfrv"
+#define VERIFY_SECTOR 512
+#define VERIFY_CRC_LEN (VERIFY_SECTOR - 4) // everything but the crc
+#define VERIFY_MAX_REPORTS 8 // bad reads printed per worker
+
+struct verify_tail {
+        uint64_t lba; // sector written to
+        uint32_t generation; // write of the worker
+        uint32_t seed; // of the run
+        uint32_t magic;
+        uint32_t crc; // crc32c of the sector up to here
+};
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
+void verify_stamp(char *buf, size_t bytes, long long offset,
+                  uint32_t generation, uint32_t seed);
+int verify_check(const char *buf, size_t bytes, long long offset,
+                 int *nr_checked, long long *bad_offset);
+
+static inline struct verify_tail *verify_tail(const char *sector)
+{
+        return (struct verify_tail *)(sector + VERIFY_SECTOR -
+                                      sizeof(struct verify_tail));
+}
+
+#endif
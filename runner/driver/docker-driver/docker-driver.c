@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <search.h>
+#include <libgen.h>
 #include <assert.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -378,6 +379,231 @@ static int docker_set_cgroup_state(struct docker_info *current)
         return 0;
 }
 
+/**
+ * @brief Make the `--devno-map` entries of `trace-replay` or the `--device` options of the container from `devno_map`.
+ *
+ * @param[in] devno_map Devices of the devnos without the `/dev/`(e.g. 1:sdc,2:sdd).
+ * @param[in] container 1 for the `--device` options, 0 for the `--devno-map` entries.
+ * @param[out] buffer The buffer which will be filled with the entries.
+ * @param[in] size The size of the `buffer`.
+ */
+static void docker_get_devno_map_options(const char *devno_map, int container,
+                                         char *buffer, size_t size)
+{
+        char map[NAME_MAX];
+        char *entry, *device, *save;
+        const char *separator = "";
+        int len = 0;
+
+        buffer[0] = '\0';
+        snprintf(map, sizeof(map), "%s", devno_map);
+        for (entry = strtok_r(map, ",", &save); NULL != entry;
+             entry = strtok_r(NULL, ",", &save)) {
+                device = strchr(entry, ':');
+                if (NULL == device || (size_t)len >= size) {
+                        continue;
+                }
+                *device++ = '\0';
+                if (container) {
+                        len += snprintf(buffer + len, size - len,
+                                        " --device /dev/%s", device);
+                } else {
+                        len += snprintf(buffer + len, size - len,
+                                        "%s%s:/dev/%s", separator, entry,
+                                        device);
+                        separator = ",";
+                }
+        }
+}
+
+/**
+ * @brief Set the I/O scheduler of the device unless it is already done.
+ *
+ * @param[in] scheduler Scheduler name(e.g. none, bfq, kyber).
+ * @param[in] device Device name without the `/dev/`.
+ * @param[in,out] done Devices which already have the scheduler.
+ * @param[in,out] nr_done The number of the devices in `done`.
+ *
+ * @return 0 for success to set, -EINVAL for fail to set.
+ */
+static int docker_set_scheduler(const char *scheduler, const char *device,
+                            char done[][NAME_MAX], int *nr_done)
+{
+        char cmd[PATH_MAX];
+        int index;
+
+        for (index = 0; index < *nr_done; index++) {
+                if (0 == strcmp(done[index], device)) {
+                        return 0;
+                }
+        }
+        if (MAX_DEVS <= *nr_done) {
+                pr_info(ERROR, "Too many devices (max: %d)\n", MAX_DEVS);
+                return -EINVAL;
+        }
+
+        snprintf(cmd, PATH_MAX, "echo %s >> /sys/block/%s/queue/scheduler",
+                 scheduler, device);
+        pr_info(INFO, "Do command: \"%s\"\n", cmd);
+        if (system(cmd)) {
+                pr_info(ERROR, "Scheduler setting failed (scheduler: %s)\n",
+                        scheduler);
+                return -EINVAL;
+        }
+        snprintf(done[(*nr_done)++], NAME_MAX, "%s", device);
+
+        return 0;
+}
+
+/**
+ * @brief Set the I/O scheduler of every distinct device of the tasks, which includes the devices of `devno_map`.
+ *
+ * @return 0 for success to set, -EINVAL for fail to set.
+ */
+static int docker_set_schedulers(void)
+{
+        struct docker_info *current = global_info_head;
+        char done[MAX_DEVS][NAME_MAX];
+        char map[NAME_MAX];
+        char *entry, *device, *save;
+        int nr_done = 0;
+        int ret = 0;
+
+        docker_info_list_traverse(current, global_info_head)
+        {
+                ret = docker_set_scheduler(global_info_head->scheduler,
+                                           current->device, done, &nr_done);
+                if (ret) {
+                        return ret;
+                }
+
+                snprintf(map, sizeof(map), "%s", current->devno_map);
+                for (entry = strtok_r(map, ",", &save); NULL != entry;
+                     entry = strtok_r(NULL, ",", &save)) {
+                        device = strchr(entry, ':');
+                        if (NULL == device) {
+                                pr_info(ERROR, "Invalid devno map: \"%s\"\n",
+                                        current->devno_map);
+                                return -EINVAL;
+                        }
+                        ret = docker_set_scheduler(global_info_head->scheduler,
+                                                   device + 1, done, &nr_done);
+                        if (ret) {
+                                return ret;
+                        }
+                }
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Make the `trace-replay` option string of the current process.
+ *
+ * @param[in] current The structure which has the current process information.
+ * @param[out] buffer The buffer which will be filled with the options.
+ * @param[in] size The size of the `buffer`.
+ */
+static void docker_get_replay_options(const struct docker_info *current,
+                                      char *buffer, size_t size)
+{
+        int len = 0;
+
+        buffer[0] = '\0';
+        if ('\0' != current->engine[0]) {
+                len += snprintf(buffer + len, size - len, " --engine=%s",
+                                current->engine);
+        }
+        if (current->sqpoll && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --sqpoll");
+        }
+        if (current->iopoll && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --iopoll");
+        }
+        if (current->hist_log && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --hist-log");
+        }
+        if (current->io_log && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len,
+                                " --io-log --io-log-sample=%u",
+                                current->io_log);
+        }
+        if ('\0' != current->cpus[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --cpus=%s",
+                                current->cpus);
+        }
+        if ('\0' != current->skew[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --skew=%s",
+                                current->skew);
+        }
+        if ('\0' != current->arrival[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --arrival=%s",
+                                current->arrival);
+        }
+        if ('\0' != current->rate_limit[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --rate=%s",
+                                current->rate_limit);
+        }
+        if ('\0' != current->thread_rate_limit[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --thread-rate=%s",
+                                current->thread_rate_limit);
+        }
+        if (current->file_size && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --file-size=%u",
+                                current->file_size);
+        }
+        if (current->prewrite && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --prewrite");
+        }
+        if ('\0' != current->devno_map[0] && (size_t)len < size) {
+                len += snprintf(buffer + len, size - len, " --devno-map=");
+                docker_get_devno_map_options(current->devno_map, 0,
+                                             buffer + len, size - len);
+        }
+}
+
+/**
+ * @brief Make the path of the target which the container replays on, and the volume which has the target.
+ *
+ * @param[in] current The structure which has the current process information.
+ * @param[out] target The buffer which will be filled with the path, which has `PATH_MAX` size.
+ * @param[out] volume The buffer which will be filled with the `-v` option of a file, which has `PATH_MAX` size.
+ *
+ * @return 0 for success to make, -ENAMETOOLONG for the path which doesn't fit in the buffers.
+ *
+ * @note A `file` which is a directory gets a file of each container, named by its `cgroup_id`, so that the containers can share a filesystem. The directory of the file is mounted at the same path in the container.
+ */
+static int docker_get_target(const struct docker_info *current, char *target,
+                             char *volume)
+{
+        char path[PATH_MAX];
+        const char *dir = path;
+        struct stat st;
+        int len;
+
+        volume[0] = '\0';
+        if ('\0' == current->file[0]) {
+                len = snprintf(target, PATH_MAX, "/dev/%s", current->device);
+                return (size_t)len < PATH_MAX ? 0 : -ENAMETOOLONG;
+        }
+
+        snprintf(path, sizeof(path), "%s", current->file);
+        if (0 == stat(current->file, &st) && S_ISDIR(st.st_mode)) {
+                len = snprintf(target, PATH_MAX, "%s/%s.dat", current->file,
+                               current->cgroup_id);
+        } else {
+                len = snprintf(target, PATH_MAX, "%s", current->file);
+                dir = dirname(path);
+        }
+        if ((size_t)len >= PATH_MAX ||
+            PATH_MAX <= snprintf(volume, PATH_MAX, " -v %s:%s", dir, dir)) {
+                pr_info(ERROR, "Target path is too long: \"%s\"\n",
+                        current->file);
+                return -ENAMETOOLONG;
+        }
+        return 0;
+}
+
 /**
  * @brief Each process `trace-replay` execute part. 
  *
@@ -389,6 +615,10 @@ static int docker_create_container(struct docker_info *current)
 {
         FILE *fp = NULL;
         char filename[PATH_MAX];
+        char options[PATH_MAX];
+        char devices[PATH_MAX];
+        char target[PATH_MAX];
+        char volume[PATH_MAX];
         char *cmd = NULL;
         int ret = 0;
 
@@ -401,11 +631,18 @@ static int docker_create_container(struct docker_info *current)
         /* Create the docker container */
         snprintf(filename, sizeof(filename), "%s_%u_%s.txt", current->scheduler,
                  current->weight, current->cgroup_id);
+        docker_get_replay_options(current, options, sizeof(options));
+        /* The devices of `devno_map` have to be in the container too. */
+        docker_get_devno_map_options(current->devno_map, 1, devices,
+                                     sizeof(devices));
+        if (0 != (ret = docker_get_target(current, target, volume))) {
+                goto exception;
+        }
         sprintf(cmd,
-                "docker container create --name %s --ipc=host -v /tmp/%s/tmp:/tmp --device /dev/%s suhoson/trace_replay:latest /usr/local/bin/trace-replay %u %u %s %u %u /dev/%s %s %u %u %u",
-                current->cgroup_id, current->cgroup_id, current->device,
-                current->q_depth, current->nr_thread, filename, current->time,
-                current->trace_repeat, current->device,
+                "docker container create --name %s --ipc=host -v /tmp/%s/tmp:/tmp%s --device /dev/%s%s suhoson/trace_replay:latest /usr/local/bin/trace-replay%s %u %u %s %u %u %s %s %u %u %u",
+                current->cgroup_id, current->cgroup_id, volume, current->device,
+                devices, options, current->q_depth, current->nr_thread, filename,
+                current->time, current->trace_repeat, target,
                 current->trace_data_path, current->wss, current->utilization,
                 current->iosize);
 
@@ -463,13 +700,8 @@ int docker_runner(void)
                 __docker_rm_container(current);
         }
 
-        snprintf(cmd, PATH_MAX, "echo %s >> /sys/block/%s/queue/scheduler",
-                 global_info_head->scheduler, global_info_head->device);
-        pr_info(INFO, "Do command: \"%s\"\n", cmd);
-        ret = system(cmd);
+        ret = docker_set_schedulers();
         if (ret) {
-                pr_info(ERROR, "Scheduler setting failed (scheduler: %s)\n",
-                        current->scheduler);
                 return ret;
         }
 
@@ -37,10 +37,17 @@
  * @brief Definition of a well-known synthetic form.
  * This value depends on the `trace-replay` specification.
  */
-static const char *global_synth_type[] = { "rand_read",  "rand_write",
-                                           "rand_mixed", "seq_read",
-                                           "seq_write",  "seq_mixed",
-                                           NULL };
+static const char *global_synth_type[] = {
+        "rand_read",    "rand_write",    "rand_mixed",    "seq_read",
+        "seq_write",    "seq_mixed",     "zipf_read",     "zipf_write",
+        "zipf_mixed",   "pareto_read",   "pareto_write",  "pareto_mixed",
+        "hotspot_read", "hotspot_write", "hotspot_mixed", NULL
+};
+
+/**
+ * @brief Definition of the I/O engines which `trace-replay` supports.
+ */
+static const char *global_engine_type[] = { "libaio", "io_uring", NULL };
 
 /**
  * @brief Read the JSON string and convert the value to integer form and set that value to `info->(member)`
@@ -115,6 +122,27 @@ int docker_is_synth_type(const char *trace_data_path)
         return DOCKER_NOT_SYNTH;
 }
 
+/**
+ * @brief Check the `engine` value is supported by `trace-replay`.
+ *
+ * @param[in] engine The engine name which I want to check. Empty string means the default engine.
+ *
+ * @return 0 for supported engine, -EINVAL for unsupported engine.
+ */
+static int docker_valid_engine_test(const char *engine)
+{
+        int i = 0;
+        if ('\0' == engine[0]) {
+                return 0;
+        }
+        for (i = 0; global_engine_type[i] != NULL; i++) {
+                if (!strcmp(engine, global_engine_type[i])) {
+                        return 0;
+                }
+        }
+        return -EINVAL;
+}
+
 /**
  * @brief Set the configuration of each process's behavior.
  *
@@ -176,6 +204,41 @@ static int __docker_info_init(struct json_object *setting, int index,
                                   DOCKER_PRINT_NONE);
         docker_info_str_value_set(tmp, "device", info->device,
                                   sizeof(info->device), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "devno_map", info->devno_map,
+                                  sizeof(info->devno_map), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "file", info->file, sizeof(info->file),
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "file_size", &info->file_size,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "prewrite", &info->prewrite,
+                                  DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "engine", info->engine,
+                                  sizeof(info->engine), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "cpus", info->cpus, sizeof(info->cpus),
+                                  DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "skew", info->skew, sizeof(info->skew),
+                                  DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "arrival", info->arrival,
+                                  sizeof(info->arrival), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "rate_limit", info->rate_limit,
+                                  sizeof(info->rate_limit), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(tmp, "thread_rate_limit",
+                                  info->thread_rate_limit,
+                                  sizeof(info->thread_rate_limit), DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "sqpoll", &info->sqpoll,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "iopoll", &info->iopoll,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "hist_log", &info->hist_log,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(tmp, "io_log", &info->io_log,
+                                  DOCKER_PRINT_NONE);
+        if (0 != docker_valid_engine_test(info->engine)) {
+                pr_info(ERROR, "Unsupported engine (name: %s)\n", info->engine);
+                ret = -EINVAL;
+                goto exception;
+        }
+
         ret = docker_valid_scheduler_test(info->scheduler);
         if (0 > ret) {
                 pr_info(ERROR, "Unsupported scheduler (name: %s)\n",
@@ -318,6 +381,35 @@ struct docker_info *docker_info_init(struct json_object *setting, int index)
                                   DOCKER_PRINT_NONE);
         docker_info_int_value_set(setting, "iosize", &info->iosize,
                                   DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "engine", info->engine,
+                                  sizeof(info->engine), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "cpus", info->cpus,
+                                  sizeof(info->cpus), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "skew", info->skew,
+                                  sizeof(info->skew), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "arrival", info->arrival,
+                                  sizeof(info->arrival), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "rate_limit", info->rate_limit,
+                                  sizeof(info->rate_limit), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "thread_rate_limit",
+                                  info->thread_rate_limit,
+                                  sizeof(info->thread_rate_limit), DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "sqpoll", &info->sqpoll,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "iopoll", &info->iopoll,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "hist_log", &info->hist_log,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "io_log", &info->io_log,
+                                  DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "devno_map", info->devno_map,
+                                  sizeof(info->devno_map), DOCKER_PRINT_NONE);
+        docker_info_str_value_set(setting, "file", info->file,
+                                  sizeof(info->file), DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "file_size", &info->file_size,
+                                  DOCKER_PRINT_NONE);
+        docker_info_int_value_set(setting, "prewrite", &info->prewrite,
+                                  DOCKER_PRINT_NONE);
         /* Validation check of `trace_data_path` in `__docker_info_init()` */
         docker_info_str_value_set(setting, "trace_data_path",
                                   info->trace_data_path,
@@ -71,6 +71,10 @@ docker_info_serializer(const struct docker_info *info)
                 json_object_new_string(info->prefix_cgroup_name));
         json_object_object_add(meta, "scheduler",
                                json_object_new_string(info->scheduler));
+        json_object_object_add(meta, "engine",
+                               json_object_new_string(info->engine));
+        json_object_object_add(meta, "cpus",
+                               json_object_new_string(info->cpus));
         json_object_object_add(meta, "cgroup_id",
                                json_object_new_string(info->cgroup_id));
         json_object_object_add(meta, "trace_data_path",
@@ -111,6 +115,13 @@ docker_realtime_log_serializer(const struct realtime_log *log)
         json_object_object_add(data, "lat", json_object_new_double(log->lat));
         json_object_object_add(data, "time_diff",
                                json_object_new_double(log->time_diff));
+        json_object_object_add(data, "lag", json_object_new_double(log->lag));
+        json_object_object_add(data, "nr_lag_dropped",
+                               json_object_new_int64(log->nr_lag_dropped));
+        json_object_object_add(data, "nr_lag_shifted",
+                               json_object_new_int64(log->nr_lag_shifted));
+        json_object_object_add(data, "nr_verify_errors",
+                               json_object_new_int64(log->nr_verify_errors));
         return data;
 }
 
@@ -136,6 +147,19 @@ docker_total_trace_serializer(const struct trace *traces)
                                json_object_new_int64(traces->start_page));
         json_object_object_add(_trace, "total_pages",
                                json_object_new_int64(traces->total_pages));
+        json_object_object_add(_trace, "cpus",
+                               json_object_new_string(traces->cpus));
+        json_object_object_add(_trace, "numa_node",
+                               json_object_new_int(traces->numa_node));
+        json_object_object_add(_trace, "rate_limit",
+                               json_object_new_string(traces->rate_limit));
+        json_object_object_add(
+                _trace, "thread_rate_limit",
+                json_object_new_string(traces->thread_rate_limit));
+        json_object_object_add(_trace, "device",
+                               json_object_new_string(traces->device));
+        json_object_object_add(_trace, "devno_map",
+                               json_object_new_string(traces->devno_map));
         return _trace;
 }
 
@@ -170,6 +194,8 @@ docker_total_config_serializer(const struct total_results *total,
                                json_object_new_int(total->config.nr_trace));
         json_object_object_add(config, "nr_thread",
                                json_object_new_int(total->config.nr_thread));
+        json_object_object_add(config, "nr_dev",
+                               json_object_new_int(total->config.nr_dev));
         json_object_object_add(config, "per_thread",
                                json_object_new_int(total->config.per_thread));
         json_object_object_add(
@@ -211,6 +237,11 @@ docker_synthetic_serializer(const struct synthetic *_synthetic)
                 json_object_new_int(_synthetic->touched_working_set_size));
         json_object_object_add(synthetic, "io_size",
                                json_object_new_int(_synthetic->io_size));
+        json_object_object_add(
+                synthetic, "distribution",
+                json_object_new_string(_synthetic->distribution));
+        json_object_object_add(synthetic, "arrival",
+                               json_object_new_string(_synthetic->arrival));
         return synthetic;
 }
 
@@ -235,6 +266,23 @@ docker_stats_serializer(const struct trace_stat *_stats)
                 { "avg_lat_var", &_stats->avg_lat_var },
                 { "lat_min", &_stats->lat_min },
                 { "lat_max", &_stats->lat_max },
+                { "lat_p50", &_stats->lat_p50 },
+                { "lat_p99", &_stats->lat_p99 },
+                { "lat_p999", &_stats->lat_p999 },
+                { "lat_p9999", &_stats->lat_p9999 },
+                { "pace_err_p50", &_stats->pace_err_p50 },
+                { "pace_err_p99", &_stats->pace_err_p99 },
+                { "pace_err_p999", &_stats->pace_err_p999 },
+                { "pace_err_p9999", &_stats->pace_err_p9999 },
+                { "avg_queue_delay", &_stats->avg_queue_delay },
+                { "lag_max", &_stats->lag_max },
+                { "lag_shift", &_stats->lag_shift },
+                { "nr_lag_dropped", &_stats->nr_lag_dropped },
+                { "nr_lag_shifted", &_stats->nr_lag_shifted },
+                { "nr_verified", &_stats->nr_verified },
+                { "nr_verify_errors", &_stats->nr_verify_errors },
+                { "token_wait", &_stats->token_wait },
+                { "nr_token_waits", &_stats->nr_token_waits },
                 { "iops", &_stats->iops },
                 { "total_bw", &_stats->total_bw },
                 { "read_bw", &_stats->read_bw },
@@ -242,6 +290,7 @@ docker_stats_serializer(const struct trace_stat *_stats)
                 { "total_traffic", &_stats->total_traffic },
                 { "read_traffic", &_stats->read_traffic },
                 { "write_traffic", &_stats->write_traffic },
+                { "error_traffic", &_stats->error_traffic },
                 { "read_ratio", &_stats->read_ratio },
                 { "total_avg_req_size", &_stats->total_avg_req_size },
                 { "read_avg_req_size", &_stats->read_avg_req_size },
@@ -328,6 +377,38 @@ docker_total_per_trace_serializer(const struct total_results *total,
         return per_traces;
 }
 
+/**
+ * @brief To make a `total_results` structure's `per_dev` member to `json_object`.
+ *
+ * @param[in] total `total_results` data structure which wants to convert `per_dev` member to `json_object`.
+ *
+ * @return `total_results` structure's `per_dev` member's `json_object`. Each `stats` is same form of `aggr_result`.
+ *
+ * @note You must deallocate this returned `json_object` or attach this to the other `json_object`.
+ */
+static struct json_object *
+docker_total_per_dev_serializer(const struct total_results *total)
+{
+        struct json_object *per_devs;
+        struct json_object *per_dev;
+        int i;
+
+        assert(NULL != total);
+
+        per_devs = json_object_new_array();
+        for (i = 0; i < total->config.nr_dev; i++) {
+                const struct dev_result *dev = &total->results.per_dev[i];
+
+                per_dev = json_object_new_object();
+                json_object_object_add(per_dev, "name",
+                                       json_object_new_string(dev->name));
+                json_object_object_add(per_dev, "stats",
+                                       docker_stats_serializer(&dev->stats));
+                json_object_array_add(per_devs, per_dev);
+        }
+        return per_devs;
+}
+
 /**
  * @brief To make a `aggr_result` structure's `per_trace` member to `json_object`.
  *
@@ -364,6 +445,9 @@ docker_total_result_serializer(const struct total_results *total,
                                docker_total_per_trace_serializer(total,
                                                                  jobject));
 
+        json_object_object_add(results, "per_dev",
+                               docker_total_per_dev_serializer(total));
+
         json_object_object_add(results, "aggr_result",
                                docker_total_aggr_serializer(total));
         return results;
@@ -318,6 +318,150 @@ static int tr_set_cgroup_state(struct tr_info *current)
         return 0;
 }
 
+/**
+ * @brief Make the `--devno-map` option of `trace-replay` from the `devno_map` of the task.
+ *
+ * @param[in] devno_map Devices of the devnos without the `/dev/`(e.g. 1:sdc,2:sdd).
+ * @param[out] buffer The buffer which will be filled with the option.
+ * @param[in] size The size of the `buffer`.
+ */
+static void tr_get_devno_map_option(const char *devno_map, char *buffer,
+                                    size_t size)
+{
+        char map[NAME_MAX];
+        char *entry, *device, *save;
+        const char *separator = "";
+        int len = 0;
+
+        snprintf(map, sizeof(map), "%s", devno_map);
+        len += snprintf(buffer + len, size - len, "--devno-map=");
+        for (entry = strtok_r(map, ",", &save); NULL != entry;
+             entry = strtok_r(NULL, ",", &save)) {
+                device = strchr(entry, ':');
+                if (NULL == device || (size_t)len >= size) {
+                        continue;
+                }
+                *device++ = '\0';
+                len += snprintf(buffer + len, size - len, "%s%s:/dev/%s",
+                                separator, entry, device);
+                separator = ",";
+        }
+}
+
+/**
+ * @brief Make the path of the target which the task replays on.
+ *
+ * @param[in] info The structure which has the current process information.
+ * @param[out] buffer The buffer which will be filled with the path.
+ * @param[in] size The size of the `buffer`.
+ *
+ * @return 0 for success to make, -ENAMETOOLONG for the path which doesn't fit in the `buffer`.
+ *
+ * @note A `file` which is a directory gets a file of each task, named by its `cgroup_id`, so that the tasks can share a filesystem.
+ */
+static int tr_get_target_path(const struct tr_info *info, char *buffer,
+                              size_t size)
+{
+        struct stat st;
+        int len;
+
+        if ('\0' == info->file[0]) {
+                len = snprintf(buffer, size, "/dev/%s", info->device);
+        } else if (0 == stat(info->file, &st) && S_ISDIR(st.st_mode)) {
+                len = snprintf(buffer, size, "%s/%s.dat", info->file,
+                               info->cgroup_id);
+        } else {
+                len = snprintf(buffer, size, "%s", info->file);
+        }
+
+        if ((size_t)len >= size) {
+                pr_info(ERROR, "Target path is too long: \"%s\"\n", buffer);
+                return -ENAMETOOLONG;
+        }
+        return 0;
+}
+
+/**
+ * @brief Set the I/O scheduler of the device unless it is already done.
+ *
+ * @param[in] scheduler Scheduler name(e.g. none, bfq, kyber).
+ * @param[in] device Device name without the `/dev/`.
+ * @param[in,out] done Devices which already have the scheduler.
+ * @param[in,out] nr_done The number of the devices in `done`.
+ *
+ * @return 0 for success to set, -EINVAL for fail to set.
+ */
+static int tr_set_scheduler(const char *scheduler, const char *device,
+                            char done[][NAME_MAX], int *nr_done)
+{
+        char cmd[PATH_MAX];
+        int index;
+
+        for (index = 0; index < *nr_done; index++) {
+                if (0 == strcmp(done[index], device)) {
+                        return 0;
+                }
+        }
+        if (MAX_DEVS <= *nr_done) {
+                pr_info(ERROR, "Too many devices (max: %d)\n", MAX_DEVS);
+                return -EINVAL;
+        }
+
+        snprintf(cmd, PATH_MAX, "echo %s >> /sys/block/%s/queue/scheduler",
+                 scheduler, device);
+        pr_info(INFO, "Do command: \"%s\"\n", cmd);
+        if (system(cmd)) {
+                pr_info(ERROR, "Scheduler setting failed (scheduler: %s)\n",
+                        scheduler);
+                return -EINVAL;
+        }
+        snprintf(done[(*nr_done)++], NAME_MAX, "%s", device);
+
+        return 0;
+}
+
+/**
+ * @brief Set the I/O scheduler of every distinct device of the tasks, which includes the devices of `devno_map`.
+ *
+ * @return 0 for success to set, -EINVAL for fail to set.
+ */
+static int tr_set_schedulers(void)
+{
+        struct tr_info *current = global_info_head;
+        char done[MAX_DEVS][NAME_MAX];
+        char map[NAME_MAX];
+        char *entry, *device, *save;
+        int nr_done = 0;
+        int ret = 0;
+
+        tr_info_list_traverse(current, global_info_head)
+        {
+                ret = tr_set_scheduler(global_info_head->scheduler,
+                                       current->device, done, &nr_done);
+                if (ret) {
+                        return ret;
+                }
+
+                snprintf(map, sizeof(map), "%s", current->devno_map);
+                for (entry = strtok_r(map, ",", &save); NULL != entry;
+                     entry = strtok_r(NULL, ",", &save)) {
+                        device = strchr(entry, ':');
+                        if (NULL == device) {
+                                pr_info(ERROR, "Invalid devno map: \"%s\"\n",
+                                        current->devno_map);
+                                return -EINVAL;
+                        }
+                        ret = tr_set_scheduler(global_info_head->scheduler,
+                                               device + 1, done, &nr_done);
+                        if (ret) {
+                                return ret;
+                        }
+                }
+        }
+
+        return ret;
+}
+
 /**
  * @brief Each process `trace-replay` execute part. 
  *
@@ -340,6 +484,23 @@ static int tr_do_exec(struct tr_info *current)
         char utilization_str[PAGE_SIZE / 4];
         char iosize_str[PAGE_SIZE / 4];
 
+        char engine_opt[PAGE_SIZE / 4];
+        char cpus_opt[PAGE_SIZE / 4];
+        char skew_opt[PAGE_SIZE / 4];
+        char arrival_opt[PAGE_SIZE / 4];
+        char rate_opt[PAGE_SIZE / 4];
+        char thread_rate_opt[PAGE_SIZE / 4];
+        char devno_map_opt[PAGE_SIZE / 4];
+        char file_size_opt[PAGE_SIZE / 4];
+        char prewrite_opt[] = "--prewrite";
+        char sqpoll_opt[] = "--sqpoll";
+        char iopoll_opt[] = "--iopoll";
+        char hist_log_opt[] = "--hist-log";
+        char io_log_opt[] = "--io-log";
+        char io_log_sample_opt[PAGE_SIZE / 4];
+        char *argv[TR_EXEC_MAX_ARGS];
+        int argc = 0;
+
         assert(NULL != current);
         if (current) {
                 memcpy(&info, current, sizeof(struct tr_info));
@@ -351,7 +512,9 @@ static int tr_do_exec(struct tr_info *current)
         snprintf(q_depth_str, sizeof(q_depth_str), "%u", info.q_depth);
         snprintf(nr_thread_str, sizeof(nr_thread_str), "%u", info.nr_thread);
         snprintf(time_str, sizeof(time_str), "%u", info.time);
-        snprintf(device_path, sizeof(device_path), "/dev/%s", info.device);
+        if (0 != tr_get_target_path(&info, device_path, sizeof(device_path))) {
+                return -ENAMETOOLONG;
+        }
 
         snprintf(trace_repeat_str, sizeof(trace_repeat_str), "%u",
                  info.trace_repeat);
@@ -365,10 +528,77 @@ static int tr_do_exec(struct tr_info *current)
 #ifdef DEBUG
         tr_print_info(&info);
 #endif
-        return execlp(info.trace_replay_path, info.trace_replay_path,
-                      q_depth_str, nr_thread_str, filename, time_str,
-                      trace_repeat_str, device_path, info.trace_data_path,
-                      wss_str, utilization_str, iosize_str, (char *)0);
+        argv[argc++] = info.trace_replay_path;
+        if ('\0' != info.engine[0]) {
+                snprintf(engine_opt, sizeof(engine_opt), "--engine=%s",
+                         info.engine);
+                argv[argc++] = engine_opt;
+        }
+        if (info.sqpoll) {
+                argv[argc++] = sqpoll_opt;
+        }
+        if (info.iopoll) {
+                argv[argc++] = iopoll_opt;
+        }
+        if (info.hist_log) {
+                argv[argc++] = hist_log_opt;
+        }
+        if (info.io_log) {
+                snprintf(io_log_sample_opt, sizeof(io_log_sample_opt),
+                         "--io-log-sample=%u", info.io_log);
+                argv[argc++] = io_log_opt;
+                argv[argc++] = io_log_sample_opt;
+        }
+        if ('\0' != info.cpus[0]) {
+                snprintf(cpus_opt, sizeof(cpus_opt), "--cpus=%s", info.cpus);
+                argv[argc++] = cpus_opt;
+        }
+        if ('\0' != info.skew[0]) {
+                snprintf(skew_opt, sizeof(skew_opt), "--skew=%s", info.skew);
+                argv[argc++] = skew_opt;
+        }
+        if ('\0' != info.arrival[0]) {
+                snprintf(arrival_opt, sizeof(arrival_opt), "--arrival=%s",
+                         info.arrival);
+                argv[argc++] = arrival_opt;
+        }
+        if ('\0' != info.rate_limit[0]) {
+                snprintf(rate_opt, sizeof(rate_opt), "--rate=%s",
+                         info.rate_limit);
+                argv[argc++] = rate_opt;
+        }
+        if ('\0' != info.thread_rate_limit[0]) {
+                snprintf(thread_rate_opt, sizeof(thread_rate_opt),
+                         "--thread-rate=%s", info.thread_rate_limit);
+                argv[argc++] = thread_rate_opt;
+        }
+        if ('\0' != info.devno_map[0]) {
+                tr_get_devno_map_option(info.devno_map, devno_map_opt,
+                                        sizeof(devno_map_opt));
+                argv[argc++] = devno_map_opt;
+        }
+        if (info.file_size) {
+                snprintf(file_size_opt, sizeof(file_size_opt),
+                         "--file-size=%u", info.file_size);
+                argv[argc++] = file_size_opt;
+        }
+        if (info.prewrite) {
+                argv[argc++] = prewrite_opt;
+        }
+        argv[argc++] = q_depth_str;
+        argv[argc++] = nr_thread_str;
+        argv[argc++] = filename;
+        argv[argc++] = time_str;
+        argv[argc++] = trace_repeat_str;
+        argv[argc++] = device_path;
+        argv[argc++] = info.trace_data_path;
+        argv[argc++] = wss_str;
+        argv[argc++] = utilization_str;
+        argv[argc++] = iosize_str;
+        argv[argc] = NULL;
+        assert(argc < TR_EXEC_MAX_ARGS);
+
+        return execvp(info.trace_replay_path, argv);
 }
 
 /**
@@ -391,14 +621,9 @@ int tr_runner(void)
                 pr_info(WARNING, "Deletion sequence ignore: \"%s\"\n", cmd);
         }
 
-        snprintf(cmd, PATH_MAX, "echo %s >> /sys/block/%s/queue/scheduler",
-                 current->scheduler, current->device);
-        pr_info(INFO, "Do command: \"%s\"\n", cmd);
-        ret = system(cmd);
+        ret = tr_set_schedulers();
         if (ret) {
-                pr_info(ERROR, "Scheduler setting failed (scheduler: %s)\n",
-                        current->scheduler);
-                return -EINVAL;
+                return ret;
         }
 
         TELL_WAIT(); /* Prepare to synchronization. */
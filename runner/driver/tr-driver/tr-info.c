@@ -37,10 +37,18 @@
  * @brief Definition of a well-known synthetic form.
  * This value depends on the `trace-replay` specification.
  */
-static const char *global_synth_type[] = { "rand_read",  "rand_write",
-                                           "rand_mixed", "seq_read",
-                                           "seq_write",  "seq_mixed",
-                                           NULL };
+static const char *global_synth_type[] = {
+        "rand_read",    "rand_write",    "rand_mixed",    "seq_read",
+        "seq_write",    "seq_mixed",     "zipf_read",     "zipf_write",
+        "zipf_mixed",   "pareto_read",   "pareto_write",  "pareto_mixed",
+        "hotspot_read", "hotspot_write", "hotspot_mixed", NULL
+};
+
+/**
+ * @brief Definition of the I/O engines which `trace-replay` supports.
+ */
+static const char *global_engine_type[] = { "libaio", "io_uring", NULL };
+
 /**
  * @brief Read the JSON string and convert the value to integer form and set that value to `info->(member)`
  *
@@ -112,6 +120,27 @@ static int tr_is_synth_type(const char *trace_data_path)
         return TR_NOT_SYNTH;
 }
 
+/**
+ * @brief Check the `engine` value is supported by `trace-replay`.
+ *
+ * @param[in] engine The engine name which I want to check. Empty string means the default engine.
+ *
+ * @return 0 for supported engine, -EINVAL for unsupported engine.
+ */
+static int tr_valid_engine_test(const char *engine)
+{
+        int i = 0;
+        if ('\0' == engine[0]) {
+                return 0;
+        }
+        for (i = 0; global_engine_type[i] != NULL; i++) {
+                if (!strcmp(engine, global_engine_type[i])) {
+                        return 0;
+                }
+        }
+        return -EINVAL;
+}
+
 /**
  * @brief Set the configuration of each process's behavior.
  *
@@ -165,6 +194,36 @@ static int __tr_info_init(struct json_object *setting, int index,
                               sizeof(info->trace_replay_path), TR_PRINT_NONE);
         tr_info_str_value_set(tmp, "device", info->device, sizeof(info->device),
                               TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "devno_map", info->devno_map,
+                              sizeof(info->devno_map), TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "file", info->file, sizeof(info->file),
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "file_size", &info->file_size,
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "prewrite", &info->prewrite, TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "engine", info->engine, sizeof(info->engine),
+                              TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "cpus", info->cpus, sizeof(info->cpus),
+                              TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "skew", info->skew, sizeof(info->skew),
+                              TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "arrival", info->arrival,
+                              sizeof(info->arrival), TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "rate_limit", info->rate_limit,
+                              sizeof(info->rate_limit), TR_PRINT_NONE);
+        tr_info_str_value_set(tmp, "thread_rate_limit",
+                              info->thread_rate_limit,
+                              sizeof(info->thread_rate_limit), TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "sqpoll", &info->sqpoll, TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "iopoll", &info->iopoll, TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "hist_log", &info->hist_log,
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(tmp, "io_log", &info->io_log, TR_PRINT_NONE);
+        if (0 != tr_valid_engine_test(info->engine)) {
+                pr_info(ERROR, "Unsupported engine (name: %s)\n", info->engine);
+                return -EINVAL;
+        }
+
         ret = tr_valid_scheduler_test(info->scheduler);
         if (0 > ret) {
                 pr_info(ERROR, "Unsupported scheduler (name: %s)\n",
@@ -281,6 +340,32 @@ struct tr_info *tr_info_init(struct json_object *setting, int index)
         tr_info_int_value_set(setting, "utilization", &info->utilization,
                               TR_PRINT_NONE);
         tr_info_int_value_set(setting, "iosize", &info->iosize, TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "engine", info->engine,
+                              sizeof(info->engine), TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "cpus", info->cpus, sizeof(info->cpus),
+                              TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "skew", info->skew, sizeof(info->skew),
+                              TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "arrival", info->arrival,
+                              sizeof(info->arrival), TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "rate_limit", info->rate_limit,
+                              sizeof(info->rate_limit), TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "thread_rate_limit",
+                              info->thread_rate_limit,
+                              sizeof(info->thread_rate_limit), TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "sqpoll", &info->sqpoll, TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "iopoll", &info->iopoll, TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "hist_log", &info->hist_log,
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "io_log", &info->io_log, TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "devno_map", info->devno_map,
+                              sizeof(info->devno_map), TR_PRINT_NONE);
+        tr_info_str_value_set(setting, "file", info->file, sizeof(info->file),
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "file_size", &info->file_size,
+                              TR_PRINT_NONE);
+        tr_info_int_value_set(setting, "prewrite", &info->prewrite,
+                              TR_PRINT_NONE);
         /* Validation check of `trace_data_path` in `__tr_info_init()` */
         tr_info_str_value_set(setting, "trace_data_path", info->trace_data_path,
                               sizeof(info->trace_data_path), TR_PRINT_NONE);
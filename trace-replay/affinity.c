@@ -0,0 +1,195 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * CPU and NUMA placement of the workers
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include <affinity.h>
+
+/*
+ * Everything comes from sysfs and the raw mbind() syscall, so there is no
+ * libnuma to link. A device or a cpu set without a node gives -1, and the
+ * callers leave the placement to the kernel then.
+ */
+
+/* "0-3,8,10-11" as taskset -c and the sysfs cpulist files write it */
+int affinity_parse(const char *list, cpu_set_t *set)
+{
+        const char *p = list;
+        char *end;
+        long lo, hi;
+
+        CPU_ZERO(set);
+        while (*p && *p != '\n') {
+                lo = strtol(p, &end, 10);
+                if (end == p || lo < 0)
+                        return -1;
+                hi = lo;
+                p = end;
+                if (*p == '-') {
+                        hi = strtol(p + 1, &end, 10);
+                        if (end == p + 1 || hi < lo)
+                                return -1;
+                        p = end;
+                }
+                if (hi >= CPU_SETSIZE)
+                        return -1;
+                for (; lo <= hi; lo++)
+                        CPU_SET(lo, set);
+
+                if (*p == ',')
+                        p++;
+                else if (*p && *p != '\n')
+                        return -1;
+        }
+
+        return CPU_COUNT(set) ? CPU_COUNT(set) : -1;
+}
+
+int affinity_format(const cpu_set_t *set, char *buf, size_t size)
+{
+        size_t len = 0;
+        int cpu, last;
+
+        buf[0] = '\0';
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (!CPU_ISSET(cpu, set))
+                        continue;
+                for (last = cpu; last + 1 < CPU_SETSIZE &&
+                                 CPU_ISSET(last + 1, set);
+                     last++)
+                        ;
+
+                if (last > cpu)
+                        len += snprintf(buf + len, size - len, "%s%d-%d",
+                                        len ? "," : "", cpu, last);
+                else
+                        len += snprintf(buf + len, size - len, "%s%d",
+                                        len ? "," : "", cpu);
+                if (len >= size)
+                        return -1;
+                cpu = last;
+        }
+
+        return 0;
+}
+
+static int read_int(const char *path, int *val)
+{
+        FILE *fp = fopen(path, "r");
+        int rc;
+
+        if (fp == NULL)
+                return -1;
+        rc = fscanf(fp, "%d", val) == 1 ? 0 : -1;
+        fclose(fp);
+        return rc;
+}
+
+/*
+ * The node of the controller behind a block device, or behind the file
+ * system of a regular file. Partitions look at their disk, and NVMe
+ * namespaces at the PCI function of their controller.
+ */
+int affinity_dev_node(const char *path)
+{
+        char sys[PATH_MAX], dir[PATH_MAX], file[PATH_MAX + 32];
+        struct stat st;
+        dev_t dev;
+        int node;
+
+        if (stat(path, &st))
+                return -1;
+        dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+
+        snprintf(sys, sizeof(sys), "/sys/dev/block/%u:%u", major(dev),
+                 minor(dev));
+        if (realpath(sys, dir) == NULL)
+                return -1;
+        snprintf(file, sizeof(file), "%s/partition", dir);
+        if (!access(file, F_OK))
+                *strrchr(dir, '/') = '\0';
+
+        snprintf(file, sizeof(file), "%s/device/numa_node", dir);
+        if (read_int(file, &node)) {
+                snprintf(file, sizeof(file), "%s/device/device/numa_node",
+                         dir);
+                if (read_int(file, &node))
+                        return -1;
+        }
+
+        return node >= 0 ? node : -1;
+}
+
+int affinity_node_cpus(int node, cpu_set_t *set)
+{
+        char path[PATH_MAX];
+        char list[4096];
+        FILE *fp;
+        int rc = -1;
+
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node);
+        fp = fopen(path, "r");
+        if (fp == NULL)
+                return -1;
+        if (fgets(list, sizeof(list), fp) != NULL)
+                rc = affinity_parse(list, set);
+        fclose(fp);
+        return rc;
+}
+
+/* the node all of set is on, -1 when it spans nodes */
+int affinity_set_node(const cpu_set_t *set)
+{
+        cpu_set_t node_set, both;
+        int node;
+
+        for (node = 0; node < AFFINITY_MAX_NODES; node++) {
+                if (affinity_node_cpus(node, &node_set) < 0)
+                        continue;
+                CPU_AND(&both, set, &node_set);
+                if (CPU_EQUAL(&both, set))
+                        return node;
+                if (CPU_COUNT(&both))
+                        return -1;
+        }
+
+        return -1;
+}
+
+/* prefers node for the pages of [addr, addr + len) not faulted in yet */
+int affinity_bind(void *addr, size_t len, int node)
+{
+        unsigned long mask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))];
+
+        if (node < 0 || node >= AFFINITY_MAX_NODES)
+                return -1;
+        memset(mask, 0, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] |=
+                1UL << (node % (8 * sizeof(unsigned long)));
+
+        return syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask,
+                       AFFINITY_MAX_NODES + 1, 0);
+}
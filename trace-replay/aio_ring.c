@@ -0,0 +1,71 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * User space reaping of the libaio completion ring
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <time.h>
+
+#include <aio_ring.h>
+
+int aio_ring_usable(io_context_t ctx)
+{
+        struct aio_ring *ring = (struct aio_ring *)ctx;
+
+        return ring != NULL && ring->magic == AIO_RING_MAGIC &&
+               ring->incompat_features == AIO_RING_INCOMPAT_FEATURES &&
+               ring->nr > 0;
+}
+
+/* takes up to max completions off the ring, never blocks */
+int aio_ring_peek(io_context_t ctx, struct io_event *events, int max)
+{
+        struct aio_ring *ring = (struct aio_ring *)ctx;
+        unsigned int head = ring->head;
+        unsigned int tail;
+        int nr = 0;
+
+        /* the events before tail are written when tail is */
+        tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        while (nr < max && head != tail) {
+                events[nr++] = ring->io_events[head];
+                if (++head == ring->nr)
+                        head = 0;
+        }
+
+        /* and the slots are given back only after they are copied */
+        if (nr)
+                __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+        return nr;
+}
+
+/*
+ * io_getevents(ctx, min, max) which looks at the ring first when use_ring.
+ * The syscall is left for an empty ring, where it sleeps for min events,
+ * or returns at once with min 0.
+ */
+int aio_ring_getevents(io_context_t ctx, int use_ring, int min, int max,
+                       struct io_event *events)
+{
+        struct timespec zero = { 0, 0 };
+        int nr;
+
+        if (use_ring) {
+                nr = aio_ring_peek(ctx, events, max);
+                if (nr || !min)
+                        return nr;
+        }
+
+        return io_getevents(ctx, min, max, events, min ? NULL : &zero);
+}
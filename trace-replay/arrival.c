@@ -0,0 +1,253 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Arrival processes of the synthetic workloads
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <arrival.h>
+
+static const char *arrival_names[] = { "const", "poisson", "onoff", "mmpp" };
+static const int arrival_nr_params[] = { 1, 1, 3, 4 };
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+        uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
+
+static inline uint64_t xorshift128p(uint64_t *s)
+{
+        uint64_t x = s[0];
+        uint64_t y = s[1];
+
+        s[0] = y;
+        x ^= x << 23;
+        s[1] = x ^ y ^ (x >> 17) ^ (y >> 26);
+        return s[1] + y;
+}
+
+/* exponential of mean 1 */
+static inline double rand_exp(struct arrival *arrival)
+{
+        return -log1p(-((xorshift128p(arrival->rand) >> 11) * 0x1.0p-53));
+}
+
+static int arrival_parse(struct arrival *arrival, const char *spec)
+{
+        double param[4];
+        const char *p;
+        char *end;
+        size_t len;
+        int type, i;
+
+        p = strchr(spec, ':');
+        if (p == NULL)
+                return -1;
+        len = p - spec;
+        for (type = ARRIVAL_CONST; type <= ARRIVAL_MMPP; type++)
+                if (strlen(arrival_names[type]) == len &&
+                    !strncmp(spec, arrival_names[type], len))
+                        break;
+        if (type > ARRIVAL_MMPP)
+                return -1;
+
+        for (i = 0, p++; i < arrival_nr_params[type]; i++) {
+                param[i] = strtod(p, &end);
+                if (end == p || param[i] < 0)
+                        return -1;
+                p = *end == ',' ? end + 1 : end;
+        }
+        if (*p || p[-1] == ',')
+                return -1;
+
+        arrival->type = type;
+        arrival->rate[0] = param[0] / 1000;
+        switch (type) {
+        case ARRIVAL_ONOFF:
+                arrival->dwell[0] = param[1];
+                arrival->dwell[1] = param[2];
+                break;
+        case ARRIVAL_MMPP:
+                arrival->dwell[0] = param[1];
+                arrival->rate[1] = param[2] / 1000;
+                arrival->dwell[1] = param[3];
+                if (arrival->dwell[1] <= 0)
+                        return -1;
+                break;
+        }
+
+        if ((arrival->rate[0] <= 0 && arrival->rate[1] <= 0) ||
+            (type >= ARRIVAL_ONOFF && arrival->dwell[0] <= 0))
+                return -1;
+        return 0;
+}
+
+struct arrival *arrival_create(const char *spec, uint64_t seed)
+{
+        struct arrival *arrival;
+        int i;
+
+        arrival = calloc(1, sizeof(struct arrival));
+        if (arrival == NULL)
+                return NULL;
+        if (arrival_parse(arrival, spec)) {
+                free(arrival);
+                return NULL;
+        }
+
+        if (arrival->type != ARRIVAL_CONST) {
+                arrival->ring =
+                        malloc(sizeof(struct arrival_slot) * ARRIVAL_RING);
+                if (arrival->ring == NULL) {
+                        free(arrival);
+                        return NULL;
+                }
+                for (i = 0; i < ARRIVAL_RING; i++)
+                        arrival->ring[i].ticket = -1;
+        }
+
+        pthread_mutex_init(&arrival->lock, NULL);
+        arrival->rand[0] = splitmix64(&seed);
+        arrival->rand[1] = splitmix64(&seed) | 1;
+        arrival->state_end = arrival->dwell[0];
+        if (arrival->type == ARRIVAL_MMPP)
+                arrival->state_end *= rand_exp(arrival);
+        return arrival;
+}
+
+/*
+ * The gap after a switch is drawn anew, which is right as the gaps are
+ * memoryless.
+ */
+static double arrival_step(struct arrival *arrival)
+{
+        double gap;
+        int state;
+
+        if (arrival->type == ARRIVAL_POISSON)
+                return arrival->clock += rand_exp(arrival) / arrival->rate[0];
+
+        while (1) {
+                if (arrival->rate[arrival->state] > 0) {
+                        gap = rand_exp(arrival) /
+                              arrival->rate[arrival->state];
+                        if (arrival->clock + gap < arrival->state_end)
+                                return arrival->clock += gap;
+                }
+
+                state = arrival->state ^= 1;
+                arrival->clock = arrival->state_end;
+                arrival->state_end += arrival->dwell[state] *
+                                      (arrival->type == ARRIVAL_MMPP ?
+                                               rand_exp(arrival) :
+                                               1);
+        }
+}
+
+/* under the lock, the slots are read locklessly like a seqlock */
+static void arrival_fill(struct arrival *arrival, long long end)
+{
+        struct arrival_slot *slot;
+        long long next;
+        double old, time;
+
+        for (next = arrival->next; next < end; next++) {
+                slot = &arrival->ring[next & (ARRIVAL_RING - 1)];
+                old = slot->time;
+
+                __atomic_store_n(&slot->ticket, -1, __ATOMIC_RELAXED);
+                __atomic_thread_fence(__ATOMIC_RELEASE);
+                time = arrival_step(arrival);
+                __atomic_store(&slot->time, &time, __ATOMIC_RELAXED);
+                __atomic_store_n(&slot->ticket, next, __ATOMIC_RELEASE);
+
+                if (next >= ARRIVAL_RING)
+                        __atomic_store(&arrival->evicted, &old,
+                                       __ATOMIC_RELAXED);
+                __atomic_store_n(&arrival->next, next + 1, __ATOMIC_RELEASE);
+        }
+}
+
+/*
+ * A ticket which fell out of the ring, a worker holding it while the
+ * others issued ARRIVAL_RING more, gets the latest arrival evicted, which
+ * is not earlier than its own.
+ */
+double arrival_time(struct arrival *arrival, long long ticket)
+{
+        struct arrival_slot *slot;
+        long long seen;
+        double time;
+
+        if (arrival->type == ARRIVAL_CONST)
+                return (ticket + 1) / arrival->rate[0];
+
+        slot = &arrival->ring[ticket & (ARRIVAL_RING - 1)];
+        while (1) {
+                seen = __atomic_load_n(&slot->ticket, __ATOMIC_ACQUIRE);
+                if (seen == ticket) {
+                        __atomic_load(&slot->time, &time, __ATOMIC_RELAXED);
+                        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                        if (__atomic_load_n(&slot->ticket, __ATOMIC_RELAXED) ==
+                            ticket)
+                                return time;
+                        continue;
+                }
+                if (seen > ticket ||
+                    ticket < __atomic_load_n(&arrival->next,
+                                             __ATOMIC_ACQUIRE) -
+                                     ARRIVAL_RING) {
+                        __atomic_load(&arrival->evicted, &time,
+                                      __ATOMIC_RELAXED);
+                        return time;
+                }
+
+                pthread_mutex_lock(&arrival->lock);
+                arrival_fill(arrival, ticket + ARRIVAL_BATCH);
+                pthread_mutex_unlock(&arrival->lock);
+        }
+}
+
+int arrival_format(const struct arrival *arrival, char *buf, int len)
+{
+        switch (arrival->type) {
+        case ARRIVAL_ONOFF:
+                return snprintf(buf, len, "onoff:%g,%g,%g",
+                                arrival->rate[0] * 1000, arrival->dwell[0],
+                                arrival->dwell[1]);
+        case ARRIVAL_MMPP:
+                return snprintf(buf, len, "mmpp:%g,%g,%g,%g",
+                                arrival->rate[0] * 1000, arrival->dwell[0],
+                                arrival->rate[1] * 1000, arrival->dwell[1]);
+        }
+        return snprintf(buf, len, "%s:%g", arrival_names[arrival->type],
+                        arrival->rate[0] * 1000);
+}
+
+void arrival_destroy(struct arrival *arrival)
+{
+        if (arrival == NULL)
+                return;
+        pthread_mutex_destroy(&arrival->lock);
+        free(arrival->ring);
+        free(arrival);
+}
@@ -0,0 +1,285 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Completion reaping benchmark of libaio
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Keeps qdepth 4KB reads in flight on one aio context for a few seconds
+ * and compares the ways of reaping them: "getevents" is the old
+ * io_getevents() per reap, "ring" reads the completion ring first and
+ * "eventfd" reaps on a completer thread woken by IOCB_FLAG_RESFD. Buffered
+ * reads of a cached file complete in io_submit(), so the reaping is most
+ * of what is measured; give a block device to see it next to real I/O.
+ *
+ * usage: aio-reap-bench [file] [qdepth] [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <libaio.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include <trace_replay.h>
+#include <aio_ring.h>
+
+#define BENCH_FILE_SIZE (64 * MB)
+#define BENCH_IO_SIZE 4096
+
+enum bench_mode { BENCH_GETEVENTS = 0, BENCH_RING, BENCH_EVENTFD };
+
+static const char *mode_name[] = { "getevents", "ring", "eventfd" };
+
+struct bench {
+        io_context_t ctx;
+        int fd;
+        int efd;
+        int mode;
+        int qdepth;
+        long long nr_blocks;
+        struct iocb iocbs[MAX_QDEPTH];
+        char *bufs;
+
+        /* completer to submitter */
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        struct iocb *done[MAX_QDEPTH];
+        int nr_done;
+        int stop;
+        long long nr_syscalls;
+};
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+        return (end->tv_sec - start->tv_sec) +
+               (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int generate(const char *path)
+{
+        char *buf = calloc(1, MB);
+        int fd, i;
+
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || buf == NULL) {
+                printf(" cannot create %s\n", path);
+                free(buf);
+                return -1;
+        }
+        for (i = 0; i < BENCH_FILE_SIZE / MB; i++) {
+                if (write(fd, buf, MB) != MB) {
+                        printf(" cannot write %s\n", path);
+                        close(fd);
+                        free(buf);
+                        return -1;
+                }
+        }
+
+        free(buf);
+        return close(fd);
+}
+
+static void prep(struct bench *b, struct iocb *iocb)
+{
+        int n = (int)(iocb - b->iocbs);
+
+        io_prep_pread(iocb, b->fd, b->bufs + (size_t)n * BENCH_IO_SIZE,
+                      BENCH_IO_SIZE, (rand() % b->nr_blocks) * BENCH_IO_SIZE);
+        if (b->efd >= 0)
+                io_set_eventfd(iocb, b->efd);
+}
+
+static void *completer(void *data)
+{
+        struct bench *b = (struct bench *)data;
+        struct io_event events[MAX_QDEPTH];
+        uint64_t nr;
+        int n, i;
+
+        while (1) {
+                n = aio_ring_getevents(b->ctx, 1, 0, b->qdepth, events);
+                if (n <= 0) {
+                        pthread_mutex_lock(&b->mutex);
+                        i = b->stop;
+                        pthread_mutex_unlock(&b->mutex);
+                        if (i)
+                                break;
+                        b->nr_syscalls++;
+                        if (read(b->efd, &nr, sizeof(nr)) < 0 &&
+                            errno != EINTR)
+                                break;
+                        continue;
+                }
+
+                pthread_mutex_lock(&b->mutex);
+                for (i = 0; i < n; i++)
+                        b->done[b->nr_done++] = events[i].obj;
+                pthread_cond_signal(&b->cond);
+                pthread_mutex_unlock(&b->mutex);
+        }
+
+        return NULL;
+}
+
+/* returns the completions per second */
+static double run(struct bench *b, int mode, double seconds)
+{
+        struct io_event events[MAX_QDEPTH];
+        struct iocb *ioq[MAX_QDEPTH];
+        struct timespec start, now;
+        pthread_t thread;
+        long long nr_io = 0;
+        uint64_t one = 1;
+        double sec;
+        int inflight, n, i;
+
+        b->mode = mode;
+        b->nr_syscalls = 0;
+        b->nr_done = 0;
+        b->stop = 0;
+        b->efd = mode == BENCH_EVENTFD ? eventfd(0, EFD_CLOEXEC) : -1;
+        if (io_queue_init(b->qdepth, &b->ctx))
+                return -1.0;
+        if (mode != BENCH_GETEVENTS && !aio_ring_usable(b->ctx)) {
+                printf(" %s: no user space completion ring\n",
+                       mode_name[mode]);
+                io_queue_release(b->ctx);
+                return -1.0;
+        }
+        if (mode == BENCH_EVENTFD &&
+            (b->efd < 0 || pthread_create(&thread, NULL, completer, b)))
+                return -1.0;
+
+        for (i = 0; i < b->qdepth; i++) {
+                prep(b, &b->iocbs[i]);
+                ioq[i] = &b->iocbs[i];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        inflight = io_submit(b->ctx, b->qdepth, ioq);
+
+        do {
+                if (mode == BENCH_EVENTFD) {
+                        pthread_mutex_lock(&b->mutex);
+                        while (!b->nr_done)
+                                pthread_cond_wait(&b->cond, &b->mutex);
+                        n = b->nr_done;
+                        memcpy(ioq, b->done, sizeof(struct iocb *) * n);
+                        b->nr_done = 0;
+                        pthread_mutex_unlock(&b->mutex);
+                } else {
+                        n = 0;
+                        if (mode == BENCH_RING)
+                                n = aio_ring_peek(b->ctx, events, inflight);
+                        if (!n) {
+                                n = io_getevents(b->ctx, 1, inflight, events,
+                                                 NULL);
+                                b->nr_syscalls++;
+                        }
+                        for (i = 0; i < n; i++)
+                                ioq[i] = events[i].obj;
+                }
+                if (n <= 0)
+                        continue;
+
+                nr_io += n;
+                for (i = 0; i < n; i++)
+                        prep(b, ioq[i]);
+                inflight += io_submit(b->ctx, n, ioq) - n;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+        } while (elapsed(&start, &now) < seconds);
+        sec = elapsed(&start, &now);
+
+        /* drain what is still in flight */
+        if (mode == BENCH_EVENTFD) {
+                pthread_mutex_lock(&b->mutex);
+                b->stop = 1;
+                pthread_mutex_unlock(&b->mutex);
+                if (write(b->efd, &one, sizeof(one)) < 0)
+                        perror("eventfd");
+                pthread_join(thread, NULL);
+                inflight -= b->nr_done;
+                close(b->efd);
+        }
+        while (inflight > 0) {
+                n = io_getevents(b->ctx, 1, inflight, events, NULL);
+                if (n > 0)
+                        inflight -= n;
+        }
+        io_queue_release(b->ctx);
+
+        return nr_io / sec;
+}
+
+int main(int argc, char **argv)
+{
+        static struct bench b;
+        const char *path = "aio-reap-bench.dat";
+        double seconds = 3.0;
+        struct stat st;
+        int mode;
+
+        b.qdepth = 32;
+        if (argc > 1)
+                path = argv[1];
+        if (argc > 2)
+                b.qdepth = atoi(argv[2]);
+        if (argc > 3)
+                seconds = atof(argv[3]);
+        if (b.qdepth < 1 || b.qdepth > MAX_QDEPTH || seconds <= 0.0) {
+                printf(" usage: %s [file] [qdepth] [seconds]\n", argv[0]);
+                return -1;
+        }
+
+        if (stat(path, &st) && (generate(path) || stat(path, &st)))
+                return -1;
+        /* a device is read around the page cache, so the reads are async */
+        b.fd = open(path,
+                    S_ISBLK(st.st_mode) ? O_RDONLY | O_DIRECT : O_RDONLY);
+        if (b.fd < 0)
+                return -1;
+        b.nr_blocks = lseek(b.fd, 0, SEEK_END) / BENCH_IO_SIZE;
+        if (b.nr_blocks < 1) {
+                printf(" %s is smaller than %d bytes\n", path, BENCH_IO_SIZE);
+                return -1;
+        }
+
+        b.bufs = allocate_aligned_buffer((size_t)b.qdepth * BENCH_IO_SIZE);
+        if (b.bufs == NULL)
+                return -1;
+        pthread_mutex_init(&b.mutex, NULL);
+        pthread_cond_init(&b.cond, NULL);
+        srand(1);
+
+        printf("%10s %8s %10s %16s\n", "reap", "qdepth", "Kiops",
+               "reap syscalls/io");
+        for (mode = BENCH_GETEVENTS; mode <= BENCH_EVENTFD; mode++) {
+                double iops = run(&b, mode, seconds);
+
+                if (iops < 0.0)
+                        continue;
+                printf("%10s %8d %10.1f %16.3f\n", mode_name[mode], b.qdepth,
+                       iops / 1e3, b.nr_syscalls / (iops * seconds));
+        }
+
+        close(b.fd);
+        return 0;
+}
@@ -0,0 +1,156 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Cost and ratios of the write payload generator
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Fills qdepth rotating write buffers of io_kb with payload_fill() and
+ * reports the fill time per request next to a plain memcpy() of the same
+ * size, then checks what came out: the share of zero bytes against
+ * --compress and the share of repeated blocks against --dedupe.
+ *
+ * usage: payload-bench [io_kb] [requests] [qdepth]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <trace_replay.h>
+#include <payload.h>
+
+#define BENCH_SAMPLE_BLOCKS 65536
+
+static const int settings[][3] = {
+        /* compress, dedupe, refill */
+        { 0, 0, 1 },   { 0, 0, PAYLOAD_REFILL }, { 50, 0, PAYLOAD_REFILL },
+        { 50, 50, PAYLOAD_REFILL }, { 0, 0, 256 },
+};
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+        return (end->tv_sec - start->tv_sec) +
+               (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int hash_cmp(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *)a;
+        uint64_t y = *(const uint64_t *)b;
+
+        return (x > y) - (x < y);
+}
+
+static uint64_t block_hash(const char *block)
+{
+        const uint64_t *p = (const uint64_t *)block;
+        uint64_t h = 0xcbf29ce484222325ULL;
+        int i;
+
+        for (i = 0; i < PAYLOAD_BLOCK / 8; i++)
+                h = (h ^ p[i]) * 0x100000001b3ULL;
+        return h;
+}
+
+int main(int argc, char **argv)
+{
+        size_t io_size = 4 * KB;
+        long long nr_req = 1 << 20;
+        int qdepth = 32;
+        uint64_t *hashes;
+        char *bufs, *src;
+        int s;
+
+        if (argc > 1)
+                io_size = (size_t)atoi(argv[1]) * KB;
+        if (argc > 2)
+                nr_req = atoll(argv[2]);
+        if (argc > 3)
+                qdepth = atoi(argv[3]);
+        if (io_size < PAYLOAD_BLOCK || nr_req < 1 || qdepth < 1) {
+                printf(" usage: %s [io_kb] [requests] [qdepth]\n", argv[0]);
+                return -1;
+        }
+
+        bufs = allocate_aligned_buffer(io_size * qdepth);
+        src = allocate_aligned_buffer(io_size);
+        hashes = malloc(sizeof(uint64_t) * BENCH_SAMPLE_BLOCKS);
+        if (hashes == NULL)
+                return -1;
+        memset(bufs, 0, io_size * qdepth);
+        memset(src, 1, io_size);
+
+        printf("%8s %6s %6s %10s %10s %8s %8s\n", "compress", "dedupe",
+               "refill", "ns/req", "memcpy", "zeros", "dup");
+        for (s = 0; s < (int)(sizeof(settings) / sizeof(settings[0])); s++) {
+                struct payload *payload;
+                struct timespec start, end;
+                double fill, copy;
+                long long zeros = 0;
+                long long nr_blocks = 0, nr_dup = 0;
+                long long i;
+                size_t j;
+
+                payload = payload_create(0, settings[s][0], settings[s][1],
+                                         settings[s][2]);
+                if (payload == NULL)
+                        return -1;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0; i < nr_req; i++)
+                        payload_fill(payload, bufs + io_size * (i % qdepth),
+                                     io_size);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                fill = elapsed(&start, &end) * 1e9 / nr_req;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0; i < nr_req; i++)
+                        memcpy(bufs + io_size * (i % qdepth), src, io_size);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                copy = elapsed(&start, &end) * 1e9 / nr_req;
+
+                /* what the device would see, over a sample of the writes */
+                for (i = 0; nr_blocks < BENCH_SAMPLE_BLOCKS; i++) {
+                        char *buf = bufs + io_size * (i % qdepth);
+
+                        payload_fill(payload, buf, io_size);
+                        for (j = 0; j < io_size &&
+                                    nr_blocks < BENCH_SAMPLE_BLOCKS;
+                             j += PAYLOAD_BLOCK) {
+                                size_t k;
+
+                                for (k = 0; k < PAYLOAD_BLOCK; k++)
+                                        zeros += !buf[j + k];
+                                hashes[nr_blocks++] = block_hash(buf + j);
+                        }
+                }
+                qsort(hashes, nr_blocks, sizeof(uint64_t), hash_cmp);
+                for (i = 1; i < nr_blocks; i++)
+                        nr_dup += hashes[i] == hashes[i - 1];
+
+                printf("%7d%% %5d%% %6d %10.1f %10.1f %7.1f%% %7.1f%%\n",
+                       settings[s][0], settings[s][1], settings[s][2], fill,
+                       copy, 100.0 * zeros / (nr_blocks * PAYLOAD_BLOCK),
+                       100.0 * nr_dup / nr_blocks);
+                payload_destroy(payload);
+        }
+
+        free(hashes);
+        free(bufs);
+        free(src);
+        return 0;
+}
@@ -0,0 +1,164 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Dispatch scaling benchmark of the shared trace cursor
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Measures how many requests per second the per_thread workers of one trace
+ * can take off the trace, without any I/O. "spinlock" is the old scheme
+ * (one trace_lock round trip per request), "ticket" is trace_io_claim().
+ *
+ * usage: trace-cursor-bench [max_threads] [batch] [requests]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <trace_replay.h>
+
+#define BENCH_REPEAT 4
+
+static struct trace_info_t trace;
+static pthread_spinlock_t trace_lock;
+static long long spin_cur;
+static int batch = 32;
+static pthread_barrier_t barrier;
+
+static void *spinlock_worker(void *data)
+{
+        long long sum = 0;
+
+        pthread_barrier_wait(&barrier);
+        while (1) {
+                struct trace_io_req *io;
+                int i;
+
+                for (i = 0; i < batch; i++) {
+                        pthread_spin_lock(&trace_lock);
+                        if (spin_cur >= (long long)trace.trace_io_cnt *
+                                                trace.trace_repeat_num) {
+                                pthread_spin_unlock(&trace_lock);
+                                *(long long *)data = sum;
+                                return NULL;
+                        }
+                        io = &trace.trace_buf[spin_cur % trace.trace_io_cnt];
+                        spin_cur++;
+                        sum += io->blkno;
+                        pthread_spin_unlock(&trace_lock);
+                }
+        }
+}
+
+static void *ticket_worker(void *data)
+{
+        struct io_stat_t io_stat;
+        long long sum = 0;
+
+        memset(&io_stat, 0, sizeof(io_stat));
+        pthread_barrier_wait(&barrier);
+        while (1) {
+                double arrival_time;
+                int devno, bcount, flags;
+                long long blkno;
+                long long ticket;
+                int n, i;
+
+                n = trace_io_claim(&trace, &io_stat, 0, batch, &ticket);
+                if (!n)
+                        break;
+                for (i = 0; i < n; i++) {
+                        trace_io_get(&arrival_time, &devno, &blkno, &bcount,
+                                     &flags, &trace, ticket + i);
+                        sum += blkno;
+                }
+        }
+
+        *(long long *)data = sum;
+        return NULL;
+}
+
+static double run(void *(*worker)(void *), int nr_thread)
+{
+        pthread_t threads[MAX_THREADS];
+        long long sums[MAX_THREADS];
+        struct timespec start, end;
+        int t;
+
+        trace_reset(&trace);
+        spin_cur = 0;
+        pthread_barrier_init(&barrier, NULL, nr_thread + 1);
+        for (t = 0; t < nr_thread; t++)
+                pthread_create(&threads[t], NULL, worker, &sums[t]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_barrier_wait(&barrier);
+        for (t = 0; t < nr_thread; t++)
+                pthread_join(threads[t], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        pthread_barrier_destroy(&barrier);
+
+        return (double)trace.trace_io_cnt * trace.trace_repeat_num /
+               ((end.tv_sec - start.tv_sec) +
+                (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+        int max_threads = 16;
+        int nr_req = 1 << 20;
+        int t, i;
+
+        if (argc > 1)
+                max_threads = atoi(argv[1]);
+        if (argc > 2)
+                batch = atoi(argv[2]);
+        if (argc > 3)
+                nr_req = atoi(argv[3]);
+        if (max_threads < 1 || max_threads > MAX_THREADS || batch < 1 ||
+            nr_req < 1) {
+                printf(" usage: %s [max_threads] [batch] [requests]\n",
+                       argv[0]);
+                return -1;
+        }
+
+        trace.trace_buf = malloc(sizeof(struct trace_io_req) * nr_req);
+        if (trace.trace_buf == NULL)
+                return -1;
+        for (i = 0; i < nr_req; i++) {
+                trace.trace_buf[i].arrival_time = 0.0;
+                trace.trace_buf[i].blkno = i;
+                trace.trace_buf[i].bcount = SPP;
+        }
+        trace.trace_io_cnt = nr_req;
+        trace.trace_repeat_num = BENCH_REPEAT;
+        pthread_spin_init(&trace_lock, 0);
+
+        printf("%8s %8s %16s %16s\n", "threads", "batch", "spinlock(Mreq/s)",
+               "ticket(Mreq/s)");
+        for (t = 1; t <= max_threads; t *= 2) {
+                double spin = run(spinlock_worker, t);
+                double ticket = run(ticket_worker, t);
+
+                printf("%8d %8d %16.2f %16.2f\n", t, batch, spin / 1e6,
+                       ticket / 1e6);
+        }
+
+        pthread_spin_destroy(&trace_lock);
+        free(trace.trace_buf);
+        return 0;
+}
@@ -0,0 +1,166 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Load time benchmark of the overlap trimming
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Loads a synthetic trace with growing trimming windows (qdepth *
+ * per_thread). "linear" is the old scan over the whole window for every
+ * request, "index" is trace_io_put_req(). Both have to keep the same
+ * requests.
+ *
+ * usage: trace-load-bench [requests] [max_window] [wss_mb]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <trace_replay.h>
+
+static struct trace_io_req *reqs;
+static struct trace_io_req *linear_buf;
+static int linear_cnt;
+
+static int linear_put(int window, struct trace_io_req *req)
+{
+        struct trace_io_req *io;
+        int start;
+        int i;
+
+        start = (linear_cnt - window > 0) ? linear_cnt - window : 0;
+        for (i = start; i < linear_cnt; i++) {
+                io = &linear_buf[i];
+
+                if (io->devno == req->devno) {
+                        if (req->blkno < io->blkno &&
+                            (req->blkno + req->bcount) > io->blkno &&
+                            (req->blkno + req->bcount) <
+                                    (io->blkno + io->bcount)) {
+                                req->bcount = io->blkno - req->blkno;
+                        } else if (req->blkno <= io->blkno &&
+                                   (req->blkno + req->bcount) >=
+                                           (io->blkno + io->bcount)) {
+                                io->blkno = req->blkno;
+                                io->bcount = req->bcount;
+                                return 1;
+                        } else if (req->blkno >= io->blkno &&
+                                   (req->blkno + req->bcount) <=
+                                           (io->blkno + io->bcount)) {
+                                return 1;
+                        } else if (req->blkno > io->blkno &&
+                                   req->blkno < (io->blkno + io->bcount) &&
+                                   (req->blkno + req->bcount) >
+                                           (io->blkno + io->bcount)) {
+                                req->bcount =
+                                        req->bcount -
+                                        (io->blkno + io->bcount - req->blkno);
+                                req->blkno = io->blkno + io->bcount;
+                        }
+                }
+        }
+        linear_buf[linear_cnt++] = *req;
+
+        return 0;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+        return (end->tv_sec - start->tv_sec) +
+               (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+        static struct trace_info_t trace;
+        struct timespec start, end;
+        long long nr_sectors;
+        int nr_req = 1 << 18;
+        int max_window = 16384;
+        int wss_mb = 1024;
+        int window, i;
+
+        if (argc > 1)
+                nr_req = atoi(argv[1]);
+        if (argc > 2)
+                max_window = atoi(argv[2]);
+        if (argc > 3)
+                wss_mb = atoi(argv[3]);
+        if (nr_req < 1 || max_window < 1 || wss_mb < 1) {
+                printf(" usage: %s [requests] [max_window] [wss_mb]\n",
+                       argv[0]);
+                return -1;
+        }
+
+        /* 4KB - 256KB requests over wss_mb, so neighbours overlap often */
+        nr_sectors = (long long)wss_mb * MB / SECTOR_SIZE;
+        reqs = malloc(sizeof(struct trace_io_req) * nr_req);
+        linear_buf = malloc(sizeof(struct trace_io_req) * nr_req);
+        if (reqs == NULL || linear_buf == NULL)
+                return -1;
+        srand(1);
+        for (i = 0; i < nr_req; i++) {
+                reqs[i].arrival_time = i * 0.1;
+                reqs[i].devno = rand() % 2;
+                reqs[i].bcount = (1 + rand() % 64) * SPP;
+                reqs[i].blkno = (long long)rand() * SPP % nr_sectors;
+                reqs[i].flags = rand() % 2;
+        }
+
+        printf("%8s %10s %14s %14s %8s\n", "window", "kept", "linear(Mreq/s)",
+               "index(Mreq/s)", "speedup");
+        for (window = 64; window <= max_window; window *= 4) {
+                double linear, index;
+
+                linear_cnt = 0;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0; i < nr_req; i++) {
+                        struct trace_io_req req = reqs[i];
+                        linear_put(window, &req);
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                linear = nr_req / elapsed(&start, &end);
+
+                memset(&trace, 0, sizeof(trace));
+                trace.trace_window = window;
+                trace.trace_buf_size = 1024;
+                trace.trace_buf = malloc(sizeof(struct trace_io_req) * 1024);
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (i = 0; i < nr_req; i++) {
+                        struct trace_io_req req = reqs[i];
+                        trace_io_put_req(&trace, &req);
+                }
+                trace_io_put_done(&trace);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                index = nr_req / elapsed(&start, &end);
+
+                if (trace.trace_io_cnt != linear_cnt ||
+                    memcmp(trace.trace_buf, linear_buf,
+                           sizeof(struct trace_io_req) * linear_cnt)) {
+                        printf(" window %d: the trimmed traces differ\n",
+                               window);
+                        return -1;
+                }
+
+                printf("%8d %10d %14.2f %14.2f %7.1fx\n", window, linear_cnt,
+                       linear / 1e6, index / 1e6, index / linear);
+                free(trace.trace_buf);
+        }
+
+        free(reqs);
+        free(linear_buf);
+        return 0;
+}
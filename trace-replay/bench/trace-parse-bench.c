@@ -0,0 +1,183 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Parse throughput benchmark of text traces
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Generates a DiskSim ascii trace of size_mb (unless the file is already
+ * that large) and compares the read bandwidth of the file with the old
+ * fgets() + sscanf() loader and with trace_parse_fd() on 1 .. max_threads
+ * threads. The trimming window is 0, so only the parsing is measured.
+ *
+ * usage: trace-parse-bench [file] [size_mb] [max_threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <trace_replay.h>
+#include <trace_parse.h>
+
+#define BENCH_BUF_SIZE (4 * 1024 * 1024)
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+        return (end->tv_sec - start->tv_sec) +
+               (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int generate(const char *path, long long size)
+{
+        char *buf = malloc(BENCH_BUF_SIZE);
+        double arrival_time = 0.0;
+        long long written = 0;
+        FILE *fp;
+
+        fp = fopen(path, "w");
+        if (fp == NULL || buf == NULL) {
+                printf(" cannot create %s\n", path);
+                free(buf);
+                return -1;
+        }
+
+        srand(1);
+        printf(" generating %lld MB of trace in %s\n", size / MB, path);
+        while (written < size) {
+                int len = 0;
+
+                while (len < BENCH_BUF_SIZE - 128) {
+                        arrival_time += (rand() % 1000) / 1000.0;
+                        len += sprintf(buf + len, "%.6f %d %lld %d %x\n",
+                                       arrival_time, rand() % 2,
+                                       (long long)rand() * SPP % (1LL << 31),
+                                       (1 + rand() % 64) * SPP, rand() % 2);
+                }
+                if (fwrite(buf, len, 1, fp) != 1) {
+                        printf(" cannot write %s\n", path);
+                        fclose(fp);
+                        free(buf);
+                        return -1;
+                }
+                written += len;
+        }
+
+        free(buf);
+        return fclose(fp);
+}
+
+int main(int argc, char **argv)
+{
+        static struct trace_info_t trace;
+        const char *path = "trace-parse-bench.dat";
+        struct timespec start, end;
+        long long size = 10240LL * MB;
+        int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        char *buf, line[201];
+        struct stat st;
+        double sec;
+        long long nr;
+        FILE *fp;
+        int fd, t;
+
+        if (argc > 1)
+                path = argv[1];
+        if (argc > 2)
+                size = atoll(argv[2]) * MB;
+        if (argc > 3)
+                max_threads = atoi(argv[3]);
+        if (size < 1 || max_threads < 1) {
+                printf(" usage: %s [file] [size_mb] [max_threads]\n", argv[0]);
+                return -1;
+        }
+
+        if ((stat(path, &st) || st.st_size < size) && generate(path, size))
+                return -1;
+        stat(path, &st);
+
+        printf("%-16s %10s %12s\n", "", "MB/s", "Mlines/s");
+
+        buf = malloc(BENCH_BUF_SIZE);
+        fd = open(path, O_RDONLY);
+        if (fd < 0 || buf == NULL)
+                return -1;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (read(fd, buf, BENCH_BUF_SIZE) > 0)
+                ;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sec = elapsed(&start, &end);
+        printf("%-16s %10.1f %12s\n", "read", (double)st.st_size / MB / sec,
+               "-");
+        close(fd);
+        free(buf);
+
+        fp = fopen(path, "r");
+        if (fp == NULL)
+                return -1;
+        nr = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (fgets(line, 200, fp) != NULL) {
+                double arrival_time;
+                int devno, bcount;
+                long long blkno;
+                unsigned int flags;
+
+                if (sscanf(line, "%lf %d %lld %d %x\n", &arrival_time, &devno,
+                           &blkno, &bcount, &flags) == 5)
+                        nr++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sec = elapsed(&start, &end);
+        printf("%-16s %10.1f %12.2f\n", "sscanf",
+               (double)st.st_size / MB / sec, nr / sec / 1e6);
+        fclose(fp);
+
+        for (t = 1; t <= max_threads; t *= 2) {
+                char name[32];
+
+                memset(&trace, 0, sizeof(trace));
+                fd = open(path, O_RDONLY);
+                if (fd < 0)
+                        return -1;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                if (trace_parse_fd(&trace, fd, t)) {
+                        printf(" cannot parse %s\n", path);
+                        return -1;
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                sec = elapsed(&start, &end);
+                close(fd);
+
+                snprintf(name, sizeof(name), "parse(%d)", t);
+                printf("%-16s %10.1f %12.2f\n", name,
+                       (double)st.st_size / MB / sec,
+                       trace.trace_io_cnt / sec / 1e6);
+                if (trace.trace_io_cnt != nr) {
+                        printf(" %d requests parsed, %lld expected\n",
+                               trace.trace_io_cnt, nr);
+                        return -1;
+                }
+                free(trace.trace_buf);
+
+                if (t < max_threads && t * 2 > max_threads)
+                        t = max_threads / 2;
+        }
+
+        return 0;
+}
@@ -0,0 +1,108 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Cost of the verify mode stamps and checks
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Stamps and checks io_kb requests in memory, as the verify mode does for
+ * every write and read, and reports the ns per request and the GB/s, next
+ * to the table driven crc32c() the mode falls back to without the crc
+ * instructions.
+ *
+ * usage: verify-bench [io_kb] [requests]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <trace_replay.h>
+#include <verify.h>
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+        return (end->tv_sec - start->tv_sec) +
+               (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report(const char *name, double sec, long long nr_req,
+                   size_t io_size)
+{
+        printf("%-10s %10.1f %10.2f\n", name, sec * 1e9 / nr_req,
+               (double)io_size * nr_req / sec / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+        struct timespec start, end;
+        size_t io_size = 4 * KB;
+        long long nr_req = 1 << 20;
+        long long offset, bad_offset;
+        uint32_t crc = 0;
+        int nr_checked;
+        long long i;
+        char *buf;
+
+        if (argc > 1)
+                io_size = (size_t)atoi(argv[1]) * KB;
+        if (argc > 2)
+                nr_req = atoll(argv[2]);
+        if (io_size < VERIFY_SECTOR || nr_req < 1) {
+                printf(" usage: %s [io_kb] [requests]\n", argv[0]);
+                return -1;
+        }
+
+        buf = allocate_aligned_buffer(io_size);
+        for (i = 0; i < (long long)io_size; i++)
+                buf[i] = (char)rand();
+
+        printf("%-10s %10s %10s\n", "", "ns/req", "GB/s");
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < nr_req; i++)
+                verify_stamp(buf, io_size, i * (long long)io_size,
+                             (uint32_t)i, 1);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        report("stamp", elapsed(&start, &end), nr_req, io_size);
+
+        /* the buffer holds the last stamp */
+        offset = (nr_req - 1) * (long long)io_size;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < nr_req; i++)
+                if (verify_check(buf, io_size, offset, &nr_checked,
+                                 &bad_offset))
+                        return -1;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        report("check", elapsed(&start, &end), nr_req, io_size);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < nr_req; i++)
+                crc = crc32c(crc, buf, io_size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        report("crc32c", elapsed(&start, &end), nr_req, io_size);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < nr_req; i++)
+                crc = crc32c_sw(crc, buf, io_size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        report("table", elapsed(&start, &end), nr_req, io_size);
+
+        /* keeps the crc loops from being dropped */
+        if (crc == 0x12345678)
+                printf(" %x\n", crc);
+        free(buf);
+        return 0;
+}
@@ -18,6 +18,7 @@
 #include <trace_replay.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -62,6 +63,99 @@ void flush_buffer_cache(int fd)
 
 void disk_close(int fd)
 {
-        flush_buffer_cache(fd);
+        struct stat st;
+
+        /* a file has nothing but the page cache of its filesystem */
+        if (!fstat(fd, &st) && S_ISREG(st.st_mode))
+                fsync(fd);
+        else
+                flush_buffer_cache(fd);
+        close(fd);
+}
+
+static int file_prewrite(int fd, long long size)
+{
+        long long offset;
+        ssize_t len;
+        char *buf;
+
+        if (posix_memalign((void **)&buf, PAGE_SIZE, MB))
+                return -1;
+        memset(buf, 0x5a, MB);
+
+        for (offset = 0; offset < size; offset += len) {
+                len = size - offset < MB ? size - offset : MB;
+                len = pwrite(fd, buf, len, offset);
+                if (len <= 0) {
+                        free(buf);
+                        return -1;
+                }
+        }
+
+        free(buf);
+        return fsync(fd);
+}
+
+/*
+ * Makes the file at path a target of size bytes, or of its own size when
+ * size is 0; only a size creates a missing file. The blocks are
+ * preallocated, and prewrite writes them all once so that the replay does
+ * not pay for the conversion of unwritten extents. O_DIRECT is dropped
+ * from flags on a filesystem without it.
+ */
+int file_prepare(const char *path, long long size, int prewrite, int *flags,
+                 long long *capacity)
+{
+        int create = size ? O_CREAT : 0;
+        struct stat st;
+        int fd;
+
+        fd = open(path, *flags | create, 0644);
+        if (fd < 0 && errno == EINVAL && (*flags & O_DIRECT)) {
+                printf(" %s has no direct I/O, the page cache is used \n",
+                       path);
+                *flags &= ~O_DIRECT;
+                fd = open(path, *flags | create, 0644);
+        }
+        if (fd < 0) {
+                printf(" cannot open %s: %s \n", path, strerror(errno));
+                return -1;
+        }
+
+        if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+                printf(" %s is neither a block device nor a file \n", path);
+                goto err;
+        }
+        if (!size)
+                size = st.st_size;
+        size -= size % PAGE_SIZE;
+        if (size <= 0) {
+                printf(" %s is empty, it needs a size (--file-size) \n",
+                       path);
+                goto err;
+        }
+
+        if (fallocate(fd, 0, 0, size)) {
+                /* it still works, on blocks allocated by the writes */
+                printf(" cannot preallocate %s: %s \n", path,
+                       strerror(errno));
+                if (st.st_size < size && ftruncate(fd, size))
+                        goto err;
+        }
+
+        if (prewrite) {
+                printf(" prewriting %s (%lld MB) \n", path, size / MB);
+                if (file_prewrite(fd, size)) {
+                        printf(" cannot prewrite %s: %s \n", path,
+                               strerror(errno));
+                        goto err;
+                }
+        }
+
+        close(fd);
+        *capacity = size;
+        return 0;
+err:
         close(fd);
+        return -1;
 }
@@ -0,0 +1,288 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Binary log of the latency histograms over time
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <hist_log.h>
+
+/* trace, time, nr_buckets and a pair per bucket */
+#define HIST_LOG_RECORD_MAX                                                    \
+        (3 * HIST_LOG_VARINT_MAX + 2 * HIST_LOG_VARINT_MAX * HIST_NR_BUCKETS)
+
+static int put_varint(unsigned char *p, unsigned long long val)
+{
+        int len = 0;
+
+        while (val >= 0x80) {
+                p[len++] = (unsigned char)(val | 0x80);
+                val >>= 7;
+        }
+        p[len++] = (unsigned char)val;
+        return len;
+}
+
+static const unsigned char *get_varint(const unsigned char *p,
+                                       const unsigned char *end,
+                                       unsigned long long *val)
+{
+        unsigned long long v = 0;
+        int shift;
+
+        for (shift = 0; p < end && shift < 64; shift += 7) {
+                v |= (unsigned long long)(*p & 0x7f) << shift;
+                if (!(*p++ & 0x80)) {
+                        *val = v;
+                        return p;
+                }
+        }
+        return NULL;
+}
+
+static int hist_log_grow(struct hist_log *log, size_t need)
+{
+        size_t size = log->map_size;
+        void *map;
+
+        while (size < need)
+                size += HIST_LOG_GROW;
+        if (size == log->map_size)
+                return 0;
+
+        if (ftruncate(log->fd, size))
+                return -1;
+        map = mremap(log->map, log->map_size, size, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED)
+                return -1;
+        log->map = map;
+        log->map_size = size;
+        return 0;
+}
+
+struct hist_log *hist_log_create(const char *path, int nr_trace)
+{
+        struct hist_log_header header;
+        struct hist_log *log;
+        struct timeval tv;
+
+        log = calloc(1, sizeof(struct hist_log));
+        if (log == NULL)
+                return NULL;
+
+        log->nr_trace = nr_trace;
+        log->record = malloc(HIST_LOG_RECORD_MAX);
+        log->last = calloc(nr_trace, sizeof(struct latency_hist));
+        log->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (log->record == NULL || log->last == NULL || log->fd < 0)
+                goto err;
+
+        log->map_size = HIST_LOG_GROW;
+        if (ftruncate(log->fd, log->map_size))
+                goto err;
+        log->map = mmap(NULL, log->map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, log->fd, 0);
+        if (log->map == MAP_FAILED) {
+                log->map = NULL;
+                goto err;
+        }
+
+        gettimeofday(&tv, NULL);
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HIST_LOG_MAGIC, sizeof(header.magic));
+        header.version = HIST_LOG_VERSION;
+        header.sub_bits = HIST_SUB_BITS;
+        header.max_bits = HIST_MAX_BITS;
+        header.nr_trace = nr_trace;
+        header.start_time = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        memcpy(log->map, &header, sizeof(header));
+        log->len = sizeof(header);
+
+        return log;
+err:
+        hist_log_close(log);
+        return NULL;
+}
+
+/*
+ * hist is the cumulative histogram of the trace, the record is what it
+ * gained since the last one. A histogram which went back (was reset) is
+ * taken as new.
+ */
+int hist_log_append(struct hist_log *log, int trace, unsigned long long now_us,
+                    const struct latency_hist *hist)
+{
+        struct latency_hist *last;
+        unsigned char head[3 * HIST_LOG_VARINT_MAX];
+        unsigned char prefix[HIST_LOG_VARINT_MAX];
+        unsigned char *p = log->record;
+        int hlen, plen, prev = 0, nr = 0;
+        size_t len, need;
+        int i;
+
+        if (trace < 0 || trace >= log->nr_trace)
+                return -1;
+
+        last = &log->last[trace];
+        for (i = 0; i < HIST_NR_BUCKETS; i++) {
+                unsigned long long count = hist->counts[i];
+                unsigned long long delta = count >= last->counts[i] ?
+                                                   count - last->counts[i] :
+                                                   count;
+
+                if (!delta)
+                        continue;
+                p += put_varint(p, i - prev);
+                p += put_varint(p, delta);
+                last->counts[i] = count;
+                prev = i;
+                nr++;
+        }
+
+        hlen = put_varint(head, trace);
+        hlen += put_varint(head + hlen,
+                           now_us > log->last_us ? now_us - log->last_us : 0);
+        hlen += put_varint(head + hlen, nr);
+        len = hlen + (p - log->record);
+
+        /* keep a zero byte after the record to end the log */
+        need = log->len + HIST_LOG_VARINT_MAX + len + 1;
+        if (hist_log_grow(log, need))
+                return -1;
+
+        /* the length goes last, a reader never sees half a record */
+        p = log->map + log->len;
+        plen = put_varint(prefix, len);
+        memcpy(p + plen, head, hlen);
+        memcpy(p + plen + hlen, log->record, len - hlen);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(p, prefix, plen);
+
+        log->len += plen + len;
+        if (now_us > log->last_us)
+                log->last_us = now_us;
+        return 0;
+}
+
+void hist_log_close(struct hist_log *log)
+{
+        if (log == NULL)
+                return;
+
+        if (log->map) {
+                munmap(log->map, log->map_size);
+                if (ftruncate(log->fd, log->len))
+                        perror("ftruncate: hist log");
+        }
+        if (log->fd >= 0)
+                close(log->fd);
+        free(log->record);
+        free(log->last);
+        free(log);
+}
+
+int hist_log_open(struct hist_log_reader *reader, const char *path)
+{
+        const struct hist_log_header *header;
+        struct stat st;
+        void *map;
+        int fd;
+
+        memset(reader, 0, sizeof(struct hist_log_reader));
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -1;
+        if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*header)) {
+                close(fd);
+                return -1;
+        }
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return -1;
+
+        header = map;
+        if (memcmp(header->magic, HIST_LOG_MAGIC, sizeof(header->magic)) ||
+            header->version != HIST_LOG_VERSION ||
+            header->sub_bits != HIST_SUB_BITS ||
+            header->max_bits != HIST_MAX_BITS) {
+                munmap(map, st.st_size);
+                return -1;
+        }
+
+        reader->map = map;
+        reader->size = st.st_size;
+        reader->pos = sizeof(*header);
+        reader->nr_trace = header->nr_trace;
+        reader->start_time = header->start_time;
+        return 0;
+}
+
+/* 1 with the next record in delta, 0 at the end, -1 for a broken log */
+int hist_log_next(struct hist_log_reader *reader, int *trace,
+                  struct latency_hist *delta)
+{
+        const unsigned char *p = reader->map + reader->pos;
+        const unsigned char *end = reader->map + reader->size;
+        unsigned long long len, val, time, nr, count;
+        int index = 0;
+
+        if (p >= end || !*p)
+                return 0;
+        p = get_varint(p, end, &len);
+        if (p == NULL || len > (unsigned long long)(end - p))
+                return -1;
+        end = p + len;
+
+        p = get_varint(p, end, &val);
+        if (p == NULL || val >= (unsigned long long)reader->nr_trace)
+                return -1;
+        *trace = (int)val;
+        p = get_varint(p, end, &time);
+        if (p == NULL || (p = get_varint(p, end, &nr)) == NULL)
+                return -1;
+
+        latency_hist_reset(delta);
+        while (nr--) {
+                p = get_varint(p, end, &val);
+                if (p == NULL || (p = get_varint(p, end, &count)) == NULL ||
+                    val >= (unsigned long long)(HIST_NR_BUCKETS - index))
+                        return -1;
+                index += (int)val;
+                delta->counts[index] = count;
+                delta->total_count += count;
+        }
+        if (p != end)
+                return -1;
+
+        reader->time_us += time;
+        reader->pos = end - reader->map;
+        return 1;
+}
+
+void hist_log_reader_close(struct hist_log_reader *reader)
+{
+        if (reader->map)
+                munmap((void *)reader->map, reader->size);
+        reader->map = NULL;
+}
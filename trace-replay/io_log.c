@@ -0,0 +1,227 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Per-I/O completion log with a writer thread
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <io_log.h>
+
+/* buf goes out whole, or padded to IO_LOG_ALIGN with zeros on the flush */
+static void io_log_flush(struct io_log *log, int final)
+{
+        size_t len = log->buf_len;
+
+        if (!len || (!final && len < IO_LOG_BUF_SIZE))
+                return;
+
+        len = (len + IO_LOG_ALIGN - 1) / IO_LOG_ALIGN * IO_LOG_ALIGN;
+        memset(log->buf + log->buf_len, 0, len - log->buf_len);
+        if (!log->error &&
+            pwrite(log->fd, log->buf, len, log->offset) != (ssize_t)len) {
+                perror("pwrite: io log");
+                log->error = 1;
+        }
+        log->offset += log->buf_len;
+        log->buf_len = 0;
+}
+
+static void io_log_drain(struct io_log *log, struct io_log_ring *ring)
+{
+        unsigned long long tail = ring->tail;
+        unsigned long long head =
+                __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+                size_t room = (IO_LOG_BUF_SIZE - log->buf_len) /
+                              sizeof(struct io_log_rec);
+                size_t nr = head - tail;
+                size_t wrap = IO_LOG_RING - (tail & (IO_LOG_RING - 1));
+
+                if (nr > room)
+                        nr = room;
+                if (nr > wrap)
+                        nr = wrap;
+                memcpy(log->buf + log->buf_len,
+                       &ring->recs[tail & (IO_LOG_RING - 1)],
+                       nr * sizeof(struct io_log_rec));
+                log->buf_len += nr * sizeof(struct io_log_rec);
+                log->nr_written += nr;
+                tail += nr;
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+                io_log_flush(log, 0);
+        }
+}
+
+static void *io_log_writer(void *data)
+{
+        struct io_log *log = (struct io_log *)data;
+        int stop, i;
+
+        do {
+                stop = __atomic_load_n(&log->stop, __ATOMIC_ACQUIRE);
+                for (i = 0; i < log->nr_thread; i++)
+                        io_log_drain(log, &log->rings[i]);
+                if (!stop)
+                        usleep(IO_LOG_POLL_US);
+        } while (!stop);
+
+        io_log_flush(log, 1);
+        return NULL;
+}
+
+struct io_log *io_log_create(const char *path, int nr_thread, int per_thread,
+                             int sample)
+{
+        struct io_log_header *header;
+        struct io_log *log;
+        struct timeval tv;
+        int i;
+
+        log = calloc(1, sizeof(struct io_log));
+        if (log == NULL)
+                return NULL;
+
+        log->fd = -1;
+        log->nr_thread = nr_thread;
+        log->rings = calloc(nr_thread, sizeof(struct io_log_ring));
+        if (log->rings == NULL ||
+            posix_memalign((void **)&log->buf, IO_LOG_ALIGN, IO_LOG_BUF_SIZE))
+                goto err;
+        for (i = 0; i < nr_thread; i++) {
+                log->rings[i].recs =
+                        malloc(sizeof(struct io_log_rec) * IO_LOG_RING);
+                if (log->rings[i].recs == NULL)
+                        goto err;
+                log->rings[i].sample = sample;
+                log->rings[i].sample_left = sample;
+        }
+
+        /* tmpfs and a few others have no O_DIRECT */
+        log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (log->fd < 0)
+                log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log->fd < 0)
+                goto err;
+
+        gettimeofday(&tv, NULL);
+        memset(log->buf, 0, IO_LOG_HEADER_SIZE);
+        header = (struct io_log_header *)log->buf;
+        memcpy(header->magic, IO_LOG_MAGIC, sizeof(header->magic));
+        header->version = IO_LOG_VERSION;
+        header->rec_size = sizeof(struct io_log_rec);
+        header->nr_thread = nr_thread;
+        header->per_thread = per_thread;
+        header->sample = sample;
+        header->start_time = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        if (pwrite(log->fd, log->buf, IO_LOG_HEADER_SIZE, 0) !=
+            IO_LOG_HEADER_SIZE)
+                goto err;
+        log->offset = IO_LOG_HEADER_SIZE;
+
+        if (pthread_create(&log->writer, NULL, io_log_writer, log))
+                goto err;
+        return log;
+err:
+        if (log->fd >= 0)
+                close(log->fd);
+        if (log->rings)
+                for (i = 0; i < nr_thread; i++)
+                        free(log->rings[i].recs);
+        free(log->rings);
+        free(log->buf);
+        free(log);
+        return NULL;
+}
+
+/* after the workers are done, writes what is left */
+void io_log_close(struct io_log *log)
+{
+        unsigned long long nr_dropped = 0;
+        int i;
+
+        if (log == NULL)
+                return;
+
+        __atomic_store_n(&log->stop, 1, __ATOMIC_RELEASE);
+        pthread_join(log->writer, NULL);
+        /* the last block was padded */
+        if (ftruncate(log->fd, log->offset))
+                perror("ftruncate: io log");
+        close(log->fd);
+
+        for (i = 0; i < log->nr_thread; i++) {
+                nr_dropped += log->rings[i].nr_dropped;
+                free(log->rings[i].recs);
+        }
+        printf(" io log: %lld records, %llu dropped \n", log->nr_written,
+               nr_dropped);
+
+        free(log->rings);
+        free(log->buf);
+        free(log);
+}
+
+int io_log_open(struct io_log_reader *reader, const char *path)
+{
+        const struct io_log_header *header;
+        struct stat st;
+        void *map;
+        int fd;
+
+        memset(reader, 0, sizeof(struct io_log_reader));
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -1;
+        if (fstat(fd, &st) || st.st_size < IO_LOG_HEADER_SIZE) {
+                close(fd);
+                return -1;
+        }
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return -1;
+
+        header = map;
+        if (memcmp(header->magic, IO_LOG_MAGIC, sizeof(header->magic)) ||
+            header->version != IO_LOG_VERSION ||
+            header->rec_size != sizeof(struct io_log_rec)) {
+                munmap(map, st.st_size);
+                return -1;
+        }
+
+        reader->header = header;
+        reader->recs = (const struct io_log_rec *)((const char *)map +
+                                                   IO_LOG_HEADER_SIZE);
+        reader->nr_recs = (st.st_size - IO_LOG_HEADER_SIZE) /
+                          sizeof(struct io_log_rec);
+        reader->size = st.st_size;
+        return 0;
+}
+
+void io_log_reader_close(struct io_log_reader *reader)
+{
+        if (reader->header)
+                munmap((void *)reader->header, reader->size);
+        reader->header = NULL;
+}
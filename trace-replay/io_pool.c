@@ -0,0 +1,204 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Per-thread io_job and I/O buffer pool
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <trace_replay.h>
+#include <io_pool.h>
+#include <affinity.h>
+
+/*
+ * A pool belongs to one worker thread, so nothing here is locked.
+ * Each buffer class owns an arena large enough for nr_jobs buffers. The
+ * arena is only reserved (MAP_NORESERVE) and buffers are carved from it
+ * on first use, so memory follows what the trace actually touches.
+ */
+
+int io_pool_class(size_t bytes)
+{
+        unsigned long long pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+
+        if (pages <= 1)
+                return 0;
+        return 64 - __builtin_clzll(pages - 1);
+}
+
+static char *io_pool_map(size_t size, int *hugepage)
+{
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+        void *p;
+
+        if (*hugepage) {
+                p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         flags | MAP_HUGETLB, -1, 0);
+                if (p != MAP_FAILED)
+                        return p;
+
+                /* no reserved hugepages, let THP back the arena instead */
+                *hugepage = 0;
+                p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+                if (p == MAP_FAILED)
+                        return NULL;
+                madvise(p, size, MADV_HUGEPAGE);
+                return p;
+        }
+
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED)
+                return NULL;
+        return p;
+}
+
+struct io_pool *io_pool_create(int nr_jobs, size_t max_bytes, int hugepage)
+{
+        struct io_pool *pool;
+        int i;
+
+        pool = calloc(1, sizeof(struct io_pool));
+        if (pool == NULL)
+                return NULL;
+
+        pool->nr_jobs = nr_jobs;
+        pool->jobs = calloc(nr_jobs, sizeof(struct io_job));
+        pool->free_jobs = calloc(nr_jobs, sizeof(struct io_job *));
+        if (pool->jobs == NULL || pool->free_jobs == NULL)
+                goto err;
+
+        for (i = 0; i < nr_jobs; i++)
+                pool->free_jobs[i] = &pool->jobs[nr_jobs - 1 - i];
+        pool->nr_free_jobs = nr_jobs;
+
+        if (max_bytes > (size_t)MAX_BYTES)
+                max_bytes = MAX_BYTES;
+        pool->nr_classes = io_pool_class(max_bytes) + 1;
+
+        for (i = 0; i < pool->nr_classes; i++) {
+                struct io_pool_class *class = &pool->classes[i];
+
+                class->buf_size = (size_t)PAGE_SIZE << i;
+                class->arena_size = class->buf_size * nr_jobs;
+                class->hugepage = hugepage;
+                if (hugepage)
+                        class->arena_size = (class->arena_size + HUGEPAGE_SIZE -
+                                             1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+
+                class->arena = io_pool_map(class->arena_size, &class->hugepage);
+                class->free_bufs = calloc(nr_jobs, sizeof(char *));
+                if (class->arena == NULL || class->free_bufs == NULL) {
+                        fprintf(stderr, "io_pool: cannot map %zuB arena\n",
+                                class->arena_size);
+                        goto err;
+                }
+        }
+
+        return pool;
+err:
+        io_pool_destroy(pool);
+        return NULL;
+}
+
+struct io_job *io_pool_get_job(struct io_pool *pool)
+{
+        if (!pool->nr_free_jobs)
+                return NULL;
+        return pool->free_jobs[--pool->nr_free_jobs];
+}
+
+void io_pool_put_job(struct io_pool *pool, struct io_job *job)
+{
+        pool->free_jobs[pool->nr_free_jobs++] = job;
+}
+
+char *io_pool_get_buf(struct io_pool *pool, size_t bytes, int *buf_class)
+{
+        struct io_pool_class *class;
+        int k = io_pool_class(bytes);
+
+        *buf_class = -1;
+        if (k >= pool->nr_classes)
+                return NULL;
+
+        class = &pool->classes[k];
+        if (class->nr_free) {
+                *buf_class = k;
+                return class->free_bufs[--class->nr_free];
+        }
+        if (class->nr_carved < pool->nr_jobs) {
+                *buf_class = k;
+                return class->arena + class->buf_size * class->nr_carved++;
+        }
+
+        return NULL;
+}
+
+void io_pool_put_buf(struct io_pool *pool, char *buf, int buf_class)
+{
+        struct io_pool_class *class = &pool->classes[buf_class];
+
+        class->free_bufs[class->nr_free++] = buf;
+}
+
+/* one iovec per class, so a class number is also its registered index */
+int io_pool_iovecs(struct io_pool *pool, struct iovec *iov, int max)
+{
+        int i;
+
+        for (i = 0; i < pool->nr_classes && i < max; i++) {
+                iov[i].iov_base = pool->classes[i].arena;
+                iov[i].iov_len = pool->classes[i].arena_size;
+        }
+
+        return i;
+}
+
+/* the arenas are not faulted in yet, so their pages all come from node */
+int io_pool_bind(struct io_pool *pool, int node)
+{
+        int i;
+
+        for (i = 0; i < pool->nr_classes; i++) {
+                if (affinity_bind(pool->classes[i].arena,
+                                  pool->classes[i].arena_size, node))
+                        return -1;
+        }
+
+        return 0;
+}
+
+void io_pool_destroy(struct io_pool *pool)
+{
+        int i;
+
+        if (pool == NULL)
+                return;
+
+        for (i = 0; i < pool->nr_classes; i++) {
+                struct io_pool_class *class = &pool->classes[i];
+
+                if (class->arena)
+                        munmap(class->arena, class->arena_size);
+                free(class->free_bufs);
+        }
+        free(pool->free_jobs);
+        free(pool->jobs);
+        free(pool);
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Log-linear latency histogram
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <string.h>
+
+#include <latency_hist.h>
+
+/* middle of the bucket's value range */
+unsigned long long latency_hist_value(int index)
+{
+        int shift;
+        unsigned long long sub;
+
+        if (index < 2 * HIST_SUB_COUNT)
+                return index;
+
+        index -= 2 * HIST_SUB_COUNT;
+        shift = index / HIST_SUB_COUNT + 1;
+        sub = index % HIST_SUB_COUNT + HIST_SUB_COUNT;
+
+        return (sub << shift) + (1ULL << (shift - 1));
+}
+
+void latency_hist_reset(struct latency_hist *hist)
+{
+        memset(hist, 0, sizeof(struct latency_hist));
+}
+
+void latency_hist_merge(struct latency_hist *dst,
+                        const struct latency_hist *src)
+{
+        unsigned long long total = 0;
+        int i;
+
+        for (i = 0; i < HIST_NR_BUCKETS; i++) {
+                unsigned long long count =
+                        __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+
+                dst->counts[i] += count;
+                total += count;
+        }
+        /* the buckets may be ahead of src->total_count while it records */
+        dst->total_count += total;
+}
+
+unsigned long long latency_hist_percentile(const struct latency_hist *hist,
+                                           double percentile)
+{
+        unsigned long long target;
+        unsigned long long sum = 0;
+        double rank;
+        int i;
+
+        if (!hist->total_count)
+                return 0;
+
+        rank = percentile / 100 * hist->total_count;
+        target = (unsigned long long)rank;
+        if (target < rank)
+                target++;
+        if (target < 1)
+                target = 1;
+        if (target > hist->total_count)
+                target = hist->total_count;
+
+        for (i = 0; i < HIST_NR_BUCKETS; i++) {
+                sum += hist->counts[i];
+                if (sum >= target)
+                        return latency_hist_value(i);
+        }
+
+        return latency_hist_value(HIST_NR_BUCKETS - 1);
+}
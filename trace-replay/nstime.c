@@ -0,0 +1,113 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Monotonic nanosecond clock
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <errno.h>
+
+#include <nstime.h>
+#ifdef NSTIME_HAVE_TSC
+#include <cpuid.h>
+#endif
+
+struct nstime_tsc nstime_tsc;
+
+#ifdef NSTIME_HAVE_TSC
+/* CPUID.80000007H:EDX[8], the TSC ticks at a constant rate in every state */
+static int nstime_tsc_invariant(void)
+{
+        unsigned int eax, ebx, ecx, edx;
+
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+                return 0;
+        return !!(edx & (1 << 8));
+}
+#endif
+
+/*
+ * Must run before any thread takes a timestamp. Returns -1 when the TSC was
+ * asked for but cannot be used, CLOCK_MONOTONIC_RAW is kept then.
+ */
+int nstime_init(int use_tsc)
+{
+#ifdef NSTIME_HAVE_TSC
+        unsigned long long ns0, ns1, tsc0, tsc1;
+
+        nstime_tsc.enabled = 0;
+        if (!use_tsc)
+                return 0;
+        if (!nstime_tsc_invariant())
+                return -1;
+
+        ns0 = nstime_raw();
+        tsc0 = __rdtsc();
+        do {
+                ns1 = nstime_raw();
+                tsc1 = __rdtsc();
+        } while (ns1 - ns0 < NSTIME_CALIBRATE_NS);
+        if (tsc1 <= tsc0)
+                return -1;
+
+        nstime_tsc.mult = ((ns1 - ns0) << NSTIME_TSC_SHIFT) / (tsc1 - tsc0);
+        nstime_tsc.base_tsc = tsc1;
+        nstime_tsc.base_ns = ns1;
+        nstime_tsc.enabled = 1;
+        return 0;
+#else
+        return use_tsc ? -1 : 0;
+#endif
+}
+
+const char *nstime_source(void)
+{
+        return nstime_tsc.enabled ? "tsc" : "CLOCK_MONOTONIC_RAW";
+}
+
+/* the CLOCK_MONOTONIC time of deadline (an nstime_now() value) - early */
+void nstime_monotonic(unsigned long long deadline, unsigned long long early,
+                      struct timespec *ts)
+{
+        unsigned long long now = nstime_now();
+        unsigned long long mono;
+
+        clock_gettime(CLOCK_MONOTONIC, ts);
+        mono = (unsigned long long)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+        if (deadline > now + early)
+                mono += deadline - now - early;
+        ts->tv_sec = mono / NSEC_PER_SEC;
+        ts->tv_nsec = mono % NSEC_PER_SEC;
+}
+
+/*
+ * Waits for deadline (an nstime_now() value). CLOCK_MONOTONIC_RAW cannot be
+ * slept on, so the coarse part is an absolute CLOCK_MONOTONIC sleep which
+ * ends spin_ns early, and the rest is spun on nstime_now(). The spin also
+ * takes up the timer slack and the few ppm between the two clocks.
+ */
+void nstime_sleep_until(unsigned long long deadline,
+                        unsigned long long spin_ns)
+{
+        struct timespec ts;
+
+        if (deadline > nstime_now() + spin_ns) {
+                nstime_monotonic(deadline, spin_ns, &ts);
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+                                       NULL) == EINTR)
+                        ;
+        }
+
+        while (nstime_now() < deadline)
+                nstime_relax();
+}
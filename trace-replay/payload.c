@@ -0,0 +1,188 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Write payloads of a given compressibility and dedupe ratio
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <trace_replay.h>
+#include <payload.h>
+
+#define PAYLOAD_LANES 4
+
+static inline uint64_t xorshift128p(uint64_t *s)
+{
+        uint64_t x = s[0];
+        uint64_t y = s[1];
+
+        s[0] = y;
+        x ^= x << 23;
+        s[1] = x ^ y ^ (x >> 17) ^ (y >> 26);
+        return s[1] + y;
+}
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+        uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
+
+/*
+ * PAYLOAD_LANES independent xorshift128+ generators, one per 64 bit lane,
+ * which the compiler turns into vector code.
+ */
+static void fill_random(uint64_t *p, size_t nr, uint64_t seed)
+{
+        uint64_t s0[PAYLOAD_LANES], s1[PAYLOAD_LANES];
+        size_t i;
+        int l;
+
+        for (l = 0; l < PAYLOAD_LANES; l++) {
+                s0[l] = splitmix64(&seed);
+                s1[l] = splitmix64(&seed) | 1;
+        }
+
+        for (i = 0; i + PAYLOAD_LANES <= nr; i += PAYLOAD_LANES) {
+                for (l = 0; l < PAYLOAD_LANES; l++) {
+                        uint64_t x = s0[l];
+                        uint64_t y = s1[l];
+
+                        s0[l] = y;
+                        x ^= x << 23;
+                        s1[l] = x ^ y ^ (x >> 17) ^ (y >> 26);
+                        p[i + l] = s1[l] + y;
+                }
+        }
+        for (; i < nr; i++)
+                p[i] = splitmix64(&seed);
+}
+
+static inline uint64_t stamp_check(const struct payload *payload, uint64_t x)
+{
+        uint64_t seed = x ^ ((uint64_t)payload->compress << 56);
+
+        return splitmix64(&seed);
+}
+
+/* random data and zeros under a stamp, see payload.h */
+static void fill_block(const struct payload *payload, char *block, size_t len,
+                       uint64_t stamp, uint64_t seed)
+{
+        uint64_t head[2] = { stamp, stamp_check(payload, stamp) };
+        size_t random_bytes = payload->random_bytes;
+
+        if (len < PAYLOAD_BLOCK) {
+                if (len < PAYLOAD_STAMP) {
+                        memcpy(block, head, len);
+                        return;
+                }
+                if (random_bytes > len - PAYLOAD_STAMP)
+                        random_bytes = (len - PAYLOAD_STAMP) & ~(size_t)7;
+        }
+
+        memcpy(block, head, PAYLOAD_STAMP);
+        fill_random((uint64_t *)(block + PAYLOAD_STAMP), random_bytes / 8,
+                    seed);
+        memset(block + PAYLOAD_STAMP + random_bytes, 0,
+               len - PAYLOAD_STAMP - random_bytes);
+}
+
+/* id keeps the stamps of the workers apart */
+struct payload *payload_create(int id, int compress, int dedupe, int refill)
+{
+        struct payload *payload;
+        int i;
+
+        payload = calloc(1, sizeof(struct payload));
+        if (payload == NULL)
+                return NULL;
+
+        payload->pool = allocate_aligned_buffer((size_t)PAYLOAD_DUP_BLOCKS *
+                                                PAYLOAD_BLOCK);
+        if (payload->pool == NULL) {
+                free(payload);
+                return NULL;
+        }
+
+        payload->compress = compress;
+        payload->dedupe = dedupe;
+        payload->refill = refill > 0 ? refill : 1;
+        payload->random_bytes = ((size_t)(PAYLOAD_BLOCK - PAYLOAD_STAMP) *
+                                 (100 - compress) / 100) &
+                                ~(size_t)7;
+        /* the top bit tells the duplicate stamps from the unique ones */
+        payload->id = (uint64_t)(id & 0x7fff) << 48;
+        /* replayers on other devices must not write the same data */
+        payload->rand[0] = PAYLOAD_SEED ^ id ^ (uint64_t)getpid() << 32;
+        payload->rand[1] = splitmix64(&payload->rand[0]) | 1;
+
+        for (i = 0; i < PAYLOAD_DUP_BLOCKS; i++)
+                fill_block(payload, payload->pool + (size_t)i * PAYLOAD_BLOCK,
+                           PAYLOAD_BLOCK, 1ULL << 63 | i, PAYLOAD_SEED + i);
+
+        return payload;
+}
+
+/*
+ * A unique block gets new random data on every refill-th write, and when
+ * it does not hold a stamped block of the same compressibility (a new
+ * buffer, or one read into). In between only the stamp changes, which is
+ * all it takes to be unique, so most writes cost PAYLOAD_STAMP bytes per
+ * block. A duplicate is copied from the pool.
+ */
+void payload_fill(struct payload *payload, char *buf, size_t bytes)
+{
+        int refill = !(payload->nr_fills++ % payload->refill);
+        uint64_t *head, r, stamp;
+        size_t off, len;
+        int block;
+
+        for (off = 0; off < bytes; off += PAYLOAD_BLOCK) {
+                len = bytes - off < PAYLOAD_BLOCK ? bytes - off :
+                                                    PAYLOAD_BLOCK;
+                head = (uint64_t *)(buf + off);
+                r = xorshift128p(payload->rand);
+
+                if ((r >> 32) % 100 < (uint64_t)payload->dedupe) {
+                        block = (int)(r % PAYLOAD_DUP_BLOCKS);
+                        memcpy(buf + off,
+                               payload->pool + (size_t)block * PAYLOAD_BLOCK,
+                               len);
+                        continue;
+                }
+
+                stamp = payload->id | payload->seq++;
+                if (refill || len < PAYLOAD_BLOCK ||
+                    head[1] != stamp_check(payload, head[0])) {
+                        fill_block(payload, buf + off, len, stamp, r);
+                        continue;
+                }
+                head[0] = stamp;
+                head[1] = stamp_check(payload, stamp);
+        }
+}
+
+void payload_destroy(struct payload *payload)
+{
+        if (payload == NULL)
+                return;
+        free(payload->pool);
+        free(payload);
+}
@@ -0,0 +1,313 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Skewed spatial distributions of the synthetic workloads
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <synth_dist.h>
+
+static const char *synth_dist_names[] = { "rand", "zipf", "pareto",
+                                          "hotspot" };
+
+static const double synth_dist_defaults[][2] = {
+        { 0, 0 }, { 0.99, 0 }, { 1.16, 0 }, { 20, 80 },
+};
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+        uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+}
+
+static inline uint64_t xorshift128p(uint64_t *s)
+{
+        uint64_t x = s[0];
+        uint64_t y = s[1];
+
+        s[0] = y;
+        x ^= x << 23;
+        s[1] = x ^ y ^ (x >> 17) ^ (y >> 26);
+        return s[1] + y;
+}
+
+/* in [0, 1) */
+static inline double rand_double(uint64_t *s)
+{
+        return (xorshift128p(s) >> 11) * 0x1.0p-53;
+}
+
+/* in [0, n) */
+static inline long long rand_below(uint64_t *s, long long n)
+{
+        return (long long)(((unsigned __int128)xorshift128p(s) *
+                            (unsigned long long)n) >>
+                           64);
+}
+
+/* log1p(x) / x and expm1(x) / x, which stay exact around 0 */
+static double helper1(double x)
+{
+        if (fabs(x) > 1e-8)
+                return log1p(x) / x;
+        return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double helper2(double x)
+{
+        if (fabs(x) > 1e-8)
+                return expm1(x) / x;
+        return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+static double zipf_h(const struct synth_dist *dist, double x)
+{
+        return exp(-dist->param[0] * log(x));
+}
+
+static double zipf_h_integral(const struct synth_dist *dist, double x)
+{
+        double log_x = log(x);
+
+        return helper2((1 - dist->param[0]) * log_x) * log_x;
+}
+
+static double zipf_h_integral_inverse(const struct synth_dist *dist, double x)
+{
+        double t = x * (1 - dist->param[0]);
+
+        if (t < -1)
+                t = -1;
+        return exp(helper1(t) * x);
+}
+
+/* k in [1, n], from Apache Commons RejectionInversionZipfSampler */
+static long long zipf_sample(const struct synth_dist *dist, uint64_t *s)
+{
+        double u, x;
+        long long k;
+
+        while (1) {
+                u = dist->h_n + rand_double(s) * (dist->h_x1 - dist->h_n);
+                x = zipf_h_integral_inverse(dist, u);
+                k = (long long)(x + 0.5);
+                if (k < 1)
+                        k = 1;
+                else if (k > dist->n)
+                        k = dist->n;
+                if (k - x <= dist->s ||
+                    u >= zipf_h_integral(dist, k + 0.5) - zipf_h(dist, k))
+                        return k;
+        }
+}
+
+static long long gcd(long long a, long long b)
+{
+        while (b) {
+                long long t = a % b;
+
+                a = b;
+                b = t;
+        }
+        return a;
+}
+
+/*
+ * "zipf_read" is SYNTH_ZIPF with op "read". The uniform "rand_*" types
+ * stay with the existing generator, so they are not matched here.
+ */
+int synth_dist_type(const char *name, const char **op)
+{
+        size_t len;
+        int i;
+
+        for (i = SYNTH_ZIPF; i <= SYNTH_HOTSPOT; i++) {
+                len = strlen(synth_dist_names[i]);
+                if (strncmp(name, synth_dist_names[i], len) || name[len] != '_')
+                        continue;
+                *op = name + len + 1;
+                if (!strcmp(*op, "read") || !strcmp(*op, "write") ||
+                    !strcmp(*op, "mixed"))
+                        return i;
+        }
+        return -1;
+}
+
+/* param is "THETA", "ALPHA" or "HOT,ACCESS", NULL or "" for the defaults */
+int synth_dist_init(struct synth_dist *dist, int type, long long n,
+                    const char *param, uint64_t seed)
+{
+        char *end;
+        int i;
+
+        if (type < SYNTH_UNIFORM || type > SYNTH_HOTSPOT || n < 1)
+                return -1;
+
+        memset(dist, 0, sizeof(struct synth_dist));
+        dist->type = type;
+        dist->n = n;
+        dist->param[0] = synth_dist_defaults[type][0];
+        dist->param[1] = synth_dist_defaults[type][1];
+        for (i = 0; param && *param && i < 2; i++) {
+                dist->param[i] = strtod(param, &end);
+                if (end == param)
+                        return -1;
+                param = *end == ',' ? end + 1 : end;
+        }
+        if (param && *param)
+                return -1;
+
+        switch (type) {
+        case SYNTH_ZIPF:
+                if (dist->param[0] <= 0)
+                        return -1;
+                dist->h_x1 = zipf_h_integral(dist, 1.5) - 1;
+                dist->h_n = zipf_h_integral(dist, n + 0.5);
+                dist->s = 2 - zipf_h_integral_inverse(
+                                      dist, zipf_h_integral(dist, 2.5) -
+                                                    zipf_h(dist, 2));
+                break;
+        case SYNTH_PARETO:
+                if (dist->param[0] <= 0)
+                        return -1;
+                dist->pareto_c = 1 - pow(n + 1.0, -dist->param[0]);
+                break;
+        case SYNTH_HOTSPOT:
+                if (dist->param[0] <= 0 || dist->param[0] >= 100 ||
+                    dist->param[1] < 0 || dist->param[1] > 100)
+                        return -1;
+                dist->hot = (long long)(n * dist->param[0] / 100);
+                if (dist->hot >= n)
+                        dist->hot = n - 1;
+                if (dist->hot < 1)
+                        dist->hot = 1;
+                break;
+        }
+
+        /* about n / golden ratio, which spreads the neighbours apart */
+        dist->stride = (long long)(n * 0.6180339887498949) | 1;
+        while (gcd(dist->stride, n) != 1)
+                dist->stride++;
+        if (n == 1)
+                dist->stride = 1;
+
+        while (dist->perm_bits < 32 && (1LL << (2 * dist->perm_bits)) < n)
+                dist->perm_bits++;
+        if (!dist->perm_bits)
+                dist->perm_bits = 1;
+        dist->seed = splitmix64(&seed);
+        return 0;
+}
+
+/*
+ * A balanced Feistel network over 2 * half_bits bits is a bijection, and
+ * walking its cycle until the value falls below n again makes one of
+ * [0, n). The domain is less than 4n, so that takes under 4 rounds on
+ * average.
+ */
+uint64_t synth_perm(uint64_t x, uint64_t n, int half_bits, uint64_t key)
+{
+        uint64_t mask = (1ULL << half_bits) - 1;
+        uint64_t keys[SYNTH_PERM_ROUNDS];
+        uint64_t l, r, f;
+        int i;
+
+        for (i = 0; i < SYNTH_PERM_ROUNDS; i++)
+                keys[i] = splitmix64(&key);
+
+        do {
+                l = x >> half_bits;
+                r = x & mask;
+                for (i = 0; i < SYNTH_PERM_ROUNDS; i++) {
+                        f = (r ^ keys[i]) * 0xbf58476d1ce4e5b9ULL;
+                        f ^= f >> 31;
+                        f = l ^ (f & mask);
+                        l = r;
+                        r = f;
+                }
+                x = l << half_bits | r;
+        } while (x >= n);
+
+        return x;
+}
+
+/* 64 random bits of a ticket */
+uint64_t synth_dist_hash(const struct synth_dist *dist, long long ticket)
+{
+        uint64_t x = dist->seed ^ (uint64_t)ticket * 0xd1342543de82ef95ULL;
+
+        return splitmix64(&x);
+}
+
+long long synth_dist_rank(const struct synth_dist *dist, long long ticket)
+{
+        uint64_t s[2];
+        long long k;
+
+        if (dist->type == SYNTH_UNIFORM)
+                return (long long)synth_perm(
+                        (uint64_t)(ticket % dist->n), dist->n, dist->perm_bits,
+                        dist->seed + (uint64_t)(ticket / dist->n));
+
+        s[0] = synth_dist_hash(dist, ticket);
+        s[1] = s[0] * 0x9e3779b97f4a7c15ULL | 1;
+        switch (dist->type) {
+        case SYNTH_ZIPF:
+                return zipf_sample(dist, s) - 1;
+        case SYNTH_PARETO:
+                k = (long long)pow(1 - rand_double(s) * dist->pareto_c,
+                                   -1 / dist->param[0]) -
+                    1;
+                return k < dist->n ? k : dist->n - 1;
+        case SYNTH_HOTSPOT:
+                if (rand_double(s) * 100 < dist->param[1] ||
+                    dist->hot >= dist->n)
+                        return rand_below(s, dist->hot);
+                return dist->hot + rand_below(s, dist->n - dist->hot);
+        }
+        return 0;
+}
+
+/* the item of the working set ticket goes to */
+long long synth_dist_item(const struct synth_dist *dist, long long ticket)
+{
+        long long rank = synth_dist_rank(dist, ticket);
+
+        if (dist->type == SYNTH_UNIFORM)
+                return rank;
+        return (long long)((unsigned long long)rank * dist->stride % dist->n);
+}
+
+/* "zipf:0.99", for the results */
+int synth_dist_format(const struct synth_dist *dist, char *buf, int len)
+{
+        switch (dist->type) {
+        case SYNTH_ZIPF:
+        case SYNTH_PARETO:
+                return snprintf(buf, len, "%s:%g", synth_dist_names[dist->type],
+                                dist->param[0]);
+        case SYNTH_HOTSPOT:
+                return snprintf(buf, len, "%s:%g,%g",
+                                synth_dist_names[dist->type], dist->param[0],
+                                dist->param[1]);
+        }
+        return snprintf(buf, len, "%s", synth_dist_names[dist->type]);
+}
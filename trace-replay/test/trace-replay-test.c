@@ -1,5 +1,30 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <unity.h>
 #include <trace_replay.h>
+#include <io_pool.h>
+#include <latency_hist.h>
+#include <trace_bin.h>
+#include <trace_stream.h>
+#include <trace_parse.h>
+#include <nstime.h>
+#include <aio_ring.h>
+#include <affinity.h>
+#include <payload.h>
+#include <verify.h>
+#include <synth_dist.h>
+#include <arrival.h>
+#include <token_bucket.h>
+#include <hist_log.h>
+#include <io_log.h>
+#include <disk_io.h>
+
+extern unsigned long long start_ns;
+extern int lag_policy;
 
 void setUp(void)
 {
@@ -14,11 +39,968 @@ void test(void)
         TEST_ASSERT_EQUAL(512, MAX_THREADS);
 }
 
+void test_io_pool_class(void)
+{
+        TEST_ASSERT_EQUAL(0, io_pool_class(512));
+        TEST_ASSERT_EQUAL(0, io_pool_class(PAGE_SIZE));
+        TEST_ASSERT_EQUAL(1, io_pool_class(PAGE_SIZE + 1));
+        TEST_ASSERT_EQUAL(2, io_pool_class(4 * PAGE_SIZE));
+        TEST_ASSERT_EQUAL(IO_POOL_MAX_CLASSES - 1, io_pool_class(MAX_BYTES));
+}
+
+void test_io_pool_recycle(void)
+{
+        struct io_pool *pool = io_pool_create(2, 8 * PAGE_SIZE, 0);
+        struct io_job *job[3];
+        char *buf[3];
+        int buf_class[3];
+
+        TEST_ASSERT_NOT_NULL(pool);
+        TEST_ASSERT_EQUAL(4, pool->nr_classes);
+
+        job[0] = io_pool_get_job(pool);
+        job[1] = io_pool_get_job(pool);
+        job[2] = io_pool_get_job(pool);
+        TEST_ASSERT_NOT_NULL(job[0]);
+        TEST_ASSERT_NOT_NULL(job[1]);
+        TEST_ASSERT_NULL(job[2]);
+
+        buf[0] = io_pool_get_buf(pool, 3 * PAGE_SIZE, &buf_class[0]);
+        buf[1] = io_pool_get_buf(pool, 4 * PAGE_SIZE, &buf_class[1]);
+        buf[2] = io_pool_get_buf(pool, 4 * PAGE_SIZE, &buf_class[2]);
+        TEST_ASSERT_EQUAL(2, buf_class[0]);
+        TEST_ASSERT_EQUAL(2, buf_class[1]);
+        TEST_ASSERT_NULL(buf[2]);
+        TEST_ASSERT_EQUAL(-1, buf_class[2]);
+        TEST_ASSERT_EQUAL(0, (unsigned long)buf[0] % PAGE_SIZE);
+        TEST_ASSERT_EQUAL_PTR(buf[0] + 4 * PAGE_SIZE, buf[1]);
+
+        /* larger than the largest class is left to the caller */
+        TEST_ASSERT_NULL(io_pool_get_buf(pool, 16 * PAGE_SIZE, &buf_class[2]));
+
+        io_pool_put_buf(pool, buf[1], buf_class[1]);
+        io_pool_put_job(pool, job[1]);
+        TEST_ASSERT_EQUAL_PTR(job[1], io_pool_get_job(pool));
+        TEST_ASSERT_EQUAL_PTR(buf[1],
+                              io_pool_get_buf(pool, PAGE_SIZE * 4,
+                                              &buf_class[1]));
+
+        io_pool_destroy(pool);
+}
+
+void test_trace_ticket_repeat(void)
+{
+        static struct trace_info_t trace;
+        struct trace_io_req reqs[4];
+        struct io_stat_t io_stat;
+        long long ticket;
+        int i;
+
+        memset(&trace, 0, sizeof(trace));
+        memset(&io_stat, 0, sizeof(io_stat));
+        for (i = 0; i < 4; i++) {
+                reqs[i].arrival_time = i;
+                reqs[i].blkno = i;
+        }
+        trace.trace_buf = reqs;
+        trace.trace_io_cnt = 4;
+        trace.trace_repeat_num = 2;
+        trace.trace_timescale = 1.0;
+        trace_reset(&trace);
+
+        /* only the requests which have arrived are claimed */
+        TEST_ASSERT_EQUAL(2, trace_io_claim(&trace, &io_stat,
+                                             1 * NSEC_PER_MSEC, 8, &ticket));
+        TEST_ASSERT_EQUAL(0, ticket);
+        TEST_ASSERT_EQUAL(0, trace_io_claim(&trace, &io_stat,
+                                             1 * NSEC_PER_MSEC, 8, &ticket));
+        TEST_ASSERT_FALSE(trace_eof(&trace));
+
+        /* the second repeat follows the first one, then the trace closes */
+        TEST_ASSERT_EQUAL(6, trace_io_claim(&trace, &io_stat,
+                                             10 * NSEC_PER_MSEC, 8, &ticket));
+        TEST_ASSERT_EQUAL(2, ticket);
+        TEST_ASSERT_EQUAL(0, trace_io_claim(&trace, &io_stat,
+                                             10 * NSEC_PER_MSEC, 8, &ticket));
+        TEST_ASSERT_TRUE(trace_eof(&trace));
+        TEST_ASSERT_EQUAL(8, trace_issued(&trace));
+        TEST_ASSERT_EQUAL(2, trace_repeat_count(&trace));
+        TEST_ASSERT_NULL(trace_next_req(&trace, &reqs[0]));
+
+        trace_reset(&trace);
+        trace.wanted_io_count = 5;
+        TEST_ASSERT_EQUAL(5, trace_io_claim(&trace, &io_stat,
+                                             10 * NSEC_PER_MSEC, 8, &ticket));
+        TEST_ASSERT_TRUE(trace_eof(&trace));
+}
+
+void test_latency_hist_percentile(void)
+{
+        static struct latency_hist hist, merged;
+        unsigned long long value;
+        int i;
+
+        latency_hist_reset(&hist);
+        latency_hist_reset(&merged);
+        TEST_ASSERT_EQUAL(0, latency_hist_percentile(&hist, 50.0));
+
+        /* exact below 2 * HIST_SUB_COUNT, then within 1 / HIST_SUB_COUNT */
+        TEST_ASSERT_EQUAL(100, latency_hist_value(latency_hist_index(100)));
+        for (value = 1000; value < (1ULL << 40); value = value * 3 + 1) {
+                unsigned long long got =
+                        latency_hist_value(latency_hist_index(value));
+                TEST_ASSERT_TRUE(got * HIST_SUB_COUNT >=
+                                 value * (HIST_SUB_COUNT - 1));
+                TEST_ASSERT_TRUE(got * (HIST_SUB_COUNT - 1) <=
+                                 value * HIST_SUB_COUNT);
+        }
+        TEST_ASSERT_EQUAL(HIST_NR_BUCKETS - 1, latency_hist_index(~0ULL));
+
+        for (i = 1; i <= 10000; i++)
+                latency_hist_record(&hist, (unsigned long long)i * 1000);
+        latency_hist_merge(&merged, &hist);
+        TEST_ASSERT_EQUAL(10000, merged.total_count);
+
+        value = latency_hist_percentile(&merged, 50.0);
+        TEST_ASSERT_UINT64_WITHIN(5000000 / HIST_SUB_COUNT, 5000000, value);
+        value = latency_hist_percentile(&merged, 99.0);
+        TEST_ASSERT_UINT64_WITHIN(9900000 / HIST_SUB_COUNT, 9900000, value);
+        value = latency_hist_percentile(&merged, 99.99);
+        TEST_ASSERT_UINT64_WITHIN(9999000 / HIST_SUB_COUNT, 9999000, value);
+}
+
+void test_trace_bin_window(void)
+{
+        static struct trace_info_t trace;
+        struct trace_io_req reqs[3] = {
+                { 0.0, 100, 8, 0, 1 },
+                { 1.0, 104, 2, 0, 1 }, // inside the first one
+                { 2.0, 0x100000000LL, 8, 0, 0 },
+        };
+        char path[] = "/tmp/trace-replay-test-XXXXXX";
+        int fd;
+
+        fd = mkstemp(path);
+        TEST_ASSERT_TRUE(fd >= 0);
+        close(fd);
+        TEST_ASSERT_EQUAL(0, trace_bin_write(path, reqs, 3, 0, 0, 0));
+        TEST_ASSERT_EQUAL(1, trace_bin_probe(path));
+
+        /* raw records are mapped as they are */
+        memset(&trace, 0, sizeof(trace));
+        strcpy(trace.tracename, path);
+        TEST_ASSERT_EQUAL(0, trace_open(&trace));
+        TEST_ASSERT_NOT_NULL(trace.trace_map);
+        TEST_ASSERT_EQUAL(3, trace.trace_io_cnt);
+        TEST_ASSERT_TRUE(trace.trace_buf[2].blkno == 0x100000000LL);
+        trace_bin_unmap(trace.trace_map, trace.trace_map_size);
+
+        /* and trimmed again for a replay with an overlap window */
+        memset(&trace, 0, sizeof(trace));
+        strcpy(trace.tracename, path);
+        trace.trace_window = 4;
+        TEST_ASSERT_EQUAL(0, trace_open(&trace));
+        TEST_ASSERT_NULL(trace.trace_map);
+        TEST_ASSERT_EQUAL(2, trace.trace_io_cnt);
+        TEST_ASSERT_TRUE(trace.trace_buf[1].arrival_time == 2.0);
+        free(trace.trace_buf);
+
+        unlink(path);
+}
+
+void test_trace_stream_repeat(void)
+{
+        static struct trace_info_t trace;
+        struct io_stat_t io_stat;
+        char path[] = "/tmp/trace-replay-test-XXXXXX";
+        int nr_req = 20000; // wraps the smallest ring
+        long long issued = 0;
+        FILE *fp;
+        int fd, i;
+
+        fd = mkstemp(path);
+        TEST_ASSERT_TRUE(fd >= 0);
+        fp = fdopen(fd, "w");
+        for (i = 0; i < nr_req; i++) {
+                fprintf(fp, "%d.0 0 %d 8 1\n", i, i * 8);
+                if (i == 100) // covered by the previous request
+                        fprintf(fp, "%d.5 0 %d 4 1\n", i, i * 8 + 2);
+        }
+        fclose(fp);
+
+        memset(&trace, 0, sizeof(trace));
+        memset(&io_stat, 0, sizeof(io_stat));
+        strcpy(trace.tracename, path);
+        trace.trace_window = 4;
+        trace.trace_repeat_num = 2;
+        trace.trace_timescale = 1.0;
+        trace_reset(&trace);
+        TEST_ASSERT_EQUAL(0, trace_open(&trace));
+        TEST_ASSERT_EQUAL(0, trace_stream_start(&trace, 0, 0));
+
+        while (1) {
+                double arrival_time;
+                int devno, bcount, flags;
+                long long blkno, ticket;
+                int n;
+
+                n = trace_io_claim(&trace, &io_stat, 1LL << 62, 64, &ticket);
+                if (!n) {
+                        if (trace_eof(&trace))
+                                break;
+                        trace_stream_wait(trace.stream,
+                                          trace_issued(&trace));
+                        continue;
+                }
+                for (i = 0; i < n; i++) {
+                        trace_io_get(&arrival_time, &devno, &blkno, &bcount,
+                                     &flags, &trace, ticket + i);
+                        TEST_ASSERT_TRUE(blkno ==
+                                         (ticket + i) % nr_req * 8);
+                }
+                trace_stream_release(trace.stream, ticket, n);
+                issued += n;
+        }
+
+        TEST_ASSERT_TRUE(issued == 2LL * nr_req);
+        TEST_ASSERT_EQUAL(nr_req, trace.trace_io_cnt);
+        TEST_ASSERT_EQUAL(2, trace_repeat_count(&trace));
+
+        trace_stream_destroy(&trace);
+        fclose(trace.trace_fp);
+        unlink(path);
+}
+
+void test_trace_io_put_window(void)
+{
+        static struct trace_info_t trace;
+        struct trace_io_req reqs[] = {
+                { 0.0, 100, 8, 0, 0 },
+                { 1.0, 96, 8, 0, 0 }, // trimmed to end at 100
+                { 2.0, 104, 8, 0, 0 }, // trimmed to start at 108
+                { 3.0, 100, 8, 1, 0 }, // another device
+                { 4.0, 90, 30, 0, 0 }, // replaces the first one
+                { 5.0, 200, 8, 0, 0 },
+                { 6.0, 100, 8, 0, 0 }, // [90, 120) has left the window
+        };
+        long long blkno[] = { 90, 96, 108, 100, 200, 100 };
+        int bcount[] = { 30, 4, 4, 8, 8, 8 };
+        int i;
+
+        memset(&trace, 0, sizeof(trace));
+        trace.trace_window = 4;
+        trace.trace_buf_size = 1024;
+        trace.trace_buf = malloc(sizeof(struct trace_io_req) * 1024);
+        for (i = 0; i < 7; i++)
+                TEST_ASSERT_EQUAL(i == 4, trace_io_put_req(&trace, &reqs[i]));
+        trace_io_put_done(&trace);
+
+        TEST_ASSERT_EQUAL(6, trace.trace_io_cnt);
+        for (i = 0; i < 6; i++) {
+                TEST_ASSERT_TRUE(trace.trace_buf[i].blkno == blkno[i]);
+                TEST_ASSERT_EQUAL(bcount[i], trace.trace_buf[i].bcount);
+        }
+        free(trace.trace_buf);
+}
+
+void test_trace_parse_line(void)
+{
+        const char *lines[] = {
+                "12.500000 1 123456789012 16 1\n",
+                "  .5\t0 8 8 0x1f",
+                "1.25e1 1 123456789012 16 1\n", // left to sscanf
+        };
+        struct trace_io_req req;
+        const char *end;
+
+        end = trace_parse_eol(lines[0], lines[0] + strlen(lines[0]));
+        TEST_ASSERT_EQUAL('\n', *end);
+        TEST_ASSERT_EQUAL(0, trace_parse_line(lines[0], end, &req));
+        TEST_ASSERT_TRUE(req.arrival_time == 12.5);
+        TEST_ASSERT_EQUAL(1, req.devno);
+        TEST_ASSERT_TRUE(req.blkno == 123456789012LL);
+        TEST_ASSERT_EQUAL(16, req.bcount);
+        TEST_ASSERT_EQUAL(1, req.flags);
+
+        TEST_ASSERT_EQUAL(0, trace_parse_line(lines[1],
+                                              lines[1] + strlen(lines[1]),
+                                              &req));
+        TEST_ASSERT_TRUE(req.arrival_time == 0.5);
+        TEST_ASSERT_EQUAL(0x1f, req.flags);
+
+        TEST_ASSERT_EQUAL(0, trace_parse_line(lines[2],
+                                              lines[2] + strlen(lines[2]),
+                                              &req));
+        TEST_ASSERT_TRUE(req.arrival_time == 12.5);
+        TEST_ASSERT_TRUE(req.blkno == 123456789012LL);
+
+        TEST_ASSERT_EQUAL(-1, trace_parse_line(lines[0], lines[0] + 12, &req));
+        /* devno and flags do not fit the 16 bits of a request */
+        end = "1 40000 0 8 1\n";
+        TEST_ASSERT_EQUAL(-1, trace_parse_line(end, end + strlen(end), &req));
+        end = "1 0 0 8 10000\n";
+        TEST_ASSERT_EQUAL(-1, trace_parse_line(end, end + strlen(end), &req));
+        end = "1 0 0 8 0\n\n2 0 8 8 1";
+        TEST_ASSERT_EQUAL(3, trace_parse_count_lines(end, end + strlen(end)));
+}
+
+void test_nstime(void)
+{
+        unsigned long long a, b, raw;
+
+        TEST_ASSERT_EQUAL(0, nstime_init(0));
+        a = nstime_now();
+        usleep(1000);
+        b = nstime_now();
+        TEST_ASSERT_TRUE(b - a >= NSEC_PER_MSEC);
+
+        /* never wakes up early */
+        a = nstime_now() + 2 * NSEC_PER_MSEC;
+        nstime_sleep_until(a, 20 * NSEC_PER_USEC);
+        TEST_ASSERT_TRUE(nstime_now() >= a);
+
+        /* the calibrated TSC has to follow CLOCK_MONOTONIC_RAW */
+        if (nstime_init(1))
+                return;
+        TEST_ASSERT_EQUAL_STRING("tsc", nstime_source());
+        usleep(10000);
+        a = nstime_now();
+        raw = nstime_raw();
+        b = nstime_now();
+        TEST_ASSERT_TRUE(b >= a);
+        TEST_ASSERT_TRUE(raw + NSEC_PER_MSEC > a && raw < b + NSEC_PER_MSEC);
+        nstime_init(0);
+}
+
+void test_lag_policy(void)
+{
+        static struct trace_info_t trace;
+        static struct thread_info_t t_info;
+        struct trace_io_req reqs[4];
+        struct iocb *ioq[8];
+        struct io_job *jobq[8];
+        int i, cnt;
+
+        memset(&trace, 0, sizeof(trace));
+        memset(&t_info, 0, sizeof(t_info));
+        for (i = 0; i < 4; i++) {
+                reqs[i].arrival_time = i;
+                reqs[i].blkno = i * SPP;
+                reqs[i].bcount = SPP;
+                reqs[i].devno = 0;
+                reqs[i].flags = 1;
+        }
+        trace.trace_buf = reqs;
+        trace.trace_io_cnt = 4;
+        trace.trace_repeat_num = 1;
+        trace.trace_timescale = 1.0;
+        trace.total_pages = 1024;
+        trace.devs[0].devno = DEVNO_ANY;
+        trace.devs[0].total_pages = 1024;
+        trace.nr_devs = 1;
+        t_info.trace = &trace;
+        t_info.engine = IO_ENGINE_URING;
+        t_info.pool = io_pool_create(8, PAGE_SIZE, 0);
+        TEST_ASSERT_NOT_NULL(t_info.pool);
+
+        /* 10ms behind the trace, every request is late */
+        lag_policy = LAG_DROP;
+        trace_reset(&trace);
+        start_ns = nstime_now() - 10 * NSEC_PER_MSEC;
+        TEST_ASSERT_EQUAL(0, make_jobs(&t_info, ioq, jobq, 8));
+        TEST_ASSERT_EQUAL(4, t_info.io_stat.nr_lag_dropped);
+        TEST_ASSERT_TRUE(trace_eof(&trace));
+
+        /* the first one moves the timeline, the rest are on time */
+        lag_policy = LAG_SHIFT;
+        trace_reset(&trace);
+        start_ns = nstime_now() - 10 * NSEC_PER_MSEC;
+        cnt = make_jobs(&t_info, ioq, jobq, 8);
+        TEST_ASSERT_EQUAL(4, cnt);
+        TEST_ASSERT_EQUAL(1, t_info.io_stat.nr_lag_shifted);
+        TEST_ASSERT_TRUE(trace.lag_shift >= 10 * NSEC_PER_MSEC);
+        for (i = 0; i < cnt; i++)
+                release_job(&t_info, jobq[i]);
+
+        /* the repeat starts at 30ms, so only its last request is dropped */
+        lag_policy = LAG_DROP;
+        trace_reset(&trace);
+        trace.trace_timescale = 10.0;
+        trace.trace_repeat_num = 2;
+        trace.trace_period = 3.0;
+        memset(&t_info.io_stat, 0, sizeof(t_info.io_stat));
+        start_ns = nstime_now() - 60 * NSEC_PER_MSEC;
+        cnt = make_jobs(&t_info, ioq, jobq, 8);
+        TEST_ASSERT_EQUAL(1, cnt);
+        TEST_ASSERT_EQUAL(7, t_info.io_stat.nr_lag_dropped);
+        for (i = 0; i < cnt; i++)
+                release_job(&t_info, jobq[i]);
+
+        /* an unpaced trace has no lag however long it runs */
+        lag_policy = LAG_BURST;
+        trace_reset(&trace);
+        trace.trace_timescale = 0.0;
+        trace.trace_repeat_num = 1;
+        trace.trace_period = 0.0;
+        memset(&t_info.io_stat, 0, sizeof(t_info.io_stat));
+        cnt = make_jobs(&t_info, ioq, jobq, 8);
+        TEST_ASSERT_EQUAL(4, cnt);
+        TEST_ASSERT_TRUE(t_info.io_stat.lag_max == 0);
+        for (i = 0; i < cnt; i++)
+                release_job(&t_info, jobq[i]);
+        trace.trace_timescale = 1.0;
+
+        /* ahead of the trace, the catch-up slot is not used */
+        lag_policy = LAG_RATE;
+        trace_reset(&trace);
+        trace.lag_next = 5 * NSEC_PER_SEC;
+        start_ns = nstime_now() + NSEC_PER_SEC;
+        TEST_ASSERT_TRUE(next_arrival(&trace) == start_ns);
+
+        lag_policy = LAG_BURST;
+        io_pool_destroy(t_info.pool);
+}
+
+void test_devno_map(void)
+{
+        static struct trace_info_t trace;
+        static struct thread_info_t t_info;
+        struct trace_io_req reqs[4];
+        struct iocb *ioq[8];
+        struct io_job *jobq[8];
+        int devnos[4] = { 0, 1, 2, 1 };
+        int i, cnt;
+
+        memset(&trace, 0, sizeof(trace));
+        memset(&t_info, 0, sizeof(t_info));
+        for (i = 0; i < 4; i++) {
+                reqs[i].arrival_time = 0;
+                reqs[i].blkno = SPP;
+                reqs[i].bcount = SPP;
+                reqs[i].devno = devnos[i];
+                reqs[i].flags = 1;
+        }
+        /* past the end of the second device, wraps around */
+        reqs[3].blkno = 514 * SPP;
+
+        trace.trace_buf = reqs;
+        trace.trace_io_cnt = 4;
+        trace.trace_repeat_num = 1;
+        trace.trace_timescale = 1.0;
+        trace.devs[0].devno = DEVNO_ANY;
+        trace.devs[0].total_pages = 1024;
+        trace.devs[1].devno = 1;
+        trace.devs[1].dev = 1;
+        trace.devs[1].total_pages = 512;
+        trace.devs[1].start_partition = 512 * PAGE_SIZE;
+        trace.nr_devs = 2;
+        t_info.trace = &trace;
+        t_info.engine = IO_ENGINE_URING;
+        t_info.pool = io_pool_create(8, PAGE_SIZE, 0);
+        TEST_ASSERT_NOT_NULL(t_info.pool);
+
+        trace_reset(&trace);
+        start_ns = nstime_now() - 10 * NSEC_PER_MSEC;
+        cnt = make_jobs(&t_info, ioq, jobq, 8);
+        TEST_ASSERT_EQUAL(4, cnt);
+
+        /* devnos without an entry go to the trace's own device */
+        TEST_ASSERT_EQUAL(0, jobq[0]->dev);
+        TEST_ASSERT_TRUE(jobq[0]->offset == PAGE_SIZE);
+        TEST_ASSERT_EQUAL(1, jobq[1]->dev);
+        TEST_ASSERT_TRUE(jobq[1]->offset == 513 * PAGE_SIZE);
+        TEST_ASSERT_EQUAL(0, jobq[2]->dev);
+        TEST_ASSERT_EQUAL(1, jobq[3]->dev);
+        TEST_ASSERT_TRUE(jobq[3]->offset == 514 * PAGE_SIZE);
+
+        for (i = 0; i < cnt; i++)
+                release_job(&t_info, jobq[i]);
+        io_pool_destroy(t_info.pool);
+}
+
+void test_file_prepare(void)
+{
+        char path[] = "/tmp/trace-replay-test-XXXXXX";
+        long long capacity = 0;
+        int flags = O_RDWR | O_DIRECT;
+        struct stat st;
+        char buf[16];
+        int fd;
+
+        fd = mkstemp(path);
+        TEST_ASSERT_TRUE(fd >= 0);
+        close(fd);
+        unlink(path);
+
+        /* a missing file needs a size */
+        TEST_ASSERT_EQUAL(-1, file_prepare(path, 0, 0, &flags, &capacity));
+
+        /* rounded down to pages, preallocated and written */
+        TEST_ASSERT_EQUAL(0, file_prepare(path, MB + 100, 1, &flags,
+                                          &capacity));
+        TEST_ASSERT_TRUE(capacity == MB);
+        TEST_ASSERT_EQUAL(0, stat(path, &st));
+        TEST_ASSERT_TRUE(st.st_size == MB);
+        TEST_ASSERT_TRUE((long long)st.st_blocks * 512 >= MB);
+        fd = open(path, O_RDONLY);
+        TEST_ASSERT_TRUE(fd >= 0);
+        TEST_ASSERT_EQUAL(sizeof(buf), pread(fd, buf, sizeof(buf), MB - 16));
+        TEST_ASSERT_NOT_EQUAL(0, buf[15]);
+        close(fd);
+
+        /* an existing file keeps its size */
+        capacity = 0;
+        TEST_ASSERT_EQUAL(0, file_prepare(path, 0, 0, &flags, &capacity));
+        TEST_ASSERT_TRUE(capacity == MB);
+
+        unlink(path);
+}
+
+void test_aio_ring_peek(void)
+{
+        struct io_event events[8];
+        struct aio_ring *ring;
+        int i;
+
+        ring = calloc(1, sizeof(struct aio_ring) + 4 * sizeof(struct io_event));
+        TEST_ASSERT_NOT_NULL(ring);
+        TEST_ASSERT_FALSE(aio_ring_usable((io_context_t)ring));
+        ring->magic = AIO_RING_MAGIC;
+        ring->nr = 4;
+        TEST_ASSERT_TRUE(aio_ring_usable((io_context_t)ring));
+
+        for (i = 0; i < 4; i++)
+                ring->io_events[i].res = i;
+        TEST_ASSERT_EQUAL(0, aio_ring_peek((io_context_t)ring, events, 8));
+
+        /* the completions wrap around the end of the ring */
+        ring->head = 2;
+        ring->tail = 1;
+        TEST_ASSERT_EQUAL(2, aio_ring_peek((io_context_t)ring, events, 2));
+        TEST_ASSERT_EQUAL(2, events[0].res);
+        TEST_ASSERT_EQUAL(3, events[1].res);
+        TEST_ASSERT_EQUAL(0, ring->head);
+        TEST_ASSERT_EQUAL(1, aio_ring_peek((io_context_t)ring, events, 8));
+        TEST_ASSERT_EQUAL(0, events[0].res);
+        TEST_ASSERT_EQUAL(1, ring->head);
+        TEST_ASSERT_EQUAL(0, aio_ring_getevents((io_context_t)ring, 1, 0, 8,
+                                                events));
+
+        free(ring);
+}
+
+void test_affinity_parse(void)
+{
+        cpu_set_t set;
+        char buf[64];
+
+        TEST_ASSERT_EQUAL(7, affinity_parse("0-3,8,10-11\n", &set));
+        TEST_ASSERT_TRUE(CPU_ISSET(3, &set));
+        TEST_ASSERT_FALSE(CPU_ISSET(4, &set));
+        TEST_ASSERT_EQUAL(0, affinity_format(&set, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_STRING("0-3,8,10-11", buf);
+
+        TEST_ASSERT_EQUAL(1, affinity_parse("5", &set));
+        TEST_ASSERT_EQUAL(0, affinity_format(&set, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_STRING("5", buf);
+
+        TEST_ASSERT_EQUAL(-1, affinity_parse("", &set));
+        TEST_ASSERT_EQUAL(-1, affinity_parse("3-1", &set));
+        TEST_ASSERT_EQUAL(-1, affinity_parse("1;2", &set));
+        TEST_ASSERT_EQUAL(-1, affinity_parse(AFFINITY_AUTO, &set));
+}
+
+void test_payload_fill(void)
+{
+        struct payload *payload;
+        char *buf, *dup;
+        uint64_t stamp;
+        int zeros = 0;
+        int i;
+
+        buf = allocate_aligned_buffer(4 * PAYLOAD_BLOCK);
+        dup = allocate_aligned_buffer(PAYLOAD_BLOCK);
+
+        payload = payload_create(1, 50, 0, 4);
+        TEST_ASSERT_NOT_NULL(payload);
+        payload_fill(payload, buf, 4 * PAYLOAD_BLOCK);
+        for (i = 0; i < 4 * PAYLOAD_BLOCK; i++)
+                zeros += !buf[i];
+        TEST_ASSERT_INT_WITHIN(4 * PAYLOAD_BLOCK / 50, 2 * PAYLOAD_BLOCK,
+                               zeros);
+
+        /* between refills only the stamps change */
+        memcpy(dup, buf, PAYLOAD_BLOCK);
+        memcpy(&stamp, buf, sizeof(stamp));
+        payload_fill(payload, buf, 4 * PAYLOAD_BLOCK);
+        TEST_ASSERT_NOT_EQUAL(0, memcmp(dup, buf, PAYLOAD_STAMP));
+        TEST_ASSERT_EQUAL_MEMORY(dup + PAYLOAD_STAMP, buf + PAYLOAD_STAMP,
+                                 PAYLOAD_BLOCK - PAYLOAD_STAMP);
+
+        /* a block read into is no longer stamped and is filled again */
+        memset(buf, 0xff, PAYLOAD_BLOCK);
+        payload_fill(payload, buf, 4 * PAYLOAD_BLOCK);
+        TEST_ASSERT_NOT_EQUAL(0xff, (unsigned char)buf[PAYLOAD_BLOCK - 1]);
+        memcpy(&stamp, buf, sizeof(stamp));
+        TEST_ASSERT_EQUAL(1, stamp >> 48);
+        payload_destroy(payload);
+
+        /* the duplicates are the same in every worker */
+        payload = payload_create(2, 50, 100, 4);
+        TEST_ASSERT_NOT_NULL(payload);
+        payload_fill(payload, buf, 4 * PAYLOAD_BLOCK);
+        payload_destroy(payload);
+        payload = payload_create(3, 50, 100, 4);
+        TEST_ASSERT_NOT_NULL(payload);
+        memcpy(&stamp, buf, sizeof(stamp));
+        TEST_ASSERT_TRUE(stamp >> 63);
+        memcpy(dup, payload->pool + (stamp & (PAYLOAD_DUP_BLOCKS - 1)) *
+                                            PAYLOAD_BLOCK,
+               PAYLOAD_BLOCK);
+        TEST_ASSERT_EQUAL_MEMORY(dup, buf, PAYLOAD_BLOCK);
+        payload_destroy(payload);
+
+        free(buf);
+        free(dup);
+}
+
+void test_verify_check(void)
+{
+        long long bad_offset;
+        int nr_checked;
+        char *buf;
+        int i;
+
+        TEST_ASSERT_EQUAL_HEX32(0xe3069283, crc32c(0, "123456789", 9));
+        TEST_ASSERT_EQUAL_HEX32(0xe3069283, crc32c_sw(0, "123456789", 9));
+
+        buf = allocate_aligned_buffer(16 * VERIFY_SECTOR);
+        for (i = 0; i < 16 * VERIFY_SECTOR; i++)
+                buf[i] = (char)(i * 7);
+        TEST_ASSERT_EQUAL_HEX32(crc32c_sw(0, buf, 16 * VERIFY_SECTOR - 3),
+                                crc32c(0, buf, 16 * VERIFY_SECTOR - 3));
+
+        /* sectors never stamped are skipped */
+        memset(buf, 0, 16 * VERIFY_SECTOR);
+        TEST_ASSERT_EQUAL(0, verify_check(buf, 16 * VERIFY_SECTOR, 0,
+                                          &nr_checked, &bad_offset));
+        TEST_ASSERT_EQUAL(0, nr_checked);
+
+        verify_stamp(buf, 16 * VERIFY_SECTOR, 4096, 3, 0x5eed);
+        TEST_ASSERT_EQUAL(8 + 3, verify_tail(buf + 3 * VERIFY_SECTOR)->lba);
+        TEST_ASSERT_EQUAL(0, verify_check(buf, 16 * VERIFY_SECTOR, 4096,
+                                          &nr_checked, &bad_offset));
+        TEST_ASSERT_EQUAL(16, nr_checked);
+        TEST_ASSERT_EQUAL(-1, bad_offset);
+
+        /* a part of the request read on its own */
+        TEST_ASSERT_EQUAL(0, verify_check(buf + 5 * VERIFY_SECTOR,
+                                          2 * VERIFY_SECTOR,
+                                          4096 + 5 * VERIFY_SECTOR,
+                                          &nr_checked, &bad_offset));
+        TEST_ASSERT_EQUAL(2, nr_checked);
+
+        buf[6 * VERIFY_SECTOR + 100] ^= 1;
+        TEST_ASSERT_EQUAL(1, verify_check(buf, 16 * VERIFY_SECTOR, 4096,
+                                          &nr_checked, &bad_offset));
+        TEST_ASSERT_EQUAL(4096 + 6 * VERIFY_SECTOR, bad_offset);
+
+        /* read from where it was not written */
+        TEST_ASSERT_EQUAL(16, verify_check(buf, 16 * VERIFY_SECTOR, 0,
+                                           &nr_checked, &bad_offset));
+
+        free(buf);
+}
+
+void test_synth_dist(void)
+{
+        static int count[1000];
+        struct synth_dist dist;
+        const char *op;
+        int nr_hot = 0;
+        int i;
+
+        TEST_ASSERT_EQUAL(SYNTH_ZIPF, synth_dist_type("zipf_read", &op));
+        TEST_ASSERT_EQUAL_STRING("read", op);
+        TEST_ASSERT_EQUAL(SYNTH_HOTSPOT, synth_dist_type("hotspot_mixed", &op));
+        TEST_ASSERT_EQUAL(-1, synth_dist_type("rand_read", &op));
+        TEST_ASSERT_EQUAL(-1, synth_dist_type("zipf_trim", &op));
+        TEST_ASSERT_EQUAL(-1, synth_dist_init(&dist, SYNTH_ZIPF, 1000, "x", 1));
+        TEST_ASSERT_EQUAL(-1, synth_dist_init(&dist, SYNTH_HOTSPOT, 1000,
+                                              "120,80", 1));
+
+        /* zipf 1: rank k is drawn 1 / (k + 1) as often as rank 0 */
+        TEST_ASSERT_EQUAL(0, synth_dist_init(&dist, SYNTH_ZIPF, 1000, "1", 1));
+        for (i = 0; i < 1000000; i++)
+                count[synth_dist_rank(&dist, i)]++;
+        TEST_ASSERT_INT_WITHIN(count[0] / 20, count[0] / 2, count[1]);
+        TEST_ASSERT_INT_WITHIN(count[0] / 20, count[0] / 10, count[9]);
+        /* 1 / H(1000) of the draws */
+        TEST_ASSERT_INT_WITHIN(5000, 133600, count[0]);
+
+        TEST_ASSERT_EQUAL(0, synth_dist_init(&dist, SYNTH_HOTSPOT, 1000, "",
+                                             1));
+        for (i = 0; i < 100000; i++)
+                nr_hot += synth_dist_rank(&dist, i) < 200;
+        TEST_ASSERT_INT_WITHIN(1000, 80000, nr_hot);
+
+        /* the draws are spread over all of the items */
+        memset(count, 0, sizeof(count));
+        TEST_ASSERT_EQUAL(0, synth_dist_init(&dist, SYNTH_PARETO, 1000, NULL,
+                                             1));
+        for (i = 0; i < 1000; i++)
+                count[(int)((long long)i * dist.stride % 1000)]++;
+        for (i = 0; i < 1000; i++)
+                TEST_ASSERT_EQUAL(1, count[i]);
+        for (i = 0; i < 100000; i++) {
+                long long item = synth_dist_item(&dist, i);
+
+                TEST_ASSERT_TRUE(item >= 0 && item < 1000);
+        }
+}
+
+void test_synth_perm(void)
+{
+        static int count[1000];
+        struct synth_dist dist, again;
+        int nr_same = 0;
+        int i;
+
+        /* a bijection of [0, 1000) for any key */
+        for (i = 0; i < 1000; i++)
+                count[synth_perm(i, 1000, 5, 42)]++;
+        for (i = 0; i < 1000; i++)
+                TEST_ASSERT_EQUAL(1, count[i]);
+
+        /* every repeat visits every item once, in a new order */
+        TEST_ASSERT_EQUAL(0, synth_dist_init(&dist, SYNTH_UNIFORM, 1000, NULL,
+                                             SYNTH_SEED));
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < 2000; i++)
+                count[synth_dist_item(&dist, i)]++;
+        for (i = 0; i < 1000; i++) {
+                TEST_ASSERT_EQUAL(2, count[i]);
+                nr_same += synth_dist_item(&dist, i) ==
+                           synth_dist_item(&dist, 1000 + i);
+        }
+        TEST_ASSERT_LESS_THAN(20, nr_same);
+
+        /* the seed gives the same sequence, whichever worker asks */
+        TEST_ASSERT_EQUAL(0, synth_dist_init(&again, SYNTH_UNIFORM, 1000, NULL,
+                                             SYNTH_SEED));
+        for (i = 0; i < 1000; i++)
+                TEST_ASSERT_EQUAL(synth_dist_item(&dist, 7777 - i),
+                                  synth_dist_item(&again, 7777 - i));
+}
+
+void test_arrival(void)
+{
+        struct arrival *arrival;
+        double first, prev, now;
+        char buf[64];
+        int i;
+
+        TEST_ASSERT_NULL(arrival_create("poisson", 1));
+        TEST_ASSERT_NULL(arrival_create("poisson:-5", 1));
+        TEST_ASSERT_NULL(arrival_create("onoff:1000,10", 1));
+        TEST_ASSERT_NULL(arrival_create("mmpp:0,10,0,10", 1));
+        TEST_ASSERT_NULL(arrival_create("burst:1000", 1));
+
+        arrival = arrival_create("const:1000", 1);
+        TEST_ASSERT_NOT_NULL(arrival);
+        TEST_ASSERT_TRUE(arrival_time(arrival, 9) == 10.0);
+        arrival_destroy(arrival);
+
+        /* 10 requests per ms on average, never going back */
+        arrival = arrival_create("poisson:10000", 1);
+        first = arrival_time(arrival, 0);
+        for (i = 0, prev = 0; i < 100000; i++) {
+                now = arrival_time(arrival, i);
+                TEST_ASSERT_TRUE(now >= prev);
+                prev = now;
+        }
+        TEST_ASSERT_INT_WITHIN(200, 10000, (int)prev);
+        /* the same times for whoever asks, the evicted one not earlier */
+        TEST_ASSERT_TRUE(arrival_time(arrival, 99999) == prev);
+        TEST_ASSERT_TRUE(arrival_time(arrival, 0) >= first);
+        arrival_destroy(arrival);
+
+        /* nothing in the off 90ms of every 100ms */
+        arrival = arrival_create("onoff:10000,10,90", 1);
+        arrival_format(arrival, buf, sizeof(buf));
+        TEST_ASSERT_EQUAL_STRING("onoff:10000,10,90", buf);
+        for (i = 0; i < 10000; i++)
+                TEST_ASSERT_TRUE(fmod(arrival_time(arrival, i), 100) < 10);
+        TEST_ASSERT_INT_WITHIN(500, 10000,
+                               (int)arrival_time(arrival, 9999));
+        arrival_destroy(arrival);
+
+        /* half of the time at 2000 IOPS, the other half idle */
+        arrival = arrival_create("mmpp:2000,50,0,50", 1);
+        TEST_ASSERT_INT_WITHIN(1000, 10000, (int)arrival_time(arrival, 9999));
+        arrival_destroy(arrival);
+}
+
+void test_rate_limit(void)
+{
+        struct rate_limit *limit;
+        char buf[64];
+
+        TEST_ASSERT_NULL(rate_limit_create("fast"));
+        TEST_ASSERT_NULL(rate_limit_create("1000:0"));
+        TEST_ASSERT_NULL(rate_limit_create("1000,-1"));
+
+        /* 1000 IOPS in bursts of 10, no bandwidth limit */
+        limit = rate_limit_create("1000:10");
+        TEST_ASSERT_NOT_NULL(limit);
+        rate_limit_format(limit, buf, sizeof(buf));
+        TEST_ASSERT_EQUAL_STRING("1000:10,0:0", buf);
+        TEST_ASSERT_EQUAL(10, rate_limit_take(limit, 0, 64));
+        TEST_ASSERT_EQUAL(0, rate_limit_take(limit, 0, 64));
+        TEST_ASSERT_EQUAL(NSEC_PER_MSEC, rate_limit_delay(limit, 0));
+        /* a token per ms, and the unused ones come back */
+        TEST_ASSERT_EQUAL(5, rate_limit_take(limit, 5 * NSEC_PER_MSEC, 64));
+        rate_limit_done(limit, 5 * NSEC_PER_MSEC, 3, 0);
+        TEST_ASSERT_EQUAL(3, rate_limit_take(limit, 5 * NSEC_PER_MSEC, 64));
+        rate_limit_destroy(limit);
+
+        /* 1MB/s in bursts of 1MB, the bytes are charged afterwards */
+        limit = rate_limit_create("0,1:1");
+        TEST_ASSERT_EQUAL(64, rate_limit_take(limit, 0, 64));
+        TEST_ASSERT_EQUAL(0, rate_limit_delay(limit, 0));
+        rate_limit_done(limit, 0, 0, 2 * MB);
+        TEST_ASSERT_EQUAL(NSEC_PER_SEC, rate_limit_delay(limit, 0));
+        TEST_ASSERT_EQUAL(0, rate_limit_delay(limit, NSEC_PER_SEC));
+        rate_limit_destroy(limit);
+}
+
+void test_hist_log(void)
+{
+        /* too large for the stack */
+        static struct latency_hist hist, delta;
+        struct hist_log_reader reader;
+        struct hist_log *log;
+        char path[] = "/tmp/trace-replay-test-XXXXXX";
+        int fd, trace, i;
+
+        fd = mkstemp(path);
+        TEST_ASSERT_TRUE(fd >= 0);
+        close(fd);
+        log = hist_log_create(path, 2);
+        TEST_ASSERT_NOT_NULL(log);
+
+        /* the records are the deltas of the cumulative histograms */
+        latency_hist_reset(&hist);
+        latency_hist_record(&hist, 100);
+        latency_hist_record(&hist, 1000000);
+        TEST_ASSERT_EQUAL(0, hist_log_append(log, 1, 1000000, &hist));
+        latency_hist_record(&hist, 1000000);
+        TEST_ASSERT_EQUAL(0, hist_log_append(log, 1, 2000000, &hist));
+        TEST_ASSERT_EQUAL(0, hist_log_append(log, 0, 2000000, &hist));
+        TEST_ASSERT_EQUAL(-1, hist_log_append(log, 2, 2000000, &hist));
+        /* grows past the first mapping */
+        for (i = 0; i < HIST_LOG_GROW / 4; i++)
+                TEST_ASSERT_EQUAL(0, hist_log_append(log, 0, 3000000, &hist));
+        hist_log_close(log);
+
+        TEST_ASSERT_EQUAL(0, hist_log_open(&reader, path));
+        TEST_ASSERT_EQUAL(2, reader.nr_trace);
+        TEST_ASSERT_EQUAL(1, hist_log_next(&reader, &trace, &delta));
+        TEST_ASSERT_EQUAL(1, trace);
+        TEST_ASSERT_TRUE(reader.time_us == 1000000);
+        TEST_ASSERT_TRUE(delta.total_count == 2);
+        TEST_ASSERT_TRUE(delta.counts[latency_hist_index(100)] == 1);
+        TEST_ASSERT_EQUAL(1, hist_log_next(&reader, &trace, &delta));
+        TEST_ASSERT_TRUE(reader.time_us == 2000000);
+        TEST_ASSERT_TRUE(delta.total_count == 1);
+        TEST_ASSERT_TRUE(delta.counts[latency_hist_index(1000000)] == 1);
+        TEST_ASSERT_EQUAL(1, hist_log_next(&reader, &trace, &delta));
+        TEST_ASSERT_EQUAL(0, trace);
+        TEST_ASSERT_TRUE(delta.total_count == 3);
+        for (i = 0; i < HIST_LOG_GROW / 4; i++) {
+                TEST_ASSERT_EQUAL(1, hist_log_next(&reader, &trace, &delta));
+                TEST_ASSERT_TRUE(delta.total_count == 0);
+        }
+        TEST_ASSERT_TRUE(reader.time_us == 3000000);
+        TEST_ASSERT_EQUAL(0, hist_log_next(&reader, &trace, &delta));
+        hist_log_reader_close(&reader);
+
+        unlink(path);
+}
+
+void test_io_log(void)
+{
+        struct io_log_reader reader;
+        struct io_log_rec rec;
+        struct io_log *log;
+        char path[] = "/tmp/trace-replay-test-XXXXXX";
+        int fd, i;
+
+        TEST_ASSERT_EQUAL(0, IO_LOG_BUF_SIZE % sizeof(struct io_log_rec));
+        fd = mkstemp(path);
+        TEST_ASSERT_TRUE(fd >= 0);
+        close(fd);
+
+        /* one in 2 of the completions of 2 threads */
+        log = io_log_create(path, 2, 2, 2);
+        TEST_ASSERT_NOT_NULL(log);
+        memset(&rec, 0, sizeof(rec));
+        for (i = 0; i < 10; i++) {
+                rec.submit_ns = i * 1000;
+                rec.complete_ns = i * 1000 + 500;
+                rec.offset = i * 4096LL;
+                rec.bytes = 4096;
+                rec.thread = 1;
+                rec.dev = i % 4;
+                rec.depth = i + 1;
+                rec.read = i & 1;
+                io_log_record(log, &rec);
+        }
+        io_log_close(log);
+
+        TEST_ASSERT_EQUAL(0, io_log_open(&reader, path));
+        TEST_ASSERT_EQUAL(2, reader.header->per_thread);
+        TEST_ASSERT_EQUAL(2, reader.header->sample);
+        TEST_ASSERT_TRUE(reader.nr_recs == 5);
+        for (i = 0; i < 5; i++) {
+                TEST_ASSERT_TRUE(reader.recs[i].offset == (2 * i + 1) * 4096LL);
+                TEST_ASSERT_EQUAL(1, reader.recs[i].thread);
+                TEST_ASSERT_EQUAL((2 * i + 1) % 4, reader.recs[i].dev);
+                TEST_ASSERT_EQUAL(2 * i + 2, reader.recs[i].depth);
+                TEST_ASSERT_EQUAL(1, reader.recs[i].read);
+        }
+        io_log_reader_close(&reader);
+
+        unlink(path);
+}
+
 int main(void)
 {
         UNITY_BEGIN();
 
         RUN_TEST(test);
+        RUN_TEST(test_io_pool_class);
+        RUN_TEST(test_io_pool_recycle);
+        RUN_TEST(test_trace_ticket_repeat);
+        RUN_TEST(test_latency_hist_percentile);
+        RUN_TEST(test_trace_bin_window);
+        RUN_TEST(test_trace_stream_repeat);
+        RUN_TEST(test_trace_io_put_window);
+        RUN_TEST(test_trace_parse_line);
+        RUN_TEST(test_nstime);
+        RUN_TEST(test_lag_policy);
+        RUN_TEST(test_aio_ring_peek);
+        RUN_TEST(test_affinity_parse);
+        RUN_TEST(test_payload_fill);
+        RUN_TEST(test_verify_check);
+        RUN_TEST(test_synth_dist);
+        RUN_TEST(test_synth_perm);
+        RUN_TEST(test_arrival);
+        RUN_TEST(test_rate_limit);
+        RUN_TEST(test_hist_log);
+        RUN_TEST(test_io_log);
+        RUN_TEST(test_devno_map);
+        RUN_TEST(test_file_prepare);
 
         return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Token bucket rate limits of the dispatch
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <trace_replay.h>
+#include <nstime.h>
+#include <token_bucket.h>
+
+static void token_bucket_init(struct token_bucket *tb, double rate,
+                              double burst)
+{
+        tb->full = 0;
+        tb->ns_per_token = rate > 0 ? NSEC_PER_SEC / rate : 0;
+        tb->burst_ns = (long long)(burst * tb->ns_per_token);
+}
+
+/* ns until the bucket has tokens for n more, 0 for now */
+static long long token_bucket_delay(struct token_bucket *tb, long long now,
+                                    long long n)
+{
+        long long full = __atomic_load_n(&tb->full, __ATOMIC_RELAXED);
+        long long delay;
+
+        if (!tb->ns_per_token)
+                return 0;
+        if (full < now)
+                full = now;
+        delay = full + (long long)(n * tb->ns_per_token) - tb->burst_ns - now;
+        return delay > 0 ? delay : 0;
+}
+
+/* up to want tokens the bucket holds now */
+static long long token_bucket_take(struct token_bucket *tb, long long now,
+                                   long long want)
+{
+        long long full, base, n;
+
+        if (!tb->ns_per_token)
+                return want;
+
+        full = __atomic_load_n(&tb->full, __ATOMIC_RELAXED);
+        do {
+                base = full > now ? full : now;
+                n = (long long)((now + tb->burst_ns - base) / tb->ns_per_token);
+                if (n <= 0)
+                        return 0;
+                if (n > want)
+                        n = want;
+        } while (!__atomic_compare_exchange_n(
+                &tb->full, &full, base + (long long)(n * tb->ns_per_token), 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+        return n;
+}
+
+/* takes n tokens whether the bucket holds them or not, n < 0 returns them */
+static void token_bucket_charge(struct token_bucket *tb, long long now,
+                                long long n)
+{
+        long long full, base;
+
+        if (!tb->ns_per_token || !n)
+                return;
+        if (n < 0) {
+                __atomic_fetch_add(&tb->full,
+                                   (long long)(n * tb->ns_per_token),
+                                   __ATOMIC_RELAXED);
+                return;
+        }
+
+        full = __atomic_load_n(&tb->full, __ATOMIC_RELAXED);
+        do {
+                base = full > now ? full : now;
+        } while (!__atomic_compare_exchange_n(
+                &tb->full, &full, base + (long long)(n * tb->ns_per_token), 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static int parse_rate(const char *p, char **end, double *rate, double *burst)
+{
+        *rate = strtod(p, end);
+        if (*end == p || *rate < 0)
+                return -1;
+        *burst = -1;
+        if (**end == ':') {
+                p = *end + 1;
+                *burst = strtod(p, end);
+                if (*end == p || *burst <= 0)
+                        return -1;
+        }
+        return 0;
+}
+
+struct rate_limit *rate_limit_create(const char *spec)
+{
+        struct rate_limit *limit;
+        double iops, iops_burst;
+        double mbps = 0, mb_burst = -1;
+        char *end;
+
+        if (parse_rate(spec, &end, &iops, &iops_burst))
+                return NULL;
+        if (*end == ',' && parse_rate(end + 1, &end, &mbps, &mb_burst))
+                return NULL;
+        if (*end)
+                return NULL;
+
+        if (iops_burst < 0)
+                iops_burst = iops * RATE_LIMIT_BURST_NS / NSEC_PER_SEC;
+        /* a batch has to fit */
+        if (iops_burst < 1)
+                iops_burst = 1;
+        if (mb_burst < 0)
+                mb_burst = mbps * RATE_LIMIT_BURST_NS / NSEC_PER_SEC;
+
+        if (posix_memalign((void **)&limit, 64, sizeof(struct rate_limit)))
+                return NULL;
+        token_bucket_init(&limit->iops, iops, iops_burst);
+        token_bucket_init(&limit->bytes, mbps * MB, mb_burst * MB);
+        return limit;
+}
+
+/* ns until a request may go, 0 for now */
+long long rate_limit_delay(struct rate_limit *limit, long long now)
+{
+        long long iops, bytes;
+
+        if (limit == NULL)
+                return 0;
+        iops = token_bucket_delay(&limit->iops, now, 1);
+        bytes = token_bucket_delay(&limit->bytes, now, 0);
+        return iops > bytes ? iops : bytes;
+}
+
+int rate_limit_take(struct rate_limit *limit, long long now, int want)
+{
+        if (limit == NULL)
+                return want;
+        return (int)token_bucket_take(&limit->iops, now, want);
+}
+
+/* returns the unused requests of a take, charges the bytes issued */
+void rate_limit_done(struct rate_limit *limit, long long now, int unused,
+                     long long bytes)
+{
+        if (limit == NULL)
+                return;
+        token_bucket_charge(&limit->iops, now, -unused);
+        token_bucket_charge(&limit->bytes, now, bytes);
+}
+
+int rate_limit_format(const struct rate_limit *limit, char *buf, int len)
+{
+        const struct token_bucket *iops = &limit->iops;
+        const struct token_bucket *bytes = &limit->bytes;
+
+        return snprintf(buf, len, "%g:%g,%g:%g",
+                        iops->ns_per_token ? NSEC_PER_SEC / iops->ns_per_token :
+                                             0,
+                        iops->ns_per_token ? iops->burst_ns /
+                                                     iops->ns_per_token :
+                                             0,
+                        bytes->ns_per_token ? NSEC_PER_SEC /
+                                                      bytes->ns_per_token / MB :
+                                              0,
+                        bytes->ns_per_token ? bytes->burst_ns /
+                                                      bytes->ns_per_token / MB :
+                                              0);
+}
+
+void rate_limit_destroy(struct rate_limit *limit)
+{
+        free(limit);
+}
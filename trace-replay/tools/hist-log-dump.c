@@ -0,0 +1,136 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Dump of a latency histogram log as CSV or JSON
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Prints the records of a --hist-log file, the histogram of each trace over
+ * each report interval. CSV has a line per record with its percentiles (us),
+ * JSON has the non-empty buckets as well, as [value (ns), count] pairs.
+ *
+ * usage: hist-log-dump [--json] file
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hist_log.h>
+
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+static const char *const percentile_names[] = { "p50", "p90", "p99", "p999",
+                                                "p9999" };
+#define NR_PERCENTILES (int)(sizeof(percentiles) / sizeof(percentiles[0]))
+
+static unsigned long long hist_max(const struct latency_hist *hist)
+{
+        int i;
+
+        for (i = HIST_NR_BUCKETS - 1; i >= 0; i--)
+                if (hist->counts[i])
+                        return latency_hist_value(i);
+        return 0;
+}
+
+static void print_csv(const struct hist_log_reader *reader, int trace,
+                      const struct latency_hist *hist)
+{
+        int i;
+
+        printf("%.6f,%d,%llu", reader->time_us / 1e6, trace,
+               hist->total_count);
+        for (i = 0; i < NR_PERCENTILES; i++)
+                printf(",%.3f",
+                       latency_hist_percentile(hist, percentiles[i]) / 1e3);
+        printf(",%.3f\n", hist_max(hist) / 1e3);
+}
+
+static void print_json(const struct hist_log_reader *reader, int trace,
+                       const struct latency_hist *hist, int first)
+{
+        int i, n = 0;
+
+        printf("%s\n    { \"time\": %.6f, \"trace\": %d, \"count\": %llu",
+               first ? "" : ",", reader->time_us / 1e6, trace,
+               hist->total_count);
+        for (i = 0; i < NR_PERCENTILES; i++)
+                printf(", \"%s_us\": %.3f", percentile_names[i],
+                       latency_hist_percentile(hist, percentiles[i]) / 1e3);
+        printf(", \"max_us\": %.3f, \"buckets\": [", hist_max(hist) / 1e3);
+        for (i = 0; i < HIST_NR_BUCKETS; i++) {
+                if (!hist->counts[i])
+                        continue;
+                printf("%s[%llu, %llu]", n++ ? ", " : "",
+                       latency_hist_value(i), hist->counts[i]);
+        }
+        printf("] }");
+}
+
+int main(int argc, char **argv)
+{
+        /* too large for the stack */
+        static struct latency_hist hist;
+        struct hist_log_reader reader;
+        const char *path = NULL;
+        int json = 0;
+        int nr = 0;
+        int trace, ret, i;
+
+        for (i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "--json"))
+                        json = 1;
+                else if (path == NULL)
+                        path = argv[i];
+                else
+                        break;
+        }
+        if (path == NULL || i < argc) {
+                printf(" usage: %s [--json] file\n", argv[0]);
+                return -1;
+        }
+
+        if (hist_log_open(&reader, path)) {
+                fprintf(stderr, " %s is not a hist log\n", path);
+                return -1;
+        }
+
+        if (json) {
+                printf("{\n  \"start_time\": %llu,\n  \"nr_trace\": %d,\n"
+                       "  \"records\": [",
+                       reader.start_time, reader.nr_trace);
+        } else {
+                printf("time,trace,count");
+                for (i = 0; i < NR_PERCENTILES; i++)
+                        printf(",%s_us", percentile_names[i]);
+                printf(",max_us\n");
+        }
+
+        while ((ret = hist_log_next(&reader, &trace, &hist)) > 0) {
+                if (json)
+                        print_json(&reader, trace, &hist, !nr);
+                else
+                        print_csv(&reader, trace, &hist);
+                nr++;
+        }
+
+        if (json)
+                printf("\n  ]\n}\n");
+        hist_log_reader_close(&reader);
+
+        if (ret < 0) {
+                fprintf(stderr, " %s is broken after %d records\n", path, nr);
+                return -1;
+        }
+        return 0;
+}
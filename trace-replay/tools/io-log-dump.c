@@ -0,0 +1,111 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Dump of a per-I/O completion log as CSV or Chrome trace JSON
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+/*
+ * Prints the records of an --io-log file. CSV has a line per completion
+ * (times in us since the replay start). --chrome writes the Trace Event
+ * Format read by chrome://tracing and ui.perfetto.dev: a process per trace,
+ * a thread per worker and an async slice per request, so the requests in
+ * flight together show up side by side.
+ *
+ * usage: io-log-dump [--chrome] file
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <io_log.h>
+
+static void print_csv(const struct io_log_reader *reader)
+{
+        int per_thread = reader->header->per_thread;
+        long long i;
+
+        printf("trace,thread,dev,op,offset,bytes,submit_us,complete_us,latency_us,depth,error\n");
+        for (i = 0; i < reader->nr_recs; i++) {
+                const struct io_log_rec *rec = &reader->recs[i];
+
+                printf("%d,%d,%d,%c,%lld,%u,%.3f,%.3f,%.3f,%d,%d\n",
+                       rec->thread / per_thread, rec->thread, rec->dev,
+                       rec->read ? 'R' : 'W', (long long)rec->offset,
+                       rec->bytes, rec->submit_ns / 1e3,
+                       rec->complete_ns / 1e3,
+                       (rec->complete_ns - rec->submit_ns) / 1e3, rec->depth,
+                       rec->error);
+        }
+}
+
+static void print_chrome(const struct io_log_reader *reader)
+{
+        int per_thread = reader->header->per_thread;
+        long long i;
+
+        printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+        for (i = 0; i < reader->nr_recs; i++) {
+                const struct io_log_rec *rec = &reader->recs[i];
+                const char *name = rec->read ? "read" : "write";
+                int pid = rec->thread / per_thread;
+
+                printf(" {\"name\": \"%s\", \"cat\": \"io\", \"ph\": \"b\", \"id\": %lld, \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"args\": {\"dev\": %d, \"offset\": %lld, \"bytes\": %u, \"depth\": %d, \"error\": %d}},\n",
+                       name, i, pid, rec->thread,
+                       rec->submit_ns / 1e3, rec->dev, (long long)rec->offset,
+                       rec->bytes, rec->depth, rec->error);
+                printf(" {\"name\": \"%s\", \"cat\": \"io\", \"ph\": \"e\", \"id\": %lld, \"pid\": %d, \"tid\": %d, \"ts\": %.3f}%s\n",
+                       name, i, pid, rec->thread, rec->complete_ns / 1e3,
+                       i + 1 < reader->nr_recs ? "," : "");
+        }
+        printf("]}\n");
+}
+
+int main(int argc, char **argv)
+{
+        struct io_log_reader reader;
+        const char *path = NULL;
+        int chrome = 0;
+        int i;
+
+        for (i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "--chrome"))
+                        chrome = 1;
+                else if (path == NULL)
+                        path = argv[i];
+                else
+                        break;
+        }
+        if (path == NULL || i < argc) {
+                printf(" usage: %s [--chrome] file\n", argv[0]);
+                return -1;
+        }
+
+        if (io_log_open(&reader, path)) {
+                fprintf(stderr, " %s is not an io log\n", path);
+                return -1;
+        }
+        if (!reader.header->per_thread) {
+                fprintf(stderr, " %s has no threads\n", path);
+                io_log_reader_close(&reader);
+                return -1;
+        }
+
+        if (chrome)
+                print_chrome(&reader);
+        else
+                print_csv(&reader);
+
+        io_log_reader_close(&reader);
+        return 0;
+}
@@ -0,0 +1,169 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Binary trace format
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <trace_replay.h>
+#include <trace_bin.h>
+
+_Static_assert(sizeof(struct trace_bin_header) == 64,
+               "trace_bin_header is part of the file format");
+_Static_assert(sizeof(struct trace_io_req) == 24,
+               "trace_io_req is part of the file format");
+
+/* returns 1 for a binary trace, 0 for anything else, -errno on failure */
+int trace_bin_probe(const char *path)
+{
+        char magic[TRACE_BIN_MAGIC_LEN];
+        ssize_t len;
+        int fd;
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -errno;
+
+        len = read(fd, magic, sizeof(magic));
+        close(fd);
+
+        return len == TRACE_BIN_MAGIC_LEN &&
+               !memcmp(magic, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN);
+}
+
+int trace_bin_map(const char *path, struct trace_bin_header *hdr, void **map,
+                  size_t *map_size)
+{
+        struct stat st;
+        void *p;
+        int fd;
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*hdr)) {
+                close(fd);
+                return -EINVAL;
+        }
+
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        memcpy(hdr, p, sizeof(*hdr));
+        if (memcmp(hdr->magic, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN) ||
+            hdr->version != TRACE_BIN_VERSION ||
+            hdr->record_size != sizeof(struct trace_io_req) ||
+            hdr->nr_records < 0 || hdr->nr_records > INT_MAX ||
+            (off_t)(sizeof(*hdr) + hdr->nr_records * hdr->record_size) >
+                    st.st_size) {
+                fprintf(stderr, "%s: unsupported binary trace\n", path);
+                munmap(p, st.st_size);
+                return -EINVAL;
+        }
+
+        madvise(p, st.st_size, MADV_WILLNEED);
+        *map = p;
+        *map_size = st.st_size;
+        return 0;
+}
+
+struct trace_io_req *trace_bin_records(void *map)
+{
+        return (struct trace_io_req *)((char *)map +
+                                       sizeof(struct trace_bin_header));
+}
+
+void trace_bin_unmap(void *map, size_t map_size)
+{
+        munmap(map, map_size);
+}
+
+void trace_bin_header_init(struct trace_bin_header *hdr, long long nr_records,
+                           long long window, long long src_size,
+                           long long src_mtime)
+{
+        memset(hdr, 0, sizeof(*hdr));
+        memcpy(hdr->magic, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN);
+        hdr->version = TRACE_BIN_VERSION;
+        hdr->record_size = sizeof(struct trace_io_req);
+        hdr->nr_records = nr_records;
+        hdr->window = window;
+        hdr->src_size = src_size;
+        hdr->src_mtime = src_mtime;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+        const char *p = buf;
+
+        while (len) {
+                ssize_t ret = write(fd, p, len);
+
+                if (ret < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                }
+                p += ret;
+                len -= ret;
+        }
+
+        return 0;
+}
+
+/* written to a temporary file first, so readers never see a partial one */
+int trace_bin_write(const char *path, const struct trace_io_req *reqs,
+                    long long nr_records, long long window, long long src_size,
+                    long long src_mtime)
+{
+        struct trace_bin_header hdr;
+        char tmp_path[PATH_MAX];
+        int fd, ret;
+
+        trace_bin_header_init(&hdr, nr_records, window, src_size, src_mtime);
+
+        if (snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path,
+                     getpid()) >= (int)sizeof(tmp_path))
+                return -ENAMETOOLONG;
+
+        fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+                return -errno;
+
+        ret = write_all(fd, &hdr, sizeof(hdr));
+        if (!ret)
+                ret = write_all(fd, reqs,
+                                nr_records * sizeof(struct trace_io_req));
+        if (close(fd) && !ret)
+                ret = -errno;
+        if (!ret && rename(tmp_path, path))
+                ret = -errno;
+        if (ret)
+                unlink(tmp_path);
+
+        return ret;
+}
@@ -0,0 +1,299 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Interval index of the overlap trimming window
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdlib.h>
+
+#include <trace_index.h>
+
+#define NIL (-1)
+
+struct trace_index *trace_index_create(int window)
+{
+        struct trace_index *index;
+
+        index = calloc(1, sizeof(struct trace_index));
+        if (index == NULL)
+                return NULL;
+
+        index->window = window;
+        index->nodes = calloc(window, sizeof(struct trace_index_node));
+        index->found = malloc(sizeof(long long) * window);
+        if (index->nodes == NULL || index->found == NULL) {
+                trace_index_destroy(index);
+                return NULL;
+        }
+
+        index->seed = 2463534242U;
+        trace_index_reset(index);
+        return index;
+}
+
+void trace_index_reset(struct trace_index *index)
+{
+        int i;
+
+        for (i = 0; i < index->window; i++)
+                index->nodes[i].used = 0;
+        index->root = NIL;
+}
+
+void trace_index_destroy(struct trace_index *index)
+{
+        if (index == NULL)
+                return;
+        free(index->nodes);
+        free(index->found);
+        free(index);
+}
+
+static unsigned int trace_index_rand(struct trace_index *index)
+{
+        unsigned int x = index->seed;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        index->seed = x;
+        return x;
+}
+
+static void node_set(struct trace_index_node *node,
+                     const struct trace_io_req *req)
+{
+        long long end = req->blkno + req->bcount;
+
+        node->devno = req->devno;
+        node->lo = req->blkno < end ? req->blkno : end;
+        node->hi = req->blkno < end ? end : req->blkno;
+}
+
+/* (devno, lo, seq) order */
+static int node_before(const struct trace_index_node *a,
+                       const struct trace_index_node *b)
+{
+        if (a->devno != b->devno)
+                return a->devno < b->devno;
+        if (a->lo != b->lo)
+                return a->lo < b->lo;
+        return a->seq < b->seq;
+}
+
+static void node_update(struct trace_index *index, int n)
+{
+        struct trace_index_node *node = &index->nodes[n];
+
+        node->max_hi = node->hi;
+        if (node->left != NIL && index->nodes[node->left].max_hi > node->max_hi)
+                node->max_hi = index->nodes[node->left].max_hi;
+        if (node->right != NIL &&
+            index->nodes[node->right].max_hi > node->max_hi)
+                node->max_hi = index->nodes[node->right].max_hi;
+}
+
+static int treap_insert(struct trace_index *index, int t, int n)
+{
+        struct trace_index_node *node = &index->nodes[n];
+        struct trace_index_node *cur;
+        int child;
+
+        if (t == NIL)
+                return n;
+
+        cur = &index->nodes[t];
+        if (node_before(node, cur)) {
+                child = treap_insert(index, cur->left, n);
+                cur->left = child;
+                if (index->nodes[child].prio > cur->prio) {
+                        /* rotate right */
+                        cur->left = index->nodes[child].right;
+                        index->nodes[child].right = t;
+                        node_update(index, t);
+                        t = child;
+                }
+        } else {
+                child = treap_insert(index, cur->right, n);
+                cur->right = child;
+                if (index->nodes[child].prio > cur->prio) {
+                        /* rotate left */
+                        cur->right = index->nodes[child].left;
+                        index->nodes[child].left = t;
+                        node_update(index, t);
+                        t = child;
+                }
+        }
+
+        node_update(index, t);
+        return t;
+}
+
+static int treap_merge(struct trace_index *index, int a, int b)
+{
+        if (a == NIL)
+                return b;
+        if (b == NIL)
+                return a;
+
+        if (index->nodes[a].prio > index->nodes[b].prio) {
+                index->nodes[a].right =
+                        treap_merge(index, index->nodes[a].right, b);
+                node_update(index, a);
+                return a;
+        }
+
+        index->nodes[b].left = treap_merge(index, a, index->nodes[b].left);
+        node_update(index, b);
+        return b;
+}
+
+static int treap_erase(struct trace_index *index, int t, int n)
+{
+        struct trace_index_node *cur;
+
+        if (t == NIL)
+                return NIL;
+
+        cur = &index->nodes[t];
+        if (t == n)
+                return treap_merge(index, cur->left, cur->right);
+
+        if (node_before(&index->nodes[n], cur))
+                cur->left = treap_erase(index, cur->left, n);
+        else
+                cur->right = treap_erase(index, cur->right, n);
+
+        node_update(index, t);
+        return t;
+}
+
+static void node_insert(struct trace_index *index, int n)
+{
+        struct trace_index_node *node = &index->nodes[n];
+
+        node->left = NIL;
+        node->right = NIL;
+        node->max_hi = node->hi;
+        index->root = treap_insert(index, index->root, n);
+}
+
+/* collects the requests of devno whose extent meets [lo, hi] */
+static int treap_query(struct trace_index *index, int t, int devno,
+                       long long lo, long long hi, int nr)
+{
+        struct trace_index_node *node;
+
+        while (t != NIL) {
+                node = &index->nodes[t];
+                if (node->max_hi < lo)
+                        break;
+
+                if (node->devno >= devno)
+                        nr = treap_query(index, node->left, devno, lo, hi, nr);
+                if (node->devno > devno ||
+                    (node->devno == devno && node->lo > hi))
+                        break;
+                if (node->devno == devno && node->hi >= lo)
+                        index->found[nr++] = node->seq;
+                t = node->right;
+        }
+
+        return nr;
+}
+
+static int seq_cmp(const void *a, const void *b)
+{
+        long long x = *(const long long *)a;
+        long long y = *(const long long *)b;
+
+        return (x > y) - (x < y);
+}
+
+/*
+ * Same rules as the linear scan this replaced: the requests are visited in
+ * trace order and req only ever shrinks, so the requests which meet the
+ * original extent of req are the only ones which can change it.
+ */
+int trace_index_trim(struct trace_index *index, struct trace_io_req *buf,
+                     long long mask, struct trace_io_req *req)
+{
+        struct trace_index_node probe;
+        struct trace_io_req *io;
+        int nr, i;
+
+        if (index == NULL || index->root == NIL)
+                return 0;
+
+        node_set(&probe, req);
+        nr = treap_query(index, index->root, probe.devno, probe.lo, probe.hi,
+                         0);
+        if (nr > 1)
+                qsort(index->found, nr, sizeof(long long), seq_cmp);
+
+        for (i = 0; i < nr; i++) {
+                io = &buf[index->found[i] & mask];
+
+                if (req->blkno < io->blkno &&
+                    (req->blkno + req->bcount) > io->blkno &&
+                    (req->blkno + req->bcount) < (io->blkno + io->bcount)) {
+                        req->bcount = io->blkno - req->blkno;
+                } else if (req->blkno <= io->blkno &&
+                           (req->blkno + req->bcount) >=
+                                   (io->blkno + io->bcount)) {
+                        int n = index->found[i] % index->window;
+
+                        index->root = treap_erase(index, index->root, n);
+                        io->blkno = req->blkno;
+                        io->bcount = req->bcount;
+                        node_set(&index->nodes[n], io);
+                        node_insert(index, n);
+                        return 1;
+                } else if (req->blkno >= io->blkno &&
+                           (req->blkno + req->bcount) <=
+                                   (io->blkno + io->bcount)) {
+                        return 1;
+                } else if (req->blkno > io->blkno &&
+                           req->blkno < (io->blkno + io->bcount) &&
+                           (req->blkno + req->bcount) >
+                                   (io->blkno + io->bcount)) {
+                        req->bcount = req->bcount -
+                                      (io->blkno + io->bcount - req->blkno);
+                        req->blkno = io->blkno + io->bcount;
+                }
+        }
+
+        return 0;
+}
+
+void trace_index_add(struct trace_index *index, long long seq,
+                     const struct trace_io_req *req)
+{
+        struct trace_index_node *node;
+        int n;
+
+        if (index == NULL)
+                return;
+
+        n = seq % index->window;
+        node = &index->nodes[n];
+        if (node->used)
+                index->root = treap_erase(index, index->root, n);
+
+        node_set(node, req);
+        node->seq = seq;
+        node->prio = trace_index_rand(index);
+        node->used = 1;
+        node_insert(index, n);
+}
@@ -0,0 +1,374 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * DiskSim ascii trace parser
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <trace_replay.h>
+#include <trace_parse.h>
+
+static const double pow10_exact[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int trace_parse_scanf(const char *line, const char *end,
+                             struct trace_io_req *req)
+{
+        char buf[256];
+        size_t len = end - line;
+        double arrival_time;
+        int devno;
+        long long blkno;
+        int bcount;
+        unsigned int flags;
+
+        if (len > sizeof(buf) - 2)
+                len = sizeof(buf) - 2;
+        memcpy(buf, line, len);
+        if (!len || buf[len - 1] != '\n')
+                buf[len++] = '\n';
+        buf[len] = '\0';
+
+        if (sscanf(buf, "%lf %d %lld %d %x\n", &arrival_time, &devno, &blkno,
+                   &bcount, &flags) != 5) {
+                fprintf(stderr,
+                        "Wrong number of arguments for I/O trace event type\n");
+                fprintf(stderr, "line: %s", buf);
+                return -1;
+        }
+        /* a request keeps both in 16 bits */
+        if (devno < SHRT_MIN || devno > SHRT_MAX || flags > USHRT_MAX) {
+                fprintf(stderr,
+                        "devno or flags out of range for I/O trace event type\n");
+                fprintf(stderr, "line: %s", buf);
+                return -1;
+        }
+
+        req->arrival_time = arrival_time;
+        req->devno = (short)devno;
+        req->blkno = blkno;
+        req->bcount = bcount;
+        req->flags = (short)flags;
+
+        return 0;
+}
+
+static inline int is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline const char *skip_space(const char *p, const char *end)
+{
+        while (p < end && is_space(*p))
+                p++;
+        return p;
+}
+
+/* a field other than the last one has to end with a space */
+static inline int field_end(const char *p, const char *end)
+{
+        return p == end || is_space(*p);
+}
+
+/*
+ * m / 10^k is exact, and so rounded as strtod() would, while m < 2^53 and
+ * k <= 22. Longer numbers and exponents are left to sscanf().
+ */
+static const char *parse_double(const char *p, const char *end, double *val)
+{
+        unsigned long long m = 0;
+        int digits = 0;
+        int frac = 0;
+        int neg = 0;
+
+        if (p < end && (*p == '-' || *p == '+'))
+                neg = *p++ == '-';
+        for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+                m = m * 10 + (*p - '0');
+        if (p < end && *p == '.') {
+                for (p++; p < end && *p >= '0' && *p <= '9'; p++, frac++)
+                        m = m * 10 + (*p - '0');
+        }
+
+        digits += frac;
+        if (!digits || digits > 18 || m > (1ULL << 53) || !field_end(p, end))
+                return NULL;
+
+        *val = (double)m / pow10_exact[frac];
+        if (neg)
+                *val = -*val;
+        return p;
+}
+
+static const char *parse_int(const char *p, const char *end, long long *val,
+                             int max_digits)
+{
+        long long v = 0;
+        int digits = 0;
+        int neg = 0;
+
+        if (p < end && (*p == '-' || *p == '+'))
+                neg = *p++ == '-';
+        for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+                v = v * 10 + (*p - '0');
+
+        if (!digits || digits > max_digits || !field_end(p, end))
+                return NULL;
+
+        *val = neg ? -v : v;
+        return p;
+}
+
+static const char *parse_hex(const char *p, const char *end, unsigned int *val)
+{
+        unsigned int v = 0;
+        int digits = 0;
+
+        if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+                p += 2;
+        for (; p < end && digits <= 8; p++, digits++) {
+                char c = *p;
+
+                if (c >= '0' && c <= '9')
+                        v = (v << 4) | (c - '0');
+                else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                        v = (v << 4) | ((c | 0x20) - 'a' + 10);
+                else
+                        break;
+        }
+
+        if (!digits || digits > 8)
+                return NULL;
+
+        *val = v;
+        return p;
+}
+
+/* parses [line, end), which may or may not include the newline */
+int trace_parse_line(const char *line, const char *end,
+                     struct trace_io_req *req)
+{
+        const char *p = line;
+        double arrival_time;
+        long long devno, blkno, bcount;
+        unsigned int flags;
+
+        if ((p = parse_double(skip_space(p, end), end, &arrival_time)) &&
+            (p = parse_int(skip_space(p, end), end, &devno, 9)) &&
+            (p = parse_int(skip_space(p, end), end, &blkno, 18)) &&
+            (p = parse_int(skip_space(p, end), end, &bcount, 9)) &&
+            (p = parse_hex(skip_space(p, end), end, &flags)) &&
+            devno >= SHRT_MIN && devno <= SHRT_MAX && flags <= USHRT_MAX) {
+                req->arrival_time = arrival_time;
+                req->devno = (short)devno;
+                req->blkno = blkno;
+                req->bcount = (int)bcount;
+                req->flags = (short)flags;
+                return 0;
+        }
+
+        return trace_parse_scanf(line, end, req);
+}
+
+/* the newline ending the line at p, or end */
+const char *trace_parse_eol(const char *p, const char *end)
+{
+#ifdef __SSE2__
+        const __m128i nl = _mm_set1_epi8('\n');
+
+        while (end - p >= 16) {
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                        _mm_loadu_si128((const __m128i *)p), nl));
+
+                if (mask)
+                        return p + __builtin_ctz(mask);
+                p += 16;
+        }
+#endif
+        while (p < end && *p != '\n')
+                p++;
+        return p;
+}
+
+long long trace_parse_count_lines(const char *p, const char *end)
+{
+        const char *start = p;
+        long long nr = 0;
+
+#ifdef __SSE2__
+        const __m128i nl = _mm_set1_epi8('\n');
+
+        while (end - p >= 16) {
+                nr += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                        _mm_loadu_si128((const __m128i *)p), nl)));
+                p += 16;
+        }
+#endif
+        for (; p < end; p++)
+                nr += *p == '\n';
+
+        /* the last line may miss its newline */
+        if (end > start && end[-1] != '\n')
+                nr++;
+        return nr;
+}
+
+struct parse_chunk {
+        const char *start;
+        const char *end;
+        struct trace_io_req *out;
+        long long nr_lines;
+        long long nr_req;
+        int count_only;
+        int threaded;
+        pthread_t thread;
+};
+
+static void *parse_worker(void *data)
+{
+        struct parse_chunk *chunk = (struct parse_chunk *)data;
+        const char *p = chunk->start;
+
+        if (chunk->count_only) {
+                chunk->nr_lines = trace_parse_count_lines(p, chunk->end);
+                return NULL;
+        }
+
+        chunk->nr_req = 0;
+        while (p < chunk->end) {
+                const char *eol = trace_parse_eol(p, chunk->end);
+
+                if (!trace_parse_line(p, eol, &chunk->out[chunk->nr_req]))
+                        chunk->nr_req++;
+                p = eol + 1;
+        }
+        return NULL;
+}
+
+static void parse_run(struct parse_chunk *chunks, int nr, int count_only)
+{
+        int i;
+
+        for (i = 0; i < nr; i++) {
+                chunks[i].count_only = count_only;
+                chunks[i].threaded =
+                        i && !pthread_create(&chunks[i].thread, NULL,
+                                             parse_worker, &chunks[i]);
+        }
+        for (i = 0; i < nr; i++) {
+                if (chunks[i].threaded)
+                        pthread_join(chunks[i].thread, NULL);
+                else
+                        parse_worker(&chunks[i]);
+        }
+}
+
+/*
+ * Parses a regular text trace with up to nr_threads threads (0 for one per
+ * cpu). Every thread takes a newline aligned part of the mapped file and
+ * parses it into its own range of trace_buf; the ranges are then put in
+ * file order through trace_io_put_req(), which trims them in place.
+ */
+int trace_parse_fd(struct trace_info_t *trace, int fd, int nr_threads)
+{
+        struct parse_chunk chunks[TRACE_PARSE_MAX_THREADS];
+        struct trace_io_req *buf;
+        struct stat st;
+        const char *map, *end;
+        long long total = 0;
+        int nr, i;
+
+        if (fstat(fd, &st))
+                return -1;
+
+        if (nr_threads <= 0)
+                nr_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        nr = st.st_size / TRACE_PARSE_MIN_CHUNK;
+        if (nr > nr_threads)
+                nr = nr_threads;
+        if (nr > TRACE_PARSE_MAX_THREADS)
+                nr = TRACE_PARSE_MAX_THREADS;
+        if (nr < 1)
+                nr = 1;
+
+        if (!st.st_size) {
+                trace->trace_io_cnt = 0;
+                return 0;
+        }
+
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+                return -1;
+        madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+        end = map + st.st_size;
+
+        for (i = 0; i < nr; i++) {
+                const char *p = map + st.st_size / nr * i;
+
+                if (i)
+                        p = trace_parse_eol(p - 1, end) + 1;
+                if (p > end)
+                        p = end;
+                chunks[i].start = p;
+                if (i)
+                        chunks[i - 1].end = p;
+        }
+        chunks[nr - 1].end = end;
+
+        parse_run(chunks, nr, 1);
+        for (i = 0; i < nr; i++)
+                total += chunks[i].nr_lines;
+
+        buf = malloc(sizeof(struct trace_io_req) * (total + 1));
+        if (buf == NULL) {
+                munmap((void *)map, st.st_size);
+                return -1;
+        }
+        for (i = 0, total = 0; i < nr; i++) {
+                chunks[i].out = buf + total;
+                total += chunks[i].nr_lines;
+        }
+
+        parse_run(chunks, nr, 0);
+        munmap((void *)map, st.st_size);
+
+        free(trace->trace_buf);
+        trace->trace_buf = buf;
+        trace->trace_buf_size = (int)(total + 1);
+        trace->trace_io_cnt = 0;
+        for (i = 0; i < nr; i++) {
+                long long j;
+
+                for (j = 0; j < chunks[i].nr_req; j++) {
+                        struct trace_io_req req = chunks[i].out[j];
+                        trace_io_put_req(trace, &req);
+                }
+        }
+
+        return 0;
+}
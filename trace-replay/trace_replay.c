@@ -26,6 +26,8 @@
 #include <errno.h>
 #include <signal.h>
 #include <float.h>
+#include <limits.h>
+#include <getopt.h>
 
 #include <sys/mount.h>
 #include <sys/types.h>
@@ -36,15 +38,38 @@
 #include <sys/msg.h>
 #include <sys/shm.h>
 #include <sys/sem.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/eventfd.h>
+#include <sched.h>
 
 #include <flist.h>
 #include <trace_replay.h>
 #include <disk_io.h>
+#include <uring_io.h>
+#include <aio_ring.h>
+#include <affinity.h>
+#include <payload.h>
+#include <verify.h>
+#include <synth_dist.h>
+#include <arrival.h>
+#include <token_bucket.h>
+#include <io_pool.h>
+#include <latency_hist.h>
+#include <hist_log.h>
+#include <io_log.h>
+#include <nstime.h>
+#include <trace_bin.h>
+#include <trace_stream.h>
+#include <trace_index.h>
+#include <trace_parse.h>
 
 #define REFRESH_SLEEP 1000000
 
 FILE *log_fp;
 FILE *json_fp;
+struct hist_log *hist_log; // NULL without --hist-log
+struct io_log *io_log; // NULL without --io-log
 unsigned int log_count = 0;
 struct thread_info_t th_info[MAX_THREADS];
 struct trace_info_t traces[MAX_THREADS];
@@ -56,11 +81,56 @@ int cnt2 = 0;
 int nr_thread;
 int nr_trace;
 unsigned int io_size; // in bytes
-struct timeval tv_start, tv_end, tv_result, tv_start2;
+unsigned long long start_ns, end_ns; // replay start and last report
 double execution_time = 0.0;
 double timeout;
 long long wanted_io_count;
 char key_pathname[BASE_KEY_PATHNAME_LEN];
+int io_engine = IO_ENGINE_LIBAIO;
+unsigned int uring_flags = 0;
+int use_hugepage = 0;
+int use_trace_cache = 1;
+int convert_mode = 0;
+int convert_window = 0;
+int stream_mb = 0;
+int parse_threads = 0; // one per cpu
+int use_tsc = 0;
+int pace_spin_us = PACE_SPIN_US;
+int sched_fifo_prio = 0; // SCHED_OTHER
+int use_mlock = 0;
+int open_loop = 0; // requests in flight per worker, 0 for the closed loop
+int lag_policy = LAG_BURST;
+int lag_threshold_us = LAG_THRESHOLD_US;
+int lag_rate = 0; // catch-up requests per second of LAG_RATE
+int user_reap = 0;
+int completer = 0;
+char *cpus_opt = NULL; // per trace cpulists or auto, split by '/'
+int payload_compress = -1; // -1 leaves the write buffers as they are
+int payload_dedupe = 0;
+int payload_refill = PAYLOAD_REFILL;
+int verify = 0;
+uint32_t verify_seed; // tells the writes of this run from older ones
+char *skew_opt = NULL; // per trace distribution parameters, split by '/'
+char *arrival_opt = NULL; // per trace arrival processes, split by '/'
+char *rate_opt = NULL; // per trace rate limits, split by '/'
+char *thread_rate_opt = NULL; // per worker of each trace, split by '/'
+char *hist_log_opt = NULL; // "" for <output>.hist
+char *io_log_opt = NULL; // "" for <output>.io
+int io_log_sample = 1; // 1 in N completions go to the io log
+char *dev_opt = NULL; // per trace devices, split by ','
+char *devno_map_opt = NULL; // N:DEV of the devnos not on the trace's device
+int file_size_mb = 0; // of the file targets, 0 for the size they have
+int prewrite = 0;
+
+/* the distinct devices of all traces, each split among its traces */
+static struct replay_dev {
+        char path[STR_SIZE];
+        long long capacity;
+        int open_flags; // without O_DIRECT on a filesystem lacking it
+        int nr_traces;
+        int nr_parts;
+} replay_devs[MAX_DEVS];
+static int nr_dev;
 
 void sgenrand(unsigned long seed);
 unsigned long genrand();
@@ -96,37 +166,26 @@ int timeval_subtract(result, x, y) struct timeval *result, *x, *y;
         return x->tv_sec < y->tv_sec;
 }
 
-// generated by Eunjae
-static double time_since_ms(struct timeval *start_tv, struct timeval *stop_tv)
+/* the arrival time in ms of the request of ticket, a repeat starts later */
+static inline double trace_arrival_ms(struct trace_info_t *trace,
+                                      double arrival_time, long long ticket)
 {
-        double sec, usec;
-        double ret;
-        sec = stop_tv->tv_sec - start_tv->tv_sec;
-        usec = stop_tv->tv_usec - start_tv->tv_usec;
-        if (sec > 0 && usec < 0) {
-                sec--;
-                usec += 1000000;
-        }
-        ret = sec * 1000 + usec / (double)1000;
-        if (ret < 0)
-                ret = 0;
-        return ret;
+        /* a stream publishes the period with the count of its first pass */
+        int nr_req = __atomic_load_n(&trace->trace_io_cnt, __ATOMIC_ACQUIRE);
+
+        if (nr_req && trace->trace_period > 0.0)
+                arrival_time += (double)(ticket / nr_req) * trace->trace_period;
+        return arrival_time;
 }
 
-static double time_since(struct timeval *start_tv, struct timeval *stop_tv)
+/* ns after start_ns at which io of ticket is due, see LAG_SHIFT */
+static inline long long trace_arrival_ns(struct trace_info_t *trace,
+                                         struct trace_io_req *io,
+                                         long long ticket)
 {
-        double sec, usec;
-        double ret;
-        sec = stop_tv->tv_sec - start_tv->tv_sec;
-        usec = stop_tv->tv_usec - start_tv->tv_usec;
-        if (sec > 0 && usec < 0) {
-                sec--;
-                usec += 1000000;
-        }
-        ret = sec + usec / (double)1000000;
-        if (ret < 0)
-                ret = 0;
-        return ret;
+        return (long long)(trace_arrival_ms(trace, io->arrival_time, ticket) *
+                           trace->trace_timescale * NSEC_PER_MSEC) +
+               __atomic_load_n(&trace->lag_shift, __ATOMIC_RELAXED);
 }
 
 /* allocate a alignment-bytes aligned buffer */
@@ -146,13 +205,12 @@ void *allocate_aligned_buffer(size_t size)
         return p;
 }
 
-void align_sector(struct thread_info_t *t_info, int *blkno, int *bcount)
+void align_sector(long long total_pages, long long *blkno, int *bcount)
 {
-        struct trace_info_t *trace = t_info->trace;
-        int pageno = *blkno / SPP;
+        long long pageno = *blkno / SPP;
         int pcount;
 
-        pageno %= trace->total_pages;
+        pageno %= total_pages;
 
         if (*bcount % SPP) {
                 pcount = *bcount / SPP + 1;
@@ -163,27 +221,87 @@ void align_sector(struct thread_info_t *t_info, int *blkno, int *bcount)
         }
         pcount = *bcount / SPP;
 
-        if (pageno + pcount >= trace->total_pages) {
+        if (pageno + pcount >= total_pages) {
                 pageno -= pcount;
         }
 
         *blkno = pageno * SPP;
 }
 
+/*
+ * io_stat_t has a single writer, its worker thread, which brackets every
+ * update with io_stat_write_begin()/end(). The reporter copies it with
+ * io_stat_read() and retries when the copy overlapped an update.
+ */
+static inline void io_stat_write_begin(struct io_stat_t *io_stat)
+{
+        __atomic_store_n(&io_stat->seq, io_stat->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void io_stat_write_end(struct io_stat_t *io_stat)
+{
+        __atomic_store_n(&io_stat->seq, io_stat->seq + 1, __ATOMIC_RELEASE);
+}
+
+void io_stat_read(struct io_stat_t *io_stat, struct io_stat_t *snapshot)
+{
+        unsigned int seq;
+
+        while (1) {
+                seq = __atomic_load_n(&io_stat->seq, __ATOMIC_ACQUIRE);
+                if (seq & 1)
+                        continue;
+                memcpy(snapshot, io_stat, sizeof(struct io_stat_t));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (seq == __atomic_load_n(&io_stat->seq, __ATOMIC_RELAXED))
+                        break;
+        }
+}
+
+/* checks a completed read, the first bad sectors of a worker are printed */
+static int verify_job(struct thread_info_t *t_info, struct io_job *job,
+                      int *nr_checked)
+{
+        struct verify_tail *tail;
+        long long bad_offset;
+        int nr_bad;
+
+        nr_bad = verify_check(job->buf, job->bytes, job->offset, nr_checked,
+                              &bad_offset);
+        if (nr_bad && t_info->io_stat.nr_verify_errors < VERIFY_MAX_REPORTS) {
+                tail = verify_tail(job->buf + (bad_offset - job->offset));
+                fprintf(stderr,
+                        "verify: %d of %zu sectors at %lld bad, sector %lld holds lba %llu generation %u seed %x\n",
+                        nr_bad, job->bytes / VERIFY_SECTOR, job->offset,
+                        bad_offset / VERIFY_SECTOR,
+                        (unsigned long long)tail->lba, tail->generation,
+                        tail->seed);
+        }
+        return nr_bad;
+}
+
 void update_iostat(struct thread_info_t *t_info, struct io_job *job)
 {
         struct io_stat_t *io_stat = &t_info->io_stat;
-        double latency;
+        struct dev_stat *dev_stat;
+        unsigned long long latency;
         unsigned int count;
+        int nr_checked = 0;
+        int nr_bad = 0;
 
-        gettimeofday(&job->stop_time, NULL);
+        /* after stop_time, so the latency leaves the check out */
+        if (verify && job->rw && job->res == (long)job->bytes)
+                nr_bad = verify_job(t_info, job, &nr_checked);
 
-        pthread_spin_lock(&io_stat->stat_lock);
+        io_stat_write_begin(io_stat);
 
-        latency = time_since(&job->start_time, &job->stop_time);
+        latency = job->stop_time > job->start_time ?
+                          job->stop_time - job->start_time :
+                          0;
 
         io_stat->latency_sum += latency;
-        io_stat->latency_sum_sqr += (latency * latency);
+        io_stat->latency_sum_sqr += (double)latency * latency;
 
         if (!io_stat->latency_count) {
                 io_stat->latency_min = latency;
@@ -200,22 +318,55 @@ void update_iostat(struct thread_info_t *t_info, struct io_job *job)
         count = io_stat->latency_count;
 
         io_stat->total_bytes += job->bytes;
+        if (job->res != (long)job->bytes)
+                io_stat->total_error_bytes += job->bytes;
+        io_stat->total_error_bytes += (unsigned long long)nr_bad *
+                                      VERIFY_SECTOR;
+        io_stat->nr_verified += nr_checked;
+        io_stat->nr_verify_errors += nr_bad;
         if (job->rw)
                 io_stat->total_rbytes += job->bytes;
         else
                 io_stat->total_wbytes += job->bytes;
 
-        io_stat->cur_bytes += job->bytes;
+        io_stat_write_end(io_stat);
+
+        latency_hist_record(t_info->lat_hist, latency);
+
+        dev_stat = &t_info->dev_stat[job->dev];
+        if (!dev_stat->nr_ios || latency < dev_stat->latency_min)
+                dev_stat->latency_min = latency;
+        if (latency > dev_stat->latency_max)
+                dev_stat->latency_max = latency;
+        dev_stat->nr_ios++;
+        dev_stat->latency_sum += latency;
+        dev_stat->total_bytes += job->bytes;
         if (job->rw)
-                io_stat->cur_rbytes += job->bytes;
+                dev_stat->total_rbytes += job->bytes;
         else
-                io_stat->cur_wbytes += job->bytes;
-
-        pthread_spin_unlock(&io_stat->stat_lock);
+                dev_stat->total_wbytes += job->bytes;
+        if (job->res != (long)job->bytes)
+                dev_stat->error_bytes += job->bytes;
+
+        if (io_log) {
+                struct io_log_rec rec = {
+                        .submit_ns = job->start_time - start_ns,
+                        .complete_ns = job->stop_time - start_ns,
+                        .offset = job->offset,
+                        .bytes = (uint32_t)job->bytes,
+                        .thread = (uint16_t)t_info->tid,
+                        .dev = (uint16_t)job->dev,
+                        .depth = (uint16_t)job->depth,
+                        .read = job->rw != 0,
+                        .error = job->res != (long)job->bytes || nr_bad,
+                };
+
+                io_log_record(io_log, &rec);
+        }
 
         if (count && t_info->fsync_period &&
             (count % (t_info->fsync_period) == 0)) {
-                fsync(t_info->fd);
+                fsync(t_info->fds[job->dev]);
         }
 }
 
@@ -226,20 +377,111 @@ struct simple_bio {
         int flags;
 };
 
+/*
+ * The per_thread workers of a trace share one ticket counter. Ticket t is
+ * request (t % trace_io_cnt) of repeat (t / trace_io_cnt), so the cursor,
+ * the issue count and the repeat count are all derived from it. A worker
+ * claims a run of arrived requests with a single CAS. The first ticket
+ * that may not be issued closes the trace by lowering trace_ticket_end.
+ */
+static int trace_ticket_allowed(struct trace_info_t *trace,
+                                struct io_stat_t *io_stat, long long ticket)
+{
+        int nr_req = __atomic_load_n(&trace->trace_io_cnt, __ATOMIC_ACQUIRE);
+        long long epoch;
+
+        /* a streamed trace is still in its first pass */
+        if (!nr_req)
+                return trace->stream != NULL;
+        if (trace->timeout == 0.0 && trace->wanted_io_count &&
+            ticket >= trace->wanted_io_count)
+                return 0;
+
+        epoch = ticket / nr_req;
+        if (!epoch)
+                return 1;
+
+        if (trace->timeout)
+                return io_stat->execution_time < trace->timeout * NSEC_PER_SEC;
+        if (trace->wanted_io_count)
+                return 1;
+        return epoch < trace->trace_repeat_num;
+}
+
+static void trace_close(struct trace_info_t *trace, long long ticket)
+{
+        long long end = __atomic_load_n(&trace->trace_ticket_end,
+                                        __ATOMIC_RELAXED);
+
+        while (ticket < end &&
+               !__atomic_compare_exchange_n(&trace->trace_ticket_end, &end,
+                                            ticket, 0, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+                ;
+}
+
+/*
+ * A synthetic request is made up from its ticket into scratch, so a
+ * working set of any size costs no memory and every repeat of rand_*
+ * visits the items in a new order.
+ */
+static struct trace_io_req *synthetic_req(struct trace_info_t *trace,
+                                          long long ticket,
+                                          struct trace_io_req *scratch)
+{
+        long long item;
+
+        if (trace->synth_rand)
+                item = synth_dist_item(trace->synth, ticket);
+        else
+                item = ticket % trace->trace_io_cnt;
+
+        if (trace->arrival)
+                scratch->arrival_time = arrival_time(trace->arrival, ticket);
+        else
+                scratch->arrival_time = (ticket % trace->trace_io_cnt) * 1.0;
+        scratch->devno = 0;
+        scratch->blkno = item * trace->io_pages * SPP;
+        scratch->bcount = trace->io_pages * SPP;
+        if (trace->synth_write)
+                scratch->flags = 0;
+        else if (trace->synth_read)
+                scratch->flags = 1;
+        else
+                scratch->flags = synth_dist_hash(trace->synth, ticket) >> 63;
+
+        return scratch;
+}
+
+static struct trace_io_req *trace_ticket_req(struct trace_info_t *trace,
+                                             long long ticket,
+                                             struct trace_io_req *scratch)
+{
+        if (trace->stream)
+                return &trace->stream->ring[ticket &
+                                            (trace->stream->ring_size - 1)];
+        if (trace->synth)
+                return synthetic_req(trace, ticket, scratch);
+
+        return &trace->trace_buf[ticket % trace->trace_io_cnt];
+}
+
 void trace_reset(struct trace_info_t *trace)
 {
-        trace->trace_io_cur = 0;
+        __atomic_store_n(&trace->trace_ticket, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&trace->lag_shift, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&trace->lag_next, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&trace->trace_ticket_end, LLONG_MAX,
+                         __ATOMIC_RELEASE);
 }
 
 int trace_set_eof(struct trace_info_t *trace)
 {
         int res = 0;
 
-        pthread_spin_lock(&trace->trace_lock);
-        trace->trace_io_cur = trace->trace_io_cnt;
-        trace->trace_io_issue_count = trace->wanted_io_count;
+        trace_close(trace, __atomic_load_n(&trace->trace_ticket,
+                                           __ATOMIC_ACQUIRE));
         trace->timeout = 0;
-        pthread_spin_unlock(&trace->trace_lock);
 
         printf(" set eof ... \n");
         return res;
@@ -249,71 +491,124 @@ int trace_eof(struct trace_info_t *trace)
 {
         int res = 0;
 
-        pthread_spin_lock(&trace->trace_lock);
-        if (trace->trace_io_cnt && trace->trace_io_cur >= trace->trace_io_cnt) {
-                res = 1;
-        }
-        if (trace->wanted_io_count &&
-            trace->trace_io_issue_count >= trace->wanted_io_count) {
+        if (__atomic_load_n(&trace->trace_ticket, __ATOMIC_ACQUIRE) >=
+            __atomic_load_n(&trace->trace_ticket_end, __ATOMIC_ACQUIRE))
                 res = 1;
-        }
-        pthread_spin_unlock(&trace->trace_lock);
 
         if (res)
                 printf(" eof ... \n");
         return res;
 }
 
-int try_trace_reset(struct trace_info_t *trace, struct io_stat_t *io_stat)
+long long trace_issued(struct trace_info_t *trace)
 {
-        int res = 0;
-        if (trace->timeout && io_stat->execution_time < trace->timeout) {
-                trace->trace_repeat_count++;
-                trace_reset(trace);
-                synthetic_mix(trace);
-        } else if (trace->wanted_io_count &&
-                   trace->trace_io_issue_count < trace->wanted_io_count) {
-                trace->trace_repeat_count++;
-                trace_reset(trace);
-                synthetic_mix(trace);
-        } else if (trace->trace_repeat_num &&
-                   trace->trace_repeat_count < trace->trace_repeat_num) {
-                trace->trace_repeat_count++;
-                trace_reset(trace);
-                synthetic_mix(trace);
-        } else {
-                res = -1;
+        long long ticket =
+                __atomic_load_n(&trace->trace_ticket, __ATOMIC_RELAXED);
+        long long end =
+                __atomic_load_n(&trace->trace_ticket_end, __ATOMIC_RELAXED);
+
+        return ticket < end ? ticket : end;
+}
+
+int trace_repeat_count(struct trace_info_t *trace)
+{
+        long long issued = trace_issued(trace);
+
+        if (!issued || !trace->trace_io_cnt)
+                return 1;
+        return (int)((issued - 1) / trace->trace_io_cnt) + 1;
+}
+
+/*
+ * Claims up to max consecutive tickets whose requests have arrived by now
+ * (in ns since start_ns). Returns the number claimed, the first one in
+ * *ticket. Zero means nothing has arrived yet or the trace is closed.
+ */
+int trace_io_claim(struct trace_info_t *trace, struct io_stat_t *io_stat,
+                   long long now, int max, long long *ticket)
+{
+        long long t, end;
+        int n;
+
+        t = __atomic_load_n(&trace->trace_ticket, __ATOMIC_ACQUIRE);
+        while (1) {
+                end = __atomic_load_n(&trace->trace_ticket_end,
+                                      __ATOMIC_ACQUIRE);
+
+                for (n = 0; n < max && t + n < end; n++) {
+                        struct trace_io_req *io, scratch;
+
+                        if (trace->stream) {
+                                int ready = trace_stream_ready(trace->stream,
+                                                               t + n);
+                                if (ready < 0)
+                                        trace_close(trace, t + n);
+                                if (ready <= 0)
+                                        break;
+                        }
+                        if (!trace_ticket_allowed(trace, io_stat, t + n)) {
+                                trace_close(trace, t + n);
+                                break;
+                        }
+
+                        // generated by Eunjae
+                        io = trace_ticket_req(trace, t + n, &scratch);
+                        if (now < trace_arrival_ns(trace, io, t + n))
+                                break;
+                }
+                if (!n)
+                        return 0;
+
+                if (__atomic_compare_exchange_n(&trace->trace_ticket, &t,
+                                                t + n, 1, __ATOMIC_ACQ_REL,
+                                                __ATOMIC_ACQUIRE))
+                        break;
         }
 
-        return res;
+        *ticket = t;
+        return n;
 }
 
-int trace_io_get(double *arrival_time, int *devno, int *blkno, int *bcount,
-                 int *flags, struct trace_info_t *trace,
-                 struct io_stat_t *io_stat)
+/* trace_next_req() which also gives the ticket of the request */
+static struct trace_io_req *trace_next_ticket_req(struct trace_info_t *trace,
+                                                  struct trace_io_req *scratch,
+                                                  long long *ticket)
 {
-        struct trace_io_req *io;
+        long long t = __atomic_load_n(&trace->trace_ticket, __ATOMIC_ACQUIRE);
 
-        int res = 0;
+        if (t >= __atomic_load_n(&trace->trace_ticket_end, __ATOMIC_ACQUIRE))
+                return NULL;
+        if (trace->stream ? trace_stream_ready(trace->stream, t) <= 0 :
+                            !trace->trace_io_cnt)
+                return NULL;
+        *ticket = t;
+        return trace_ticket_req(trace, t, scratch);
+}
 
-        io = &(trace->trace_buf[trace->trace_io_cur]);
+/*
+ * The request the next claim would start with, NULL once closed. A
+ * synthetic one is made up in scratch.
+ */
+struct trace_io_req *trace_next_req(struct trace_info_t *trace,
+                                    struct trace_io_req *scratch)
+{
+        long long ticket;
+
+        return trace_next_ticket_req(trace, scratch, &ticket);
+}
+
+void trace_io_get(double *arrival_time, int *devno, long long *blkno,
+                  int *bcount, int *flags, struct trace_info_t *trace,
+                  long long ticket)
+{
+        struct trace_io_req scratch;
+        struct trace_io_req *io = trace_ticket_req(trace, ticket, &scratch);
 
         *arrival_time = io->arrival_time;
         *devno = io->devno;
         *bcount = io->bcount;
         *blkno = io->blkno;
         *flags = io->flags;
-        trace->trace_io_cur++;
-        trace->trace_io_issue_count++;
-
-        if (trace->timeout == 0.0 && trace->wanted_io_count &&
-            trace->trace_io_issue_count >= trace->wanted_io_count) {
-                res = try_trace_reset(trace, io_stat);
-        } else if (trace->trace_io_cur >= trace->trace_io_cnt) {
-                res = try_trace_reset(trace, io_stat);
-        }
-
-        return res;
 }
 
 static void io_done(io_context_t ctx, struct iocb *iocb, long res, long res2)
@@ -322,44 +617,174 @@ static void io_done(io_context_t ctx, struct iocb *iocb, long res, long res2)
         printf("io_done\n");
 }
 
+/*
+ * LAG_RATE: takes up to want catch-up slots of 1/lag_rate s each. At most
+ * one slot of credit is kept, so an idle trace does not burst afterwards.
+ */
+static int lag_rate_take(struct trace_info_t *trace, long long now, int want)
+{
+        long long interval = NSEC_PER_SEC / lag_rate;
+        long long next, base, n;
+
+        next = __atomic_load_n(&trace->lag_next, __ATOMIC_RELAXED);
+        do {
+                base = next > now - interval ? next : now - interval;
+                if (base > now)
+                        return 0;
+                n = (now - base) / interval + 1;
+                if (n > want)
+                        n = want;
+        } while (!__atomic_compare_exchange_n(&trace->lag_next, &next,
+                                              base + n * interval, 1,
+                                              __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED));
+
+        return (int)n;
+}
+
+/*
+ * Sleeps until both the bucket of the worker and the one of its trace let
+ * a request go, and returns the new now. The time is kept apart from the
+ * latencies, which start at the submission.
+ */
+static long long rate_wait(struct thread_info_t *t_info, long long now)
+{
+        struct trace_info_t *trace = t_info->trace;
+        struct io_stat_t *io_stat = &t_info->io_stat;
+        long long delay, waited;
+
+        delay = rate_limit_delay(trace->rate_limit, now);
+        waited = rate_limit_delay(t_info->rate_limit, now);
+        if (waited > delay)
+                delay = waited;
+        if (!delay)
+                return now;
+
+        nstime_sleep_until(start_ns + now + delay,
+                           (unsigned long long)pace_spin_us * NSEC_PER_USEC);
+        waited = (long long)(nstime_now() - start_ns) - now;
+
+        io_stat_write_begin(io_stat);
+        io_stat->token_wait += waited;
+        io_stat->nr_token_waits++;
+        io_stat_write_end(io_stat);
+        return now + waited;
+}
+
+/* takes up to want requests from both buckets */
+static int rate_take(struct thread_info_t *t_info, long long now, int want)
+{
+        struct trace_info_t *trace = t_info->trace;
+        int n, m;
+
+        n = rate_limit_take(t_info->rate_limit, now, want);
+        m = rate_limit_take(trace->rate_limit, now, n);
+        rate_limit_done(t_info->rate_limit, now, n - m, 0);
+        return m;
+}
+
+/* the first entry of trace->devs on the device of entry i */
+static int trace_dev_first(const struct trace_info_t *trace, int i)
+{
+        int j;
+
+        for (j = 0; j < i; j++)
+                if (trace->devs[j].dev == trace->devs[i].dev)
+                        return j;
+        return i;
+}
+
+/* the device of the trace for devno, the default one when it is not mapped */
+static inline int trace_dev_index(const struct trace_info_t *trace, int devno)
+{
+        int i;
+
+        for (i = 1; i < trace->nr_devs; i++)
+                if (trace->devs[i].devno == devno)
+                        return i;
+        return 0;
+}
+
 int make_jobs(struct thread_info_t *t_info, struct iocb **ioq,
               struct io_job **jobq, int depth)
 {
         struct io_job *job;
         double arrival_time;
         int devno;
-        int blkno;
+        long long blkno;
         int bcount;
         int flags;
         struct io_stat_t *io_stat = &t_info->io_stat;
+        struct trace_info_t *trace = t_info->trace;
+        struct trace_io_req *io, scratch;
+        long long now, late, shift, next;
+        unsigned long long time_diff = 0, lag = 0;
+        unsigned int nr_dropped = 0, nr_shifted = 0;
+        long long lag_threshold = (long long)lag_threshold_us * NSEC_PER_USEC;
+        int paced = trace->trace_timescale > 0.0;
+        int limited = trace->rate_limit || t_info->rate_limit;
+        long long bytes = 0;
+        int taken = 0;
+        long long ticket;
+        int nr_claimed;
         int cnt = 0;
+        int dev;
+        int i;
 
-        for (; cnt < depth; cnt++) {
-                struct trace_info_t *trace = t_info->trace;
-                struct timeval tv_now;
-                double now, tmp;
-                struct trace_io_req *io;
-
-                gettimeofday(&tv_now, NULL);
-                now = time_since_ms(&tv_start2, &tv_now);
+        /* one timestamp for the whole batch */
+        now = (long long)(nstime_now() - start_ns);
+        shift = __atomic_load_n(&trace->lag_shift, __ATOMIC_RELAXED);
 
-                pthread_spin_lock(&trace->trace_lock);
-                io = &(trace->trace_buf[trace->trace_io_cur]);
+        if (limited) {
+                now = rate_wait(t_info, now);
+                depth = taken = rate_take(t_info, now, depth);
+        }
 
-                // generated by Eunjae
-                if (now < io->arrival_time * trace->trace_timescale) {
-                        pthread_spin_unlock(&trace->trace_lock);
-                        return cnt;
-                }
-                if (trace_io_get(&arrival_time, &devno, &blkno, &bcount, &flags,
-                                 t_info->trace, io_stat)) {
-                        pthread_spin_unlock(&trace->trace_lock);
-                        return cnt;
+        /* a late trace catches up at lag_rate at most */
+        if (paced && lag_policy == LAG_RATE &&
+            (io = trace_next_ticket_req(trace, &scratch, &next)) != NULL &&
+            now - trace_arrival_ns(trace, io, next) > lag_threshold)
+                depth = lag_rate_take(trace, now, depth);
+
+        nr_claimed = depth ? trace_io_claim(trace, io_stat, now, depth,
+                                            &ticket) :
+                             0;
+        if (!nr_claimed && depth && trace->stream)
+                trace_stream_wait(trace->stream,
+                                  __atomic_load_n(&trace->trace_ticket,
+                                                  __ATOMIC_RELAXED));
+
+        for (i = 0; i < nr_claimed; i++) {
+                trace_io_get(&arrival_time, &devno, &blkno, &bcount, &flags,
+                             trace, ticket + i);
+
+                late = now -
+                       (long long)(trace_arrival_ms(trace, arrival_time,
+                                                    ticket + i) *
+                                   trace->trace_timescale * NSEC_PER_MSEC) -
+                       shift;
+                if (paced && late > lag_threshold) {
+                        if (lag_policy == LAG_DROP) {
+                                nr_dropped++;
+                                continue;
+                        }
+                        /* re-base the timeline unless another worker did */
+                        if (lag_policy == LAG_SHIFT &&
+                            __atomic_compare_exchange_n(
+                                    &trace->lag_shift, &shift, shift + late,
+                                    0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                                shift += late;
+                                nr_shifted++;
+                        }
                 }
-                pthread_spin_unlock(&trace->trace_lock);
-
-                job = (struct io_job *)malloc(sizeof(struct io_job));
-                align_sector(t_info, &blkno, &bcount);
+                /* an unpaced trace is never late */
+                if (paced && late > 0 && (unsigned long long)late > lag)
+                        lag = late;
+
+                job = io_pool_get_job(t_info->pool);
+                dev = trace_dev_index(trace, devno);
+                align_sector(trace->devs[dev].total_pages, &blkno, &bcount);
+                job->dev = dev;
                 job->offset = (long long)blkno * SECTOR_SIZE;
                 job->bytes = (size_t)bcount * SECTOR_SIZE;
                 if (job->bytes > (size_t)MAX_BYTES)
@@ -370,110 +795,308 @@ int make_jobs(struct thread_info_t *t_info, struct iocb **ioq,
                 else
                         job->rw = 0;
 
-                job->buf = allocate_aligned_buffer(job->bytes);
+                job->buf = io_pool_get_buf(t_info->pool, job->bytes,
+                                           &job->buf_class);
+                if (job->buf == NULL)
+                        job->buf = allocate_aligned_buffer(job->bytes);
+                if (!job->rw && t_info->payload)
+                        payload_fill(t_info->payload, job->buf, job->bytes);
+
+                job->offset += trace->devs[dev].start_partition;
+                if (!job->rw && verify)
+                        verify_stamp(job->buf, job->bytes, job->offset,
+                                     t_info->verify_generation++,
+                                     verify_seed);
+                ioq[cnt] = &job->iocb;
+                jobq[cnt++] = job;
+                bytes += job->bytes;
 
-                gettimeofday(&job->start_time, NULL);
+                job->due_time = paced ? start_ns + now - late : 0;
+                time_diff += late > 0 ? late : -late;
 
-                job->offset += trace->start_partition;
-                ioq[cnt] = &job->iocb;
-                jobq[cnt] = job;
-
-                gettimeofday(&tv_now, NULL);
-                now = time_since_ms(&tv_start2, &tv_now);
-                tmp = now - arrival_time * trace->trace_timescale;
-                tmp = (tmp > 0) ? tmp : tmp * (-1.0);
-                pthread_spin_lock(&io_stat->stat_lock);
-                io_stat->time_diff += tmp;
-                io_stat->time_diff_cnt++;
-                pthread_spin_unlock(&io_stat->stat_lock);
+                /* io_uring prepares its SQEs at submission time */
+                if (t_info->engine != IO_ENGINE_LIBAIO)
+                        continue;
 #ifndef USE_RAND_BUF
                 if (job->rw)
-                        io_prep_pread(&job->iocb, t_info->fd, job->buf,
+                        io_prep_pread(&job->iocb, t_info->fds[dev], job->buf,
                                       job->bytes, job->offset);
                 else
-                        io_prep_pwrite(&job->iocb, t_info->fd, job->buf,
+                        io_prep_pwrite(&job->iocb, t_info->fds[dev], job->buf,
                                        job->bytes, job->offset);
 #else
                 if (job->rw)
-                        io_prep_pread(&job->iocb, t_info->fd, g_buf, job->bytes,
-                                      job->offset);
+                        io_prep_pread(&job->iocb, t_info->fds[dev], g_buf,
+                                      job->bytes, job->offset);
                 else
-                        io_prep_pwrite(&job->iocb, t_info->fd, g_buf,
+                        io_prep_pwrite(&job->iocb, t_info->fds[dev], g_buf,
                                        job->bytes, job->offset);
 
 #endif
                 io_set_callback(&job->iocb, io_done);
+                if (t_info->efd >= 0)
+                        io_set_eventfd(&job->iocb, t_info->efd);
+        }
+
+        if (nr_claimed) {
+                io_stat_write_begin(io_stat);
+                io_stat->time_diff += time_diff;
+                io_stat->time_diff_cnt += cnt;
+                io_stat->lag = lag;
+                if (lag > io_stat->lag_max)
+                        io_stat->lag_max = lag;
+                io_stat->nr_lag_dropped += nr_dropped;
+                io_stat->nr_lag_shifted += nr_shifted;
+                io_stat_write_end(io_stat);
+        }
+
+        if (limited) {
+                rate_limit_done(t_info->rate_limit, now, taken - cnt, bytes);
+                rate_limit_done(trace->rate_limit, now, taken - cnt, bytes);
         }
 
+        /* every claimed request has been copied into its job */
+        if (trace->stream && nr_claimed)
+                trace_stream_release(trace->stream, ticket, nr_claimed);
+
         return cnt;
 }
 
+/* the nstime_now() at which the next request is due, 0 without one */
+unsigned long long next_arrival(struct trace_info_t *trace)
+{
+        long long lag_threshold = (long long)lag_threshold_us * NSEC_PER_USEC;
+        struct trace_io_req scratch;
+        struct trace_io_req *io;
+        long long deadline, ticket;
+
+        io = trace_next_ticket_req(trace, &scratch, &ticket);
+        if (io == NULL)
+                return 0;
+
+        deadline = trace_arrival_ns(trace, io, ticket);
+        /* a late trace waits for its next catch-up slot */
+        if (lag_policy == LAG_RATE && trace->trace_timescale > 0.0 &&
+            (long long)(nstime_now() - start_ns) - deadline > lag_threshold)
+                deadline = __atomic_load_n(&trace->lag_next, __ATOMIC_RELAXED);
+        if (trace->timeout > 0.0 &&
+            deadline > (long long)(trace->timeout * NSEC_PER_SEC))
+                deadline = (long long)(trace->timeout * NSEC_PER_SEC);
+        return deadline > 0 ? start_ns + deadline : start_ns;
+}
+
 // generated by Eunjae
 void wait_arrive(struct thread_info_t *t_info)
 {
-        struct timeval tv_now;
-        double now;
-        double sleep_ms;
-        struct trace_io_req *io;
+        unsigned long long deadline;
 
-        struct trace_info_t *trace = t_info->trace;
+        /* another worker may claim the request while this one sleeps */
+        while ((deadline = next_arrival(t_info->trace)) > nstime_now())
+                nstime_sleep_until(deadline, (unsigned long long)pace_spin_us *
+                                                     NSEC_PER_USEC);
+}
 
-        gettimeofday(&tv_now, NULL);
-        now = time_since_ms(&tv_start2, &tv_now);
+void release_job(struct thread_info_t *t_info, struct io_job *job)
+{
+        if (job->buf_class >= 0)
+                io_pool_put_buf(t_info->pool, job->buf, job->buf_class);
+        else
+                free(job->buf);
+        io_pool_put_job(t_info->pool, job);
+}
 
-        pthread_spin_lock(&trace->trace_lock);
-        io = &(trace->trace_buf[trace->trace_io_cur]);
+int submit_jobs(struct thread_info_t *t_info, struct iocb **ioq,
+                struct io_job **jobq, int cnt)
+{
+        struct io_stat_t *io_stat = &t_info->io_stat;
+        unsigned long long now = nstime_now();
+        unsigned long long delay, queue_delay = 0;
+        int nr_paced = 0;
+        int i;
 
-        if (trace->timeout > 0.0) {
-                sleep_ms = io->arrival_time * trace->trace_timescale - now;
-                if (sleep_ms > trace->timeout * 1000 - now) {
-                        sleep_ms = trace->timeout * 1000 - now;
-                }
-        } else {
-                sleep_ms = io->arrival_time * trace->trace_timescale - now;
+        for (i = 0; i < cnt; i++) {
+                jobq[i]->start_time = now;
+                jobq[i]->depth = t_info->queue_count + i + 1;
+                if (!jobq[i]->due_time)
+                        continue;
+                delay = now > jobq[i]->due_time ? now - jobq[i]->due_time : 0;
+                latency_hist_record(t_info->pace_hist, delay);
+                queue_delay += delay;
+                nr_paced++;
+        }
+        if (nr_paced) {
+                io_stat_write_begin(io_stat);
+                io_stat->queue_delay += queue_delay;
+                io_stat->queue_delay_cnt += nr_paced;
+                io_stat_write_end(io_stat);
         }
 
-        while (sleep_ms > 0) {
-                pthread_spin_unlock(&trace->trace_lock);
-                usleep(sleep_ms * 1000);
-                pthread_spin_lock(&trace->trace_lock);
-                gettimeofday(&tv_now, NULL);
-                now = time_since_ms(&tv_start2, &tv_now);
+        if (t_info->engine == IO_ENGINE_URING)
+                return uring_io_submit(t_info, jobq, cnt);
 
-                if (trace->timeout > 0.0) {
-                        sleep_ms =
-                                io->arrival_time * trace->trace_timescale - now;
-                        if (sleep_ms > trace->timeout * 1000 - now) {
-                                sleep_ms = trace->timeout * 1000 - now;
-                        }
+        return io_submit(t_info->io_ctx, cnt, ioq);
+}
+
+/* waits for at least min completions, returns the number reaped */
+static int reap_jobs(struct thread_info_t *t_info, struct io_job **jobq,
+                     int min, int max)
+{
+        int complete_count;
+        int i;
+
+        if (t_info->engine == IO_ENGINE_URING)
+                return uring_io_reap(t_info, jobq, min, max);
+
+        complete_count = aio_ring_getevents(t_info->io_ctx, t_info->aio_ring,
+                                            min, max, t_info->events);
+        for (i = 0; i < complete_count; i++) {
+                struct io_job *job =
+                        (struct io_job *)((unsigned long)t_info->events[i].obj);
+
+                job->res = (long)t_info->events[i].res;
+                jobq[i] = job;
+        }
+        return complete_count;
+}
+
+/*
+ * Open loop: the worker only dispatches, at the arrival times and with up
+ * to open_loop requests in flight, whatever the device does. A reaper
+ * thread per worker takes the completions off the same context and hands
+ * them back through done_list, so the pool, io_stat and the histograms
+ * keep the worker as their only writer. The completer is the same thread
+ * behind a closed loop worker.
+ */
+
+/* the requests submitted and not reaped yet, 0 once stopped and drained */
+static long long reaper_pending(struct thread_info_t *t_info, long long reaped)
+{
+        long long pending;
+
+        pthread_mutex_lock(&t_info->mutex);
+        while (t_info->nr_submitted == reaped && !t_info->stop)
+                pthread_cond_wait(&t_info->cond_main, &t_info->mutex);
+        pending = t_info->nr_submitted - reaped;
+        pthread_mutex_unlock(&t_info->mutex);
+
+        return pending;
+}
+
+/*
+ * With an eventfd, a completion may be in before the submitter counted its
+ * request, so whatever is there is reaped and the counts only tell when
+ * to stop. Every completion after the ring is found empty bumps the
+ * eventfd, and so does the stop.
+ */
+static int reaper_wait_eventfd(struct thread_info_t *t_info, long long reaped)
+{
+        uint64_t nr;
+        int done;
+
+        pthread_mutex_lock(&t_info->mutex);
+        done = t_info->stop && t_info->nr_submitted == reaped;
+        pthread_mutex_unlock(&t_info->mutex);
+        if (done)
+                return -1;
+
+        if (read(t_info->efd, &nr, sizeof(nr)) < 0 && errno != EINTR)
+                return -1;
+        return 0;
+}
+
+static void *reaper_worker(void *data)
+{
+        struct thread_info_t *t_info = (struct thread_info_t *)data;
+        struct io_job *jobq[MAX_QDEPTH];
+        unsigned long long now;
+        long long reaped = 0;
+        long long pending;
+        int complete_count;
+        int i;
+
+        while (1) {
+                if (t_info->efd >= 0) {
+                        complete_count =
+                                reap_jobs(t_info, jobq, 0, MAX_QDEPTH);
+                        if (!complete_count &&
+                            reaper_wait_eventfd(t_info, reaped))
+                                break;
                 } else {
-                        sleep_ms =
-                                io->arrival_time * trace->trace_timescale - now;
+                        pending = reaper_pending(t_info, reaped);
+                        if (!pending)
+                                break;
+                        complete_count = reap_jobs(
+                                t_info, jobq, 1,
+                                pending < MAX_QDEPTH ? (int)pending :
+                                                       MAX_QDEPTH);
                 }
+                if (complete_count <= 0)
+                        continue;
 
-                io = &(trace->trace_buf[trace->trace_io_cur]);
+                now = nstime_now();
+                pthread_mutex_lock(&t_info->mutex);
+                for (i = 0; i < complete_count; i++) {
+                        jobq[i]->stop_time = now;
+                        flist_add_tail(&jobq[i]->list, &t_info->done_list);
+                }
+                pthread_cond_signal(&t_info->cond_sub);
+                pthread_mutex_unlock(&t_info->mutex);
+                reaped += complete_count;
+        }
+
+        return NULL;
+}
+
+/* accounts the jobs the reaper handed back, waits for one if block */
+static void recycle_jobs(struct thread_info_t *t_info, int block)
+{
+        struct flist_head done;
+        struct flist_head *pos, *n;
+
+        INIT_FLIST_HEAD(&done);
+        pthread_mutex_lock(&t_info->mutex);
+        while (block && flist_empty(&t_info->done_list))
+                pthread_cond_wait(&t_info->cond_sub, &t_info->mutex);
+        flist_splice_init(&t_info->done_list, &done);
+        pthread_mutex_unlock(&t_info->mutex);
+
+        flist_for_each_safe(pos, n, &done)
+        {
+                struct io_job *job = flist_entry(pos, struct io_job, list);
+
+                update_iostat(t_info, job);
+                release_job(t_info, job);
+                t_info->queue_count--;
         }
-        pthread_spin_unlock(&trace->trace_lock);
 }
 
 void wait_completion(struct thread_info_t *t_info, int cnt)
 {
+        struct io_job *jobq[MAX_QDEPTH];
         struct io_job *job;
+        unsigned long long now;
         int i;
 
+        /* the completer reaps, this thread only accounts */
+        if (completer) {
+                recycle_jobs(t_info, 1);
+                return;
+        }
+
         while (1) {
-                int complete_count = io_getevents(t_info->io_ctx, 1, cnt,
-                                                  t_info->events, NULL);
+                int complete_count;
+
+                complete_count = reap_jobs(t_info, jobq, 1, cnt);
                 if (complete_count <= 0) {
                         continue;
                 }
+                /* one timestamp for the whole batch */
+                now = nstime_now();
                 for (i = 0; i < complete_count; i++) {
-                        job = (struct io_job *)((unsigned long)t_info->events[i]
-                                                        .obj);
+                        job = jobq[i];
+                        job->stop_time = now;
                         update_iostat(t_info, job);
-
-                        free(job->buf);
-                        free(job);
+                        release_job(t_info, job);
                 }
                 t_info->queue_count -= complete_count;
                 cnt -= complete_count;
@@ -481,6 +1104,148 @@ void wait_completion(struct thread_info_t *t_info, int cnt)
         }
 }
 
+/* sleeps until the next arrival, accounting the completions meanwhile */
+static void open_loop_wait(struct thread_info_t *t_info)
+{
+        unsigned long long spin_ns =
+                (unsigned long long)pace_spin_us * NSEC_PER_USEC;
+        unsigned long long deadline;
+        struct timespec ts;
+
+        while ((deadline = next_arrival(t_info->trace)) > nstime_now()) {
+                if (!t_info->queue_count ||
+                    deadline <= nstime_now() + spin_ns) {
+                        nstime_sleep_until(deadline, spin_ns);
+                        continue;
+                }
+
+                nstime_monotonic(deadline, spin_ns, &ts);
+                pthread_mutex_lock(&t_info->mutex);
+                if (flist_empty(&t_info->done_list))
+                        pthread_cond_timedwait(&t_info->cond_sub,
+                                               &t_info->mutex, &ts);
+                pthread_mutex_unlock(&t_info->mutex);
+                recycle_jobs(t_info, 0);
+        }
+}
+
+static int timed_out(struct thread_info_t *t_info)
+{
+        struct io_stat_t *io_stat = &t_info->io_stat;
+        struct trace_info_t *trace = t_info->trace;
+
+        io_stat_write_begin(io_stat);
+        io_stat->end_time = nstime_now();
+        io_stat->execution_time = io_stat->end_time - io_stat->start_time;
+        io_stat_write_end(io_stat);
+
+        return trace->timeout > 0.0 &&
+               io_stat->execution_time >=
+                       (unsigned long long)(trace->timeout * NSEC_PER_SEC);
+}
+
+static int reaper_start(struct thread_info_t *t_info)
+{
+        INIT_FLIST_HEAD(&t_info->done_list);
+        t_info->nr_submitted = 0;
+        t_info->stop = 0;
+        if (pthread_create(&t_info->reaper, NULL, reaper_worker, t_info)) {
+                fprintf(stderr, "cannot create the reaper thread\n");
+                return -1;
+        }
+        return 0;
+}
+
+/* tells the reaper about nr more requests in flight */
+static void reaper_submitted(struct thread_info_t *t_info, int nr)
+{
+        pthread_mutex_lock(&t_info->mutex);
+        t_info->nr_submitted += nr;
+        if (t_info->efd < 0)
+                pthread_cond_signal(&t_info->cond_main);
+        pthread_mutex_unlock(&t_info->mutex);
+}
+
+/* accounts whatever is still in flight and joins the reaper */
+static void reaper_stop(struct thread_info_t *t_info)
+{
+        uint64_t one = 1;
+
+        pthread_mutex_lock(&t_info->mutex);
+        t_info->stop = 1;
+        pthread_cond_signal(&t_info->cond_main);
+        pthread_mutex_unlock(&t_info->mutex);
+        if (t_info->efd >= 0 && write(t_info->efd, &one, sizeof(one)) < 0)
+                perror("eventfd");
+
+        while (t_info->queue_count)
+                recycle_jobs(t_info, 1);
+        pthread_join(t_info->reaper, NULL);
+}
+
+static void open_loop_dispatch(struct thread_info_t *t_info)
+{
+        struct trace_info_t *trace = t_info->trace;
+        struct iocb *ioq[MAX_QDEPTH];
+        struct io_job *jobq[MAX_QDEPTH];
+        int limit = open_loop < t_info->queue_depth ? open_loop :
+                                                      t_info->queue_depth;
+        int cnt, rc;
+
+        if (reaper_start(t_info))
+                return;
+
+        while (1) {
+                recycle_jobs(t_info, t_info->queue_count >= limit);
+
+                cnt = 0;
+                if (t_info->queue_count < limit)
+                        cnt = make_jobs(t_info, ioq, jobq,
+                                        limit - t_info->queue_count);
+                if (!cnt && trace_eof(trace))
+                        break;
+
+                if (cnt > 0) {
+                        rc = submit_jobs(t_info, ioq, jobq, cnt);
+                        if (rc != cnt) {
+                                int i;
+                                for (i = (rc > 0) ? rc : 0; i < cnt; i++)
+                                        release_job(t_info, jobq[i]);
+                        }
+                        if (rc > 0) {
+                                t_info->queue_count += rc;
+                                reaper_submitted(t_info, rc);
+                        }
+                } else if (t_info->queue_count < limit) {
+                        open_loop_wait(t_info);
+                }
+
+                if (timed_out(t_info) || trace_eof(trace))
+                        break;
+        }
+
+        reaper_stop(t_info);
+}
+
+/* the workers dispatch the requests, so they get the realtime priority */
+static void set_dispatch_sched(void)
+{
+        struct sched_param param;
+        int rc;
+
+        /* the default 50us slack would delay every paced wakeup */
+        prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+        if (!sched_fifo_prio)
+                return;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched_fifo_prio;
+        rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc)
+                fprintf(stderr, "SCHED_FIFO %d: %s\n", sched_fifo_prio,
+                        strerror(rc));
+}
+
 void *sub_worker(void *threadid)
 {
         long tid = (long)threadid;
@@ -493,7 +1258,15 @@ void *sub_worker(void *threadid)
         int iter = 0;
         int cnt = 0;
 
-        gettimeofday(&io_stat->start_time, NULL);
+        set_dispatch_sched();
+        io_stat->start_time = nstime_now();
+
+        if (open_loop) {
+                open_loop_dispatch(t_info);
+                goto Finish;
+        }
+        if (completer && reaper_start(t_info))
+                goto Finish;
 
         while (1) {
                 int max = t_info->queue_depth - t_info->queue_count;
@@ -512,50 +1285,42 @@ void *sub_worker(void *threadid)
                 if (!cnt && trace_eof(trace)) {
                         goto Timeout;
                 } else if (cnt > 0) {
-                        rc = io_submit(t_info->io_ctx, cnt, ioq);
-                        if (rc != cnt && rc < 0) {
+                        rc = submit_jobs(t_info, ioq, jobq, cnt);
+                        if (rc != cnt) {
                                 int i;
-                                for (i = 0; i < cnt; i++) {
-                                        free(jobq[i]->buf);
-                                        free(jobq[i]);
-                                }
+                                for (i = (rc > 0) ? rc : 0; i < cnt; i++)
+                                        release_job(t_info, jobq[i]);
                         }
-                        if (rc > 0)
+                        if (rc > 0) {
                                 t_info->queue_count += rc;
+                                if (completer)
+                                        reaper_submitted(t_info, rc);
+                        }
                 }
 
                 if (t_info->queue_count) {
                         wait_completion(t_info, t_info->queue_count);
                         if (t_info->queue_count == 0)
                                 wait_arrive(t_info);
+                } else if (!cnt) {
+                        /* not arrived yet, or another worker claimed it */
+                        wait_arrive(t_info);
                 }
-                gettimeofday(&io_stat->end_time, NULL);
-                io_stat->execution_time =
-                        time_since(&io_stat->start_time, &io_stat->end_time);
-                if (io_stat->execution_time > (trace->timeout - FLT_EPSILON) &&
-                    trace->timeout > 0.0) {
+                if (timed_out(t_info))
                         goto Timeout;
-                }
-                if (trace->timeout &&
-                    io_stat->execution_time > (trace->timeout - FLT_EPSILON)) {
+                if (trace_eof(trace))
                         goto Timeout;
-                }
-                pthread_spin_lock(&trace->trace_lock);
-                if (trace->trace_io_cur >= trace->trace_io_cnt) {
-                        if (try_trace_reset(trace, io_stat)) {
-                                pthread_spin_unlock(&trace->trace_lock);
-                                goto Timeout;
-                        }
-                }
-                pthread_spin_unlock(&trace->trace_lock);
         }
 Timeout:
+        if (completer)
+                reaper_stop(t_info);
         while (t_info->queue_count)
                 wait_completion(t_info, t_info->queue_count);
-
-        gettimeofday(&io_stat->end_time, NULL);
-        io_stat->execution_time =
-                time_since(&io_stat->start_time, &io_stat->end_time);
+Finish:
+        io_stat_write_begin(io_stat);
+        io_stat->end_time = nstime_now();
+        io_stat->execution_time = io_stat->end_time - io_stat->start_time;
+        io_stat_write_end(io_stat);
 
         pthread_mutex_lock(&t_info->mutex);
         t_info->done = 1;
@@ -564,28 +1329,164 @@ Timeout:
         return NULL;
 }
 
+/* a worker starts on the cpus of its trace, and so does its reaper */
+static int create_worker(pthread_t *thread, struct trace_info_t *trace,
+                         long tid)
+{
+        pthread_attr_t attr;
+        cpu_set_t set;
+        int rc;
+
+        if (!trace->cpus[0])
+                return pthread_create(thread, NULL, sub_worker, (void *)tid);
+
+        pthread_attr_init(&attr);
+        affinity_parse(trace->cpus, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        rc = pthread_create(thread, &attr, sub_worker, (void *)tid);
+        pthread_attr_destroy(&attr);
+        return rc;
+}
+
+static void set_percentiles(struct trace_stat *stats,
+                            const struct latency_hist *hist)
+{
+        stats->lat_p50 =
+                (double)latency_hist_percentile(hist, 50.0) / NSEC_PER_SEC;
+        stats->lat_p99 =
+                (double)latency_hist_percentile(hist, 99.0) / NSEC_PER_SEC;
+        stats->lat_p999 =
+                (double)latency_hist_percentile(hist, 99.9) / NSEC_PER_SEC;
+        stats->lat_p9999 =
+                (double)latency_hist_percentile(hist, 99.99) / NSEC_PER_SEC;
+}
+
+static void set_pace_percentiles(struct trace_stat *stats,
+                                 const struct latency_hist *hist)
+{
+        stats->pace_err_p50 =
+                (double)latency_hist_percentile(hist, 50.0) / NSEC_PER_SEC;
+        stats->pace_err_p99 =
+                (double)latency_hist_percentile(hist, 99.0) / NSEC_PER_SEC;
+        stats->pace_err_p999 =
+                (double)latency_hist_percentile(hist, 99.9) / NSEC_PER_SEC;
+        stats->pace_err_p9999 =
+                (double)latency_hist_percentile(hist, 99.99) / NSEC_PER_SEC;
+}
+
+/* the requests of all workers by the device they went to */
+static void set_dev_results(double exec_time)
+{
+        struct dev_stat devs[MAX_DEVS];
+        struct dev_stat *src, *dst;
+        struct trace_stat *stats;
+        int t, k, d;
+
+        memset(devs, 0x00, sizeof(devs));
+        for (t = 0; t < nr_thread; t++) {
+                struct trace_info_t *trace = th_info[t].trace;
+
+                for (k = 0; k < trace->nr_devs; k++) {
+                        src = &th_info[t].dev_stat[k];
+                        dst = &devs[trace->devs[k].dev];
+                        if (!src->nr_ios)
+                                continue;
+                        if (!dst->nr_ios || src->latency_min < dst->latency_min)
+                                dst->latency_min = src->latency_min;
+                        if (src->latency_max > dst->latency_max)
+                                dst->latency_max = src->latency_max;
+                        dst->nr_ios += src->nr_ios;
+                        dst->latency_sum += src->latency_sum;
+                        dst->total_bytes += src->total_bytes;
+                        dst->total_rbytes += src->total_rbytes;
+                        dst->total_wbytes += src->total_wbytes;
+                        dst->error_bytes += src->error_bytes;
+                }
+        }
+
+        for (d = 0; d < nr_dev; d++) {
+                dst = &devs[d];
+                stats = &total_results.results.per_dev[d].stats;
+                strcpy(total_results.results.per_dev[d].name,
+                       replay_devs[d].path);
+
+                stats->exec_time = exec_time;
+                stats->avg_lat = dst->nr_ios ? (double)dst->latency_sum /
+                                                       dst->nr_ios /
+                                                       NSEC_PER_SEC :
+                                               0;
+                stats->lat_min = (double)dst->latency_min / NSEC_PER_SEC;
+                stats->lat_max = (double)dst->latency_max / NSEC_PER_SEC;
+                stats->iops = exec_time ? dst->nr_ios / exec_time : 0;
+                stats->total_bw =
+                        exec_time ? (double)dst->total_bytes / MB / exec_time :
+                                    0;
+                stats->read_bw =
+                        exec_time ? (double)dst->total_rbytes / MB / exec_time :
+                                    0;
+                stats->write_bw =
+                        exec_time ? (double)dst->total_wbytes / MB / exec_time :
+                                    0;
+                stats->total_traffic = (double)dst->total_bytes / MB;
+                stats->read_traffic = (double)dst->total_rbytes / MB;
+                stats->write_traffic = (double)dst->total_wbytes / MB;
+                stats->error_traffic = (double)dst->error_bytes / MB;
+                stats->read_ratio = dst->total_bytes ?
+                                            (double)dst->total_rbytes /
+                                                    dst->total_bytes :
+                                            0;
+                stats->total_avg_req_size =
+                        dst->nr_ios ?
+                                (double)dst->total_bytes / dst->nr_ios / KB :
+                                0;
+                stats->read_avg_req_size =
+                        dst->nr_ios ?
+                                (double)dst->total_rbytes / dst->nr_ios / KB :
+                                0;
+                stats->write_avg_req_size =
+                        dst->nr_ios ?
+                                (double)dst->total_wbytes / dst->nr_ios / KB :
+                                0;
+        }
+}
+
 void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
 {
+        /* too large for the stack, only the main worker prints results */
+        static struct latency_hist trace_hist, total_hist;
+        static struct latency_hist trace_pace, total_pace;
         struct io_stat_t total_stat;
         struct realtime_msg rmsg;
         int i, j;
         int per_thread = nr_thread / nr_trace;
+        unsigned long long now_us = (nstime_now() - start_ns) / 1000;
         double progress_percent = 0.0;
+        long long total_lag_shift = 0;
         key_t server_qkey;
         int server_qid;
 
         memset(&total_stat, 0x00, sizeof(struct io_stat_t));
+        if (detail) {
+                latency_hist_reset(&total_hist);
+                latency_hist_reset(&total_pace);
+        }
         for (i = 0; i < nr_trace; i++) {
                 struct io_stat_t io_stat_dst;
                 struct trace_info_t *trace = &traces[i];
                 memset(&io_stat_dst, 0x00, sizeof(struct io_stat_t));
+                if (detail || hist_log)
+                        latency_hist_reset(&trace_hist);
+                if (detail)
+                        latency_hist_reset(&trace_pace);
 
                 for (j = 0; j < per_thread; j++) {
                         int th_num = i * per_thread + j;
-                        struct io_stat_t *io_stat_src =
-                                &th_info[th_num].io_stat;
+                        struct io_stat_t snapshot;
+                        struct io_stat_t *io_stat_src = &snapshot;
+                        struct io_stat_t *io_stat_last =
+                                &th_info[th_num].io_stat_last;
 
-                        pthread_spin_lock(&io_stat_src->stat_lock);
+                        io_stat_read(&th_info[th_num].io_stat, &snapshot);
 
                         io_stat_dst.latency_sum += io_stat_src->latency_sum;
                         io_stat_dst.latency_sum_sqr +=
@@ -613,34 +1514,66 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                         io_stat_dst.total_bytes += io_stat_src->total_bytes;
                         io_stat_dst.total_rbytes += io_stat_src->total_rbytes;
                         io_stat_dst.total_wbytes += io_stat_src->total_wbytes;
-                        io_stat_dst.cur_bytes += io_stat_src->cur_bytes;
-                        io_stat_dst.cur_rbytes += io_stat_src->cur_rbytes;
-                        io_stat_dst.cur_wbytes += io_stat_src->cur_wbytes;
+                        /* the interval is the delta from the last report */
+                        io_stat_dst.cur_bytes += io_stat_src->total_bytes -
+                                                 io_stat_last->total_bytes;
+                        io_stat_dst.cur_rbytes += io_stat_src->total_rbytes -
+                                                  io_stat_last->total_rbytes;
+                        io_stat_dst.cur_wbytes += io_stat_src->total_wbytes -
+                                                  io_stat_last->total_wbytes;
                         io_stat_dst.time_diff += io_stat_src->time_diff;
                         io_stat_dst.time_diff_cnt += io_stat_src->time_diff_cnt;
-
-                        io_stat_src->cur_bytes = 0;
-                        io_stat_src->cur_rbytes = 0;
-                        io_stat_src->cur_wbytes = 0;
+                        io_stat_dst.queue_delay += io_stat_src->queue_delay;
+                        io_stat_dst.queue_delay_cnt +=
+                                io_stat_src->queue_delay_cnt;
+                        if (io_stat_src->lag > io_stat_dst.lag)
+                                io_stat_dst.lag = io_stat_src->lag;
+                        if (io_stat_src->lag_max > io_stat_dst.lag_max)
+                                io_stat_dst.lag_max = io_stat_src->lag_max;
+                        io_stat_dst.nr_lag_dropped +=
+                                io_stat_src->nr_lag_dropped;
+                        io_stat_dst.nr_lag_shifted +=
+                                io_stat_src->nr_lag_shifted;
+                        io_stat_dst.nr_verified += io_stat_src->nr_verified;
+                        io_stat_dst.token_wait += io_stat_src->token_wait;
+                        io_stat_dst.nr_token_waits +=
+                                io_stat_src->nr_token_waits;
+                        io_stat_dst.nr_verify_errors +=
+                                io_stat_src->nr_verify_errors;
+
+                        memcpy(io_stat_last, io_stat_src,
+                               sizeof(struct io_stat_t));
 
                         io_stat_dst.total_error_bytes +=
                                 io_stat_src->total_error_bytes;
                         io_stat_dst.execution_time +=
                                 io_stat_src->execution_time;
-                        pthread_spin_unlock(&io_stat_src->stat_lock);
+
+                        if (detail || hist_log)
+                                latency_hist_merge(&trace_hist,
+                                                   th_info[th_num].lat_hist);
+                        if (detail)
+                                latency_hist_merge(&trace_pace,
+                                                   th_info[th_num].pace_hist);
                 }
 
+                /* one record per trace and interval, whatever the IOPS */
+                if (hist_log &&
+                    hist_log_append(hist_log, i, now_us, &trace_hist))
+                        fprintf(stderr, " cannot append to the hist log\n");
+
                 if (detail) {
                         double sum_sqr;
                         double mean;
                         double variance;
+                        double exec_time;
 
                         sprintf(total_results.results.per_trace[i].name, "%s",
                                 traces[i].tracename);
-                        io_stat_dst.execution_time =
-                                io_stat_dst.execution_time / per_thread;
+                        exec_time = (double)io_stat_dst.execution_time /
+                                    per_thread / NSEC_PER_SEC;
                         total_results.results.per_trace[i].stats.exec_time =
-                                io_stat_dst.execution_time;
+                                exec_time;
                         total_results.results.per_trace[i].issynthetic =
                                 traces[i].synthetic;
 
@@ -658,6 +1591,12 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                                 total_results.results.per_trace[i]
                                         .synthetic.io_size =
                                         traces[i].io_size / KB;
+                                sprintf(total_results.results.per_trace[i]
+                                                .synthetic.distribution,
+                                        "%s", traces[i].synth_skew);
+                                sprintf(total_results.results.per_trace[i]
+                                                .synthetic.arrival,
+                                        "%s", traces[i].synth_arrival);
                         }
 
                         mean = (double)io_stat_dst.latency_sum /
@@ -666,33 +1605,73 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                         variance = (sum_sqr - io_stat_dst.latency_sum * mean) /
                                    (io_stat_dst.latency_count - 1);
 
-                        total_results.results.per_trace[i].stats.avg_lat = mean;
+                        /* the results stay in seconds */
+                        total_results.results.per_trace[i].stats.avg_lat =
+                                mean / NSEC_PER_SEC;
                         total_results.results.per_trace[i].stats.avg_lat_var =
-                                variance;
+                                variance / NSEC_PER_SEC / NSEC_PER_SEC;
                         total_results.results.per_trace[i].stats.lat_min =
-                                io_stat_dst.latency_min;
+                                (double)io_stat_dst.latency_min / NSEC_PER_SEC;
                         total_results.results.per_trace[i].stats.lat_max =
-                                io_stat_dst.latency_max;
+                                (double)io_stat_dst.latency_max / NSEC_PER_SEC;
+                        set_percentiles(&total_results.results.per_trace[i]
+                                                 .stats,
+                                        &trace_hist);
+                        latency_hist_merge(&total_hist, &trace_hist);
+                        set_pace_percentiles(&total_results.results.per_trace[i]
+                                                      .stats,
+                                             &trace_pace);
+                        latency_hist_merge(&total_pace, &trace_pace);
+                        total_results.results.per_trace[i]
+                                .stats.avg_queue_delay =
+                                io_stat_dst.queue_delay_cnt ?
+                                        (double)io_stat_dst.queue_delay /
+                                                io_stat_dst.queue_delay_cnt /
+                                                NSEC_PER_SEC :
+                                        0;
+                        total_results.results.per_trace[i].stats.lag_max =
+                                (double)io_stat_dst.lag_max / NSEC_PER_SEC;
+                        total_results.results.per_trace[i].stats.lag_shift =
+                                (double)__atomic_load_n(&trace->lag_shift,
+                                                        __ATOMIC_RELAXED) /
+                                NSEC_PER_SEC;
+                        total_results.results.per_trace[i]
+                                .stats.nr_lag_dropped =
+                                io_stat_dst.nr_lag_dropped;
+                        total_results.results.per_trace[i]
+                                .stats.nr_lag_shifted =
+                                io_stat_dst.nr_lag_shifted;
+                        total_results.results.per_trace[i].stats.nr_verified =
+                                io_stat_dst.nr_verified;
+                        total_results.results.per_trace[i].stats.token_wait =
+                                (double)io_stat_dst.token_wait / NSEC_PER_SEC;
+                        total_results.results.per_trace[i]
+                                .stats.nr_token_waits =
+                                io_stat_dst.nr_token_waits;
+                        total_results.results.per_trace[i]
+                                .stats.nr_verify_errors =
+                                io_stat_dst.nr_verify_errors;
                         total_results.results.per_trace[i].stats.iops =
-                                io_stat_dst.latency_count /
-                                io_stat_dst.execution_time;
+                                exec_time ? io_stat_dst.latency_count /
+                                                    exec_time :
+                                            0;
 
                         total_results.results.per_trace[i].stats.total_bw =
-                                io_stat_dst.execution_time ?
+                                exec_time ?
                                         (double)io_stat_dst.total_bytes / MB /
-                                                io_stat_dst.execution_time :
+                                                exec_time :
                                         0;
 
                         total_results.results.per_trace[i].stats.read_bw =
-                                io_stat_dst.execution_time ?
+                                exec_time ?
                                         (double)io_stat_dst.total_rbytes / MB /
-                                                io_stat_dst.execution_time :
+                                                exec_time :
                                         0;
 
                         total_results.results.per_trace[i].stats.write_bw =
-                                io_stat_dst.execution_time ?
+                                exec_time ?
                                         (double)io_stat_dst.total_wbytes / MB /
-                                                io_stat_dst.execution_time :
+                                                exec_time :
                                         0;
 
                         total_results.results.per_trace[i].stats.total_traffic =
@@ -701,6 +1680,8 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                                 (double)io_stat_dst.total_rbytes / MB;
                         total_results.results.per_trace[i].stats.write_traffic =
                                 (double)io_stat_dst.total_wbytes / MB;
+                        total_results.results.per_trace[i].stats.error_traffic =
+                                (double)io_stat_dst.total_error_bytes / MB;
                         total_results.results.per_trace[i].stats.read_ratio =
                                 (double)io_stat_dst.total_bytes ?
                                         (double)io_stat_dst.total_wbytes /
@@ -726,7 +1707,7 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                                                 io_stat_dst.latency_count / KB :
                                         0;
                         total_results.results.per_trace[i].trace_reset_count =
-                                trace->trace_repeat_count;
+                                trace_repeat_count(trace);
                 }
 
                 if (!i) {
@@ -752,14 +1733,31 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                 total_stat.latency_sum_sqr += io_stat_dst.latency_sum_sqr;
                 total_stat.time_diff += io_stat_dst.time_diff;
                 total_stat.time_diff_cnt += io_stat_dst.time_diff_cnt;
+                total_stat.queue_delay += io_stat_dst.queue_delay;
+                total_stat.queue_delay_cnt += io_stat_dst.queue_delay_cnt;
+                if (io_stat_dst.lag > total_stat.lag)
+                        total_stat.lag = io_stat_dst.lag;
+                if (io_stat_dst.lag_max > total_stat.lag_max)
+                        total_stat.lag_max = io_stat_dst.lag_max;
+                total_stat.nr_lag_dropped += io_stat_dst.nr_lag_dropped;
+                total_stat.nr_lag_shifted += io_stat_dst.nr_lag_shifted;
+                total_stat.nr_verified += io_stat_dst.nr_verified;
+                total_stat.token_wait += io_stat_dst.token_wait;
+                total_stat.nr_token_waits += io_stat_dst.nr_token_waits;
+                total_stat.nr_verify_errors += io_stat_dst.nr_verify_errors;
+                total_stat.total_error_bytes += io_stat_dst.total_error_bytes;
+
+                if (__atomic_load_n(&trace->lag_shift, __ATOMIC_RELAXED) >
+                    total_lag_shift)
+                        total_lag_shift = __atomic_load_n(&trace->lag_shift,
+                                                          __ATOMIC_RELAXED);
 
-                pthread_spin_lock(&trace->trace_lock);
                 double temp_percent =
-                        (double)(trace->trace_io_cur +
-                                 (trace->trace_io_cnt *
-                                  (trace->trace_repeat_count - 1))) *
-                        100 / (trace->trace_io_cnt * trace->trace_repeat_num);
-                pthread_spin_unlock(&trace->trace_lock);
+                        trace->trace_io_cnt ?
+                                (double)trace_issued(trace) * 100 /
+                                        ((double)trace->trace_io_cnt *
+                                         trace->trace_repeat_num) :
+                                0;
                 if (temp_percent > progress_percent)
                         progress_percent = temp_percent;
         }
@@ -779,12 +1777,40 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
 
                 total_results.results.aggr_result.stats.exec_time =
                         execution_time;
-                total_results.results.aggr_result.stats.avg_lat = mean;
-                total_results.results.aggr_result.stats.avg_lat_var = variance;
+                total_results.results.aggr_result.stats.avg_lat =
+                        mean / NSEC_PER_SEC;
+                total_results.results.aggr_result.stats.avg_lat_var =
+                        variance / NSEC_PER_SEC / NSEC_PER_SEC;
                 total_results.results.aggr_result.stats.lat_min =
-                        total_stat.latency_min;
+                        (double)total_stat.latency_min / NSEC_PER_SEC;
                 total_results.results.aggr_result.stats.lat_max =
-                        total_stat.latency_max;
+                        (double)total_stat.latency_max / NSEC_PER_SEC;
+                set_percentiles(&total_results.results.aggr_result.stats,
+                                &total_hist);
+                set_pace_percentiles(&total_results.results.aggr_result.stats,
+                                     &total_pace);
+                total_results.results.aggr_result.stats.avg_queue_delay =
+                        total_stat.queue_delay_cnt ?
+                                (double)total_stat.queue_delay /
+                                        total_stat.queue_delay_cnt /
+                                        NSEC_PER_SEC :
+                                0;
+                total_results.results.aggr_result.stats.lag_max =
+                        (double)total_stat.lag_max / NSEC_PER_SEC;
+                total_results.results.aggr_result.stats.lag_shift =
+                        (double)total_lag_shift / NSEC_PER_SEC;
+                total_results.results.aggr_result.stats.nr_lag_dropped =
+                        total_stat.nr_lag_dropped;
+                total_results.results.aggr_result.stats.nr_lag_shifted =
+                        total_stat.nr_lag_shifted;
+                total_results.results.aggr_result.stats.nr_verified =
+                        total_stat.nr_verified;
+                total_results.results.aggr_result.stats.token_wait =
+                        (double)total_stat.token_wait / NSEC_PER_SEC;
+                total_results.results.aggr_result.stats.nr_token_waits =
+                        total_stat.nr_token_waits;
+                total_results.results.aggr_result.stats.nr_verify_errors =
+                        total_stat.nr_verify_errors;
 
                 total_results.results.aggr_result.stats.iops =
                         execution_time ? (double)total_stat.latency_count /
@@ -810,6 +1836,8 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                         (double)total_stat.total_rbytes / MB;
                 total_results.results.aggr_result.stats.write_traffic =
                         (double)total_stat.total_wbytes / MB;
+                total_results.results.aggr_result.stats.error_traffic =
+                        (double)total_stat.total_error_bytes / MB;
                 total_results.results.aggr_result.stats.read_ratio =
                         (double)total_stat.total_wbytes ?
                                 (double)total_stat.total_rbytes /
@@ -831,19 +1859,19 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                                 (double)total_stat.total_wbytes /
                                         total_stat.latency_count / KB :
                                 0;
+
+                set_dev_results(execution_time);
         } else {
                 double avg_bw, cur_bw;
                 double latency;
                 double avg_time_diff;
                 double period_time;
-                struct timeval cur_tv;
+                unsigned long long now = nstime_now();
                 static unsigned long long total_bytes;
 
-                gettimeofday(&cur_tv, NULL);
-                period_time = time_since(&tv_end, &cur_tv);
-
-                gettimeofday(&tv_end, NULL);
-                execution_time = time_since(&tv_start, &tv_end);
+                period_time = nstime_sec(end_ns, now);
+                end_ns = now;
+                execution_time = nstime_sec(start_ns, end_ns);
 
                 if (execution_time) {
                         avg_bw = (double)total_stat.total_bytes / MB /
@@ -861,14 +1889,14 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
 
                 if (total_stat.latency_count) {
                         latency = (double)total_stat.latency_sum /
-                                  total_stat.latency_count;
+                                  total_stat.latency_count / NSEC_PER_SEC;
                 } else {
                         latency = 0;
                 }
 
                 if (total_stat.time_diff_cnt) {
                         avg_time_diff = (double)total_stat.time_diff /
-                                        total_stat.time_diff_cnt / 1000;
+                                        total_stat.time_diff_cnt / NSEC_PER_SEC;
                 } else {
                         avg_time_diff = 0;
                 }
@@ -894,6 +1922,10 @@ void print_result(int nr_trace, int nr_thread, FILE *fp, int detail)
                 rmsg.log.cur_bw = cur_bw;
                 rmsg.log.lat = latency;
                 rmsg.log.time_diff = avg_time_diff;
+                rmsg.log.lag = (double)total_stat.lag / NSEC_PER_SEC;
+                rmsg.log.nr_lag_dropped = total_stat.nr_lag_dropped;
+                rmsg.log.nr_lag_shifted = total_stat.nr_lag_shifted;
+                rmsg.log.nr_verify_errors = total_stat.nr_verify_errors;
 
                 if (timeout) {
                         rmsg.log.type = TIMEOUT;
@@ -952,11 +1984,53 @@ void usage_help()
         printf(" 2. Using Synthetic Workload \n");
         printf(" #./trace_replay qdepth per_thread output timeout trace_repeat synth_type wss utilization iosize \n");
         printf(" rand_read rand_write rand_mixed seq_read seq_write seq_mixed \n");
+        printf(" zipf_, pareto_, hotspot_ + read write mixed (see --skew) \n");
         printf(" wss (in MB unit)\n");
         printf(" utilization (in pecent unit)\n");
         printf(" iosize (in KB unit)\n");
         printf("\n");
         printf(" #./trace_replay 32 2 result.txt 60 1 /dev/sdb1 rand_write 128 10 4\n\n");
+
+        printf(" Options (placed before qdepth) \n");
+        printf(" --engine=libaio|io_uring   I/O submission engine (default: libaio)\n");
+        printf(" --sqpoll                   io_uring kernel submission polling\n");
+        printf(" --iopoll                   io_uring polled completion\n");
+        printf(" --hugepage                 back I/O buffers with hugepages\n");
+        printf(" --no-trace-cache           do not read or write <trace>%s\n",
+               TRACE_BIN_SUFFIX);
+        printf(" --stream[=MB]              replay a text trace while loading it (%dMB)\n",
+               TRACE_STREAM_DEFAULT_MB);
+        printf(" --parse-threads=N          threads parsing a text trace (one per cpu)\n");
+        printf(" --tsc                      timestamp with the invariant TSC\n");
+        printf(" --spin=US                  spin the last US of an arrival wait (%d)\n",
+               PACE_SPIN_US);
+        printf(" --fifo[=PRIO]              run the workers with SCHED_FIFO (1)\n");
+        printf(" --mlock                    lock the memory with mlockall()\n");
+        printf(" --open-loop[=N]            issue at the arrival times, up to N in flight (qdepth)\n");
+        printf(" --lag=burst|shift|drop|rate:IOPS  requests later than the threshold (burst)\n");
+        printf(" --lag-threshold=US         lag tolerated by --lag (%d)\n",
+               LAG_THRESHOLD_US);
+        printf(" --user-reap                libaio: reap from the completion ring, syscall when empty\n");
+        printf(" --completer                reap on a thread of its own (eventfd with libaio)\n");
+        printf(" --cpus=auto|LIST[/LIST..]  pin the workers of each trace, auto for the device's node\n");
+        printf(" --compress=PCT             write payloads PCT%% zeros (0)\n");
+        printf(" --dedupe=PCT               write payloads PCT%% duplicate blocks (0)\n");
+        printf(" --payload-refill=N         new random payload every N writes (%d)\n",
+               PAYLOAD_REFILL);
+        printf(" --verify                   stamp the sectors written, check the ones read\n");
+        printf(" --skew=P[/P..]             zipf THETA, pareto ALPHA or hotspot HOT,ACCESS per trace\n");
+        printf(" --arrival=P[/P..]          pace synthetic traces, const:IOPS poisson:IOPS\n");
+        printf("                            onoff:IOPS,ON_MS,OFF_MS mmpp:IOPS0,MS0,IOPS1,MS1\n");
+        printf(" --rate=IOPS[:BURST][,MBPS[:BURST_MB]][/..]  token bucket of each trace\n");
+        printf(" --thread-rate=IOPS[:BURST][,MBPS[:BURST_MB]][/..]  of each worker of a trace\n");
+        printf(" --hist-log[=FILE]          latency histograms of every second (<output>.hist)\n");
+        printf(" --io-log[=FILE]            a record of every completion (<output>.io)\n");
+        printf(" --io-log-sample=N          log one in N completions (1)\n");
+        printf(" --dev=DEV[,DEV..]          device of each trace (the device argument)\n");
+        printf(" --devno-map=N:DEV[,N:DEV..]  devices of the devnos in the traces\n");
+        printf(" --file-size=MB             size of the files used as devices (their own)\n");
+        printf(" --prewrite                 write the files once before the replay\n");
+        printf(" #./trace_replay --engine=io_uring --sqpoll 32 2 result.txt 60 1 /dev/nvme0n1 rand_read 128 10 4\n\n");
 }
 
 int remove_lastchars(FILE *fp, int len)
@@ -981,13 +2055,17 @@ void finalize()
         key_t server_qkey, server_shmkey, server_semkey;
         int server_qid, server_shmid, signal_sem;
 
-        gettimeofday(&tv_end, NULL);
-        timeval_subtract(&tv_result, &tv_end, &tv_start);
-        execution_time = time_since(&tv_start, &tv_end);
+        end_ns = nstime_now();
+        execution_time = nstime_sec(start_ns, end_ns);
 
         print_result(nr_trace, nr_thread, stdout, 1);
 
         fclose(log_fp);
+        hist_log_close(hist_log);
+        hist_log = NULL;
+        /* the workers are joined, so the rings only drain */
+        io_log_close(io_log);
+        io_log = NULL;
 
         sprintf(key_pathname, "%s_%d", MSGQ_KEY_PATHNAME, getpid());
         if ((server_qkey = ftok(key_pathname, PROJECT_ID)) < 0) {
@@ -1044,251 +2122,899 @@ no_shm:
         fprintf(stdout, "\n Finalizing Trace Replayer \n");
 }
 
-int trace_io_put(char *line, struct trace_info_t *trace, int qdepth)
+/*
+ * Appends req to trace_buf after trimming the part of it which overlaps
+ * one of the last trace_window requests. Returns 1 when req is dropped
+ * because it is covered by (or covers) an earlier request.
+ */
+int trace_io_put_req(struct trace_info_t *trace, struct trace_io_req *req)
 {
-        struct trace_io_req *io;
-        struct trace_io_req *new_io;
-        int start;
-        int i, j, k;
-        double arrival_time;
-        int devno;
-        int blkno;
-        int bcount;
-        unsigned int flags;
+        if (trace->trace_buf_size <= trace->trace_io_cnt) {
+                trace->trace_buf_size *= 2;
+                trace->trace_buf = realloc(trace->trace_buf,
+                                           sizeof(struct trace_io_req) *
+                                                   trace->trace_buf_size);
+        }
+
+        if (trace->trace_window && trace->trace_index == NULL) {
+                trace->trace_index = trace_index_create(trace->trace_window);
+                if (trace->trace_index == NULL) {
+                        printf(" cannot allocate the overlap window \n");
+                        trace->trace_window = 0;
+                }
+        }
+        if (trace_index_trim(trace->trace_index, trace->trace_buf, ~0LL, req))
+                return 1;
+
+        memcpy(&trace->trace_buf[trace->trace_io_cnt], req,
+               sizeof(struct trace_io_req));
+        trace_index_add(trace->trace_index, trace->trace_io_cnt, req);
+        trace->trace_io_cnt++;
+
+        return 0;
+}
+
+/* the window is not needed once the whole trace is in trace_buf */
+void trace_io_put_done(struct trace_info_t *trace)
+{
+        trace_index_destroy(trace->trace_index);
+        trace->trace_index = NULL;
+}
+
+/* parses a DiskSim ascii trace line, returns -1 for a malformed one */
+int trace_io_parse(char *line, struct trace_io_req *req)
+{
+        return trace_parse_line(line, line + strlen(line), req);
+}
+
+int trace_io_put(char *line, struct trace_info_t *trace)
+{
+        struct trace_io_req req;
+
+        if (trace_io_parse(line, &req))
+                return -1;
+
+        return trace_io_put_req(trace, &req);
+}
+
+void main_worker()
+{
+        struct thread_info_t *t_info;
+        int i;
+
+        while (1) {
+                int done = 0;
+                int position;
+
+                for (i = 0; i < nr_thread; i++) {
+                        t_info = &th_info[i];
+                        pthread_mutex_lock(&t_info->mutex);
+                        done += t_info->done;
+                        pthread_mutex_unlock(&t_info->mutex);
+                }
+
+                if (done == nr_thread)
+                        break;
+
+                print_result(nr_trace, nr_thread, stdout, 0);
+
+                usleep(REFRESH_SLEEP);
+        }
+
+        printf(" main worker has been finished ... \n");
+}
+
+size_t trace_max_bytes(struct trace_info_t *trace)
+{
+        size_t max_bytes = 0;
+        int i;
+
+        if (trace->synth)
+                return trace->io_size < MAX_BYTES ? trace->io_size : MAX_BYTES;
+        for (i = 0; i < trace->trace_io_cnt; i++) {
+                size_t bytes = (size_t)((trace->trace_buf[i].bcount + SPP - 1) /
+                                        SPP) *
+                               PAGE_SIZE;
+                if (bytes > max_bytes)
+                        max_bytes = bytes;
+        }
+
+        if (max_bytes > (size_t)MAX_BYTES)
+                max_bytes = MAX_BYTES;
+
+        return max_bytes;
+}
+
+unsigned int trace_buf_classes(struct trace_info_t *trace)
+{
+        unsigned int classes = 0;
+        int i;
+
+        if (trace->synth)
+                return 1u << io_pool_class(trace_max_bytes(trace));
+        for (i = 0; i < trace->trace_io_cnt; i++) {
+                size_t bytes = (size_t)((trace->trace_buf[i].bcount + SPP - 1) /
+                                        SPP) *
+                               PAGE_SIZE;
+                if (bytes > (size_t)MAX_BYTES)
+                        bytes = MAX_BYTES;
+                classes |= 1u << io_pool_class(bytes);
+        }
+
+        return classes;
+}
+
+/*
+ * A repeat is utilization% of the io_size items of the working set. rand_*
+ * and seq_* visit the first ones once each, a skewed distribution draws
+ * the item of every request over the whole working set instead, so the
+ * hot ones come again and again. The requests themselves are made up
+ * from their tickets by synthetic_req().
+ */
+int synthetic_gen(struct trace_info_t *trace)
+{
+        long long n;
+
+        trace->trace_io_cnt = trace->working_set_pages / trace->io_pages / 100 *
+                              trace->utilization;
+        trace_reset(trace);
+        trace->trace_timescale = 0.0;
+
+        n = trace->working_set_pages / trace->io_pages;
+        if (trace->synth_dist == SYNTH_UNIFORM)
+                n = trace->trace_io_cnt > 0 ? trace->trace_io_cnt : 1;
+
+        trace->synth = malloc(sizeof(struct synth_dist));
+        if (trace->synth == NULL)
+                return -1;
+        if (synth_dist_init(trace->synth, trace->synth_dist, n,
+                            trace->synth_skew, SYNTH_SEED + (trace - traces))) {
+                printf(" invalid %s parameters %s \n", trace->tracename,
+                       trace->synth_skew);
+                return -1;
+        }
+        if (trace->synth_rand)
+                synth_dist_format(trace->synth, trace->synth_skew,
+                                  sizeof(trace->synth_skew));
+        else
+                sprintf(trace->synth_skew, "seq");
+
+        /* paced like a trace file, as fast as possible without */
+        if (!trace->synth_arrival[0]) {
+                sprintf(trace->synth_arrival, "none");
+                return 0;
+        }
+        trace->arrival = arrival_create(trace->synth_arrival,
+                                        ARRIVAL_SEED + (trace - traces));
+        if (trace->arrival == NULL) {
+                printf(" invalid %s arrival %s \n", trace->tracename,
+                       trace->synth_arrival);
+                return -1;
+        }
+        arrival_format(trace->arrival, trace->synth_arrival,
+                       sizeof(trace->synth_arrival));
+        trace->trace_timescale = 1.0;
+        return 0;
+}
+
+void destroy(pthread_t *threads)
+{
+        int t, k;
+
+        for (t = 0; t < nr_trace; t++) {
+                trace_set_eof(&traces[t]);
+        }
+
+        for (t = 0; t < nr_thread; t++) {
+                pthread_join(threads[t], NULL);
+
+                pthread_mutex_destroy(&th_info[t].mutex);
+                pthread_cond_destroy(&th_info[t].cond_sub);
+                pthread_cond_destroy(&th_info[t].cond_main);
+                if (th_info[t].engine == IO_ENGINE_URING)
+                        uring_io_exit(&th_info[t]);
+                else
+                        io_queue_release(th_info[t].io_ctx);
+                if (th_info[t].efd >= 0)
+                        close(th_info[t].efd);
+
+                io_pool_destroy(th_info[t].pool);
+                payload_destroy(th_info[t].payload);
+                rate_limit_destroy(th_info[t].rate_limit);
+                for (k = 0; k < th_info[t].trace->nr_devs; k++)
+                        if (trace_dev_first(th_info[t].trace, k) == k)
+                                disk_close(th_info[t].fds[k]);
+        }
+
+        for (t = 0; t < nr_trace; t++) {
+                if (traces[t].stream)
+                        trace_stream_destroy(&traces[t]);
+                if (!traces[t].synthetic && traces[t].trace_fp) {
+                        fclose(traces[t].trace_fp);
+                }
+                if (traces[t].trace_map)
+                        trace_bin_unmap(traces[t].trace_map,
+                                        traces[t].trace_map_size);
+                else
+                        free(traces[t].trace_buf);
+                free(traces[t].synth);
+                arrival_destroy(traces[t].arrival);
+                rate_limit_destroy(traces[t].rate_limit);
+                disk_close(traces[t].fd);
+        }
+
+        finalize();
+
+        /* the final results are made of the histograms */
+        for (t = 0; t < nr_thread; t++) {
+                free(th_info[t].lat_hist);
+                free(th_info[t].pace_hist);
+        }
+}
+
+void sig_handler(int signum)
+{
+        printf("Received signal %d\n", signum);
+
+        destroy(threads);
+
+        signal(SIGINT, SIG_DFL);
+        exit(0);
+}
+
+#ifdef USE_RAND_BUF
+void fill_rand_buf()
+{
+        int i;
+
+        g_buf = allocate_aligned_buffer(io_size);
+        if (g_buf == NULL) {
+                printf(" Malloc error \n");
+                exit(0);
+        }
+
+        for (i = 0; i < io_size; i += sizeof(int)) {
+                unsigned int *p = &g_buf[i];
+                *p = RND(io_size);
+                if (i <= 12)
+                        printf(" %u %u\n", *p, io_size);
+        }
+}
+#endif
+
+void *trace_loader(void *data)
+{
+        struct trace_info_t *trace = (struct trace_info_t *)data;
+        char line[201];
+        struct stat st;
+
+        if (!fstat(fileno(trace->trace_fp), &st) && S_ISREG(st.st_mode) &&
+            !trace_parse_fd(trace, fileno(trace->trace_fp), parse_threads)) {
+                trace_io_put_done(trace);
+                return NULL;
+        }
+
+        while (1) {
+                if (fgets(line, 200, trace->trace_fp) == NULL) {
+                        break;
+                }
+                if (trace_io_put(line, trace))
+                        continue;
+        }
+        trace_io_put_done(trace);
+
+        return NULL;
+}
+
+/*
+ * Uses the records of a binary trace in place when they were trimmed with
+ * the same window, otherwise trims them again into a private trace_buf.
+ * A cache is only used when it matches the text trace and the window.
+ */
+static int trace_load_bin(struct trace_info_t *trace, const char *path,
+                          int is_cache)
+{
+        struct trace_bin_header hdr;
+        struct trace_io_req *reqs;
+        void *map;
+        size_t map_size;
+        long long i;
+        int ret;
 
-        if (trace->trace_buf_size <= trace->trace_io_cnt) {
-                trace->trace_buf_size *= 2;
-                trace->trace_buf = realloc(trace->trace_buf,
-                                           sizeof(struct trace_io_req) *
-                                                   trace->trace_buf_size);
+        ret = trace_bin_map(path, &hdr, &map, &map_size);
+        if (ret)
+                return ret;
+
+        if (is_cache && (hdr.src_size != trace->trace_src_size ||
+                         hdr.src_mtime != trace->trace_src_mtime ||
+                         hdr.window != trace->trace_window)) {
+                trace_bin_unmap(map, map_size);
+                return -ESTALE;
         }
-AAA:
-        if (sscanf(line, "%lf %d %d %d %x\n", &arrival_time, &devno, &blkno,
-                   &bcount, &flags) != 5) {
-                fprintf(stderr,
-                        "Wrong number of arguments for I/O trace event type\n");
-                fprintf(stderr, "line: %s", line);
-                return -1;
+
+        reqs = trace_bin_records(map);
+        if (hdr.window == trace->trace_window) {
+                trace->trace_map = map;
+                trace->trace_map_size = map_size;
+                trace->trace_buf = reqs;
+                trace->trace_buf_size = (int)hdr.nr_records;
+                trace->trace_io_cnt = (int)hdr.nr_records;
+                return 0;
         }
-        start = (trace->trace_io_cnt - qdepth * nr_thread > 0) ?
-                        trace->trace_io_cnt - qdepth * nr_thread :
-                        0;
-        for (i = start; i < trace->trace_io_cnt; i++) {
-                io = &trace->trace_buf[i];
-
-                if (io->devno == devno) {
-                        if (blkno < io->blkno && (blkno + bcount) > io->blkno &&
-                            (blkno + bcount) < (io->blkno + io->bcount)) {
-                                bcount = io->blkno - blkno;
-                        } else if (blkno <= io->blkno &&
-                                   (blkno + bcount) >=
-                                           (io->blkno + io->bcount)) {
-                                io->blkno = blkno;
-                                io->bcount = bcount;
-                                if (fgets(line, 200, trace->trace_fp) == NULL) {
-                                        return -1;
-                                }
-                                goto AAA;
-                        } else if (blkno >= io->blkno &&
-                                   (blkno + bcount) <=
-                                           (io->blkno + io->bcount)) {
-                                if (fgets(line, 200, trace->trace_fp) == NULL) {
-                                        return -1;
-                                }
-                                goto AAA;
-                        } else if (blkno > io->blkno &&
-                                   blkno < (io->blkno + io->bcount) &&
-                                   (blkno + bcount) >
-                                           (io->blkno + io->bcount)) {
-                                bcount = bcount -
-                                         (io->blkno + io->bcount - blkno);
-                                blkno = io->blkno + io->bcount;
-                        }
-                }
+
+        if (hdr.window)
+                printf(" %s was trimmed with window %lld, trim again with %d\n",
+                       path, hdr.window, trace->trace_window);
+
+        trace->trace_buf_size = 1024;
+        trace->trace_buf = malloc(sizeof(struct trace_io_req) * 1024);
+        trace->trace_io_cnt = 0;
+        for (i = 0; i < hdr.nr_records; i++) {
+                struct trace_io_req req = reqs[i];
+                trace_io_put_req(trace, &req);
         }
-        new_io = &trace->trace_buf[trace->trace_io_cnt];
-        new_io->arrival_time = arrival_time;
-        new_io->devno = devno;
-        new_io->bcount = bcount;
-        new_io->blkno = blkno;
-        new_io->flags = flags;
-        trace->trace_io_cnt++;
+        trace_io_put_done(trace);
+        trace_bin_unmap(map, map_size);
 
         return 0;
 }
 
-void main_worker()
+/*
+ * Loads a binary trace or a valid cache right away. Otherwise leaves
+ * trace_fp open for trace_loader() and an empty trace_buf to fill.
+ * "-" and other files which are not regular files (pipes) are read as
+ * text traces without a cache.
+ */
+int trace_open(struct trace_info_t *trace)
 {
-        struct thread_info_t *t_info;
-        int i;
+        char cache_path[PATH_MAX];
+        struct stat st;
+        int ret;
 
-        while (1) {
-                int done = 0;
-                int position;
+        if (!strcmp(trace->tracename, "-")) {
+                trace->trace_fp = stdin;
+                goto text;
+        }
 
-                for (i = 0; i < nr_thread; i++) {
-                        t_info = &th_info[i];
-                        pthread_mutex_lock(&t_info->mutex);
-                        done += t_info->done;
-                        pthread_mutex_unlock(&t_info->mutex);
-                }
+        if (stat(trace->tracename, &st)) {
+                printf("file open error %s\n", trace->tracename);
+                return -1;
+        }
 
-                if (done == nr_thread)
-                        break;
+        if (S_ISREG(st.st_mode)) {
+                ret = trace_bin_probe(trace->tracename);
+                if (ret < 0) {
+                        printf("file open error %s\n", trace->tracename);
+                        return -1;
+                }
+                if (ret)
+                        return trace_load_bin(trace, trace->tracename, 0) ? -1 :
+                                                                           0;
+        }
 
-                print_result(nr_trace, nr_thread, stdout, 0);
+        trace->trace_fp = fopen(trace->tracename, "r");
+        if (trace->trace_fp == NULL) {
+                printf("file open error %s\n", trace->tracename);
+                return -1;
+        }
 
-                usleep(REFRESH_SLEEP);
+        fstat(fileno(trace->trace_fp), &st);
+        if (!S_ISREG(st.st_mode))
+                goto text;
+        trace->trace_src_size = st.st_size;
+        trace->trace_src_mtime =
+                (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+        snprintf(cache_path, sizeof(cache_path), "%s" TRACE_BIN_SUFFIX,
+                 trace->tracename);
+        if (use_trace_cache && !trace_load_bin(trace, cache_path, 1)) {
+                printf(" trace cache %s \n", cache_path);
+                fclose(trace->trace_fp);
+                trace->trace_fp = NULL;
+                return 0;
         }
 
-        printf(" main worker has been finished ... \n");
+text:
+        trace->trace_buf_size = 1024;
+        trace->trace_buf = malloc(sizeof(struct trace_io_req) * 1024);
+        trace->trace_io_cnt = 0;
+
+        return 0;
 }
 
-void synthetic_mix(struct trace_info_t *trace)
+/* called once trace_loader() has parsed the text trace */
+void trace_cache_write(struct trace_info_t *trace)
 {
-        int i;
-        struct timeval cur_tv;
-
-        if (!trace->synth_rand)
-                return;
+        char cache_path[PATH_MAX];
+        int ret;
 
-        if (!trace->synthetic)
+        if (!use_trace_cache || trace->trace_fp == NULL ||
+            !trace->trace_src_size)
                 return;
 
-        gettimeofday(&cur_tv, NULL);
-        sgenrand(cur_tv.tv_sec);
+        snprintf(cache_path, sizeof(cache_path), "%s" TRACE_BIN_SUFFIX,
+                 trace->tracename);
+        ret = trace_bin_write(cache_path, trace->trace_buf, trace->trace_io_cnt,
+                              trace->trace_window, trace->trace_src_size,
+                              trace->trace_src_mtime);
+        if (ret)
+                printf(" cannot write trace cache %s: %s\n", cache_path,
+                       strerror(-ret));
+}
 
-        for (i = 0; i < trace->trace_io_cnt; i++) {
-                struct trace_io_req *req1, *req2;
-                struct trace_io_req temp;
-                int j = i;
+/* trace_replay --convert [--window=N] text_trace binary_trace */
+int trace_convert(const char *src, const char *dst, int window)
+{
+        static struct trace_info_t trace;
+        int ret;
 
-                req1 = &trace->trace_buf[i];
-                while (j == i) {
-                        j = RND(trace->trace_io_cnt);
-                }
-                req2 = &trace->trace_buf[j];
+        memset(&trace, 0x00, sizeof(struct trace_info_t));
+        snprintf(trace.tracename, sizeof(trace.tracename), "%s", src);
+        trace.trace_window = window;
 
-                memcpy(&temp, req1, sizeof(struct trace_io_req));
-                memcpy(req1, req2, sizeof(struct trace_io_req));
-                memcpy(req2, &temp, sizeof(struct trace_io_req));
+        use_trace_cache = 0;
+        if (trace_open(&trace))
+                return -1;
+        if (trace.trace_fp) {
+                trace_loader(&trace);
+                fclose(trace.trace_fp);
         }
+
+        ret = trace_bin_write(dst, trace.trace_buf, trace.trace_io_cnt, window,
+                              0, 0);
+        if (ret)
+                printf(" cannot write %s: %s\n", dst, strerror(-ret));
+        else
+                printf(" %s: %d requests (window %d) \n", dst,
+                       trace.trace_io_cnt, window);
+
+        if (trace.trace_map)
+                trace_bin_unmap(trace.trace_map, trace.trace_map_size);
+        else
+                free(trace.trace_buf);
+
+        return ret ? -1 : 0;
 }
 
-void synthetic_gen(struct trace_info_t *trace)
+static struct option long_options[] = {
+        { "engine", required_argument, NULL, 'e' },
+        { "sqpoll", no_argument, NULL, 's' },
+        { "iopoll", no_argument, NULL, 'p' },
+        { "hugepage", no_argument, NULL, 'H' },
+        { "no-trace-cache", no_argument, NULL, 'N' },
+        { "convert", no_argument, NULL, 'c' },
+        { "window", required_argument, NULL, 'w' },
+        { "stream", optional_argument, NULL, 'S' },
+        { "parse-threads", required_argument, NULL, 'P' },
+        { "tsc", no_argument, NULL, 'T' },
+        { "spin", required_argument, NULL, 'i' },
+        { "fifo", optional_argument, NULL, 'F' },
+        { "mlock", no_argument, NULL, 'L' },
+        { "open-loop", optional_argument, NULL, 'O' },
+        { "lag", required_argument, NULL, 'l' },
+        { "lag-threshold", required_argument, NULL, 't' },
+        { "user-reap", no_argument, NULL, 'u' },
+        { "completer", no_argument, NULL, 'C' },
+        { "cpus", required_argument, NULL, 'A' },
+        { "compress", required_argument, NULL, 'z' },
+        { "dedupe", required_argument, NULL, 'd' },
+        { "payload-refill", required_argument, NULL, 'R' },
+        { "verify", no_argument, NULL, 'V' },
+        { "skew", required_argument, NULL, 'k' },
+        { "arrival", required_argument, NULL, 'a' },
+        { "rate", required_argument, NULL, 'r' },
+        { "thread-rate", required_argument, NULL, 'j' },
+        { "hist-log", optional_argument, NULL, 'g' },
+        { "io-log", optional_argument, NULL, 'I' },
+        { "io-log-sample", required_argument, NULL, 'm' },
+        { "dev", required_argument, NULL, 'D' },
+        { "devno-map", required_argument, NULL, 'M' },
+        { "file-size", required_argument, NULL, 'f' },
+        { "prewrite", no_argument, NULL, 'W' },
+        { NULL, 0, NULL, 0 },
+};
+
+/* the index-th entry of a sep separated option, the last one for the rest */
+static void list_opt(const char *opt, char sep, int index, char *spec,
+                     size_t size)
 {
+        const char reject[2] = { sep, '\0' };
+        const char *p = opt;
+        size_t len;
         int i;
 
-        trace->trace_io_cnt = trace->working_set_pages / trace->io_pages / 100 *
-                              trace->utilization;
-        trace->trace_io_cur = 0;
-        trace->trace_timescale = 0.0;
+        for (i = 0; i < index && strchr(p, sep); i++)
+                p = strchr(p, sep) + 1;
+        len = strcspn(p, reject);
+        if (len >= size)
+                len = size - 1;
+        memcpy(spec, p, len);
+        spec[len] = '\0';
+}
 
-        trace->trace_buf =
-                malloc(sizeof(struct trace_io_req) * trace->trace_io_cnt);
+static void trace_opt(const char *opt, int index, char *spec, size_t size)
+{
+        list_opt(opt, '/', index, spec, size);
+}
 
-        for (i = 0; i < trace->trace_io_cnt; i++) {
-                struct trace_io_req *req = &trace->trace_buf[i];
-                req->arrival_time = i * 1.0;
-                req->devno = 0;
-                req->blkno = i * trace->io_pages * SPP;
-                req->bcount = trace->io_pages * SPP;
-
-                if (trace->synth_write)
-                        req->flags = 0;
-                else if (trace->synth_read)
-                        req->flags = 1;
-                else {
-                        if (RND(100) < 50)
-                                req->flags = 0;
-                        else
-                                req->flags = 1;
+/*
+ * Picks the cpus of the index-th trace from --cpus, where the last entry
+ * also serves the traces after it. The buffers go to the node of those
+ * cpus when they are all on one.
+ */
+static int trace_place(struct trace_info_t *trace, int index)
+{
+        char spec[STR_SIZE];
+        cpu_set_t set, allowed;
+        int node = -1;
+
+        trace->cpus[0] = '\0';
+        trace->numa_node = -1;
+        if (cpus_opt == NULL)
+                return 0;
+
+        trace_opt(cpus_opt, index, spec, sizeof(spec));
+
+        if (!strcmp(spec, AFFINITY_AUTO)) {
+                node = affinity_dev_node(trace->filename);
+                if (node < 0 || affinity_node_cpus(node, &set) < 0) {
+                        printf(" %s has no NUMA node, the workers are not pinned \n",
+                               trace->filename);
+                        return 0;
                 }
+        } else if (affinity_parse(spec, &set) < 0) {
+                printf(" invalid cpu list %s \n", spec);
+                return -1;
+        }
+
+        /* a cpuset cgroup may have taken some of them away */
+        if (!sched_getaffinity(0, sizeof(allowed), &allowed))
+                CPU_AND(&set, &set, &allowed);
+        if (!CPU_COUNT(&set)) {
+                printf(" none of the cpus %s can be used \n", spec);
+                return -1;
         }
 
-        synthetic_mix(trace);
+        if (node < 0)
+                node = affinity_set_node(&set);
+        trace->numa_node = node;
+        return affinity_format(&set, trace->cpus, sizeof(trace->cpus));
 }
 
-void destroy(pthread_t *threads, int qdepth)
+/*
+ * The index-th rate limit of opt, NULL without one. spec gets the limit
+ * with its bursts filled in.
+ */
+static int rate_limit_opt(const char *opt, int index,
+                          struct rate_limit **limit, char *spec, size_t size)
 {
-        int t, i;
+        *limit = NULL;
+        spec[0] = '\0';
+        if (opt == NULL)
+                return 0;
 
-        for (t = 0; t < nr_trace; t++) {
-                trace_set_eof(&traces[t]);
+        trace_opt(opt, index, spec, size);
+        *limit = rate_limit_create(spec);
+        if (*limit == NULL) {
+                printf(" invalid rate limit %s \n", spec);
+                return -1;
         }
+        rate_limit_format(*limit, spec, size);
+        return 0;
+}
 
-        for (t = 0; t < nr_thread; t++) {
-                pthread_join(threads[t], NULL);
+/*
+ * The index of path in replay_devs, sized when it is first seen. Anything
+ * but a block device is a file, made ready by file_prepare().
+ */
+static int replay_dev_get(const char *path)
+{
+        struct replay_dev *rdev;
+        struct stat st;
+        int fd, d;
+
+        for (d = 0; d < nr_dev; d++)
+                if (!strcmp(replay_devs[d].path, path))
+                        return d;
+        if (nr_dev == MAX_DEVS) {
+                printf(" too many devices, up to %d \n", MAX_DEVS);
+                return -1;
+        }
 
-                pthread_spin_destroy(&th_info[t].io_stat.stat_lock);
-                pthread_mutex_destroy(&th_info[t].mutex);
-                pthread_cond_destroy(&th_info[t].cond_sub);
-                pthread_cond_destroy(&th_info[t].cond_main);
-                io_queue_release(th_info[t].io_ctx);
+        rdev = &replay_devs[nr_dev];
+        memset(rdev, 0x00, sizeof(struct replay_dev));
+        snprintf(rdev->path, sizeof(rdev->path), "%s", path);
+        rdev->open_flags = O_RDWR | O_DIRECT;
 
-                for (i = 0; i < qdepth; i++) {
-                        free(th_info[t].th_buf[i]);
-                        free(th_info[t].th_jobs[i]);
-                }
-                disk_close(th_info[t].fd);
+        if (stat(path, &st) || !S_ISBLK(st.st_mode)) {
+                if (file_prepare(path, (long long)file_size_mb * MB, prewrite,
+                                 &rdev->open_flags, &rdev->capacity))
+                        return -1;
+                return nr_dev++;
         }
 
-        for (t = 0; t < nr_trace; t++) {
-                pthread_spin_destroy(&traces[i].trace_lock);
-                if (!traces[t].synthetic) {
-                        fclose(traces[t].trace_fp);
-                }
-                free(traces[t].trace_buf);
-                disk_close(traces[t].fd);
-        }
+        fd = disk_open(path, rdev->open_flags);
+        if (fd < 0)
+                return -1;
+        ioctl(fd, BLKGETSIZE64, &rdev->capacity);
+        close(fd);
 
-        finalize();
+        return nr_dev++;
 }
 
-void sig_handler(int signum)
+/*
+ * The index-th trace goes to the index-th entry of --dev, or dev without
+ * one. The devnos in --devno-map go to their own devices, the same for
+ * every trace; device paths have '/' in them, so these lists are split
+ * by ','.
+ */
+static int trace_devs_init(struct trace_info_t *trace, int index,
+                           const char *dev)
 {
-        printf("Received signal %d\n", signum);
+        char spec[STR_SIZE];
+        char *entry, *end, *save;
+        struct trace_dev *tdev;
+        int i;
 
-        destroy(threads, qdepth);
+        if (dev_opt)
+                list_opt(dev_opt, ',', index, trace->filename,
+                         sizeof(trace->filename));
+        else
+                snprintf(trace->filename, sizeof(trace->filename), "%s", dev);
 
-        signal(SIGINT, SIG_DFL);
-        exit(0);
+        tdev = &trace->devs[0];
+        tdev->devno = DEVNO_ANY;
+        tdev->dev = replay_dev_get(trace->filename);
+        if (tdev->dev < 0)
+                return -1;
+        trace->nr_devs = 1;
+
+        if (devno_map_opt) {
+                snprintf(spec, sizeof(spec), "%s", devno_map_opt);
+                for (entry = strtok_r(spec, ",", &save); entry != NULL;
+                     entry = strtok_r(NULL, ",", &save)) {
+                        strtol(entry, &end, 10);
+                        if (end == entry || *end != ':') {
+                                printf(" invalid devno map %s \n", entry);
+                                return -1;
+                        }
+                        if (trace->nr_devs == MAX_TRACE_DEVS) {
+                                printf(" too many devnos, up to %d \n",
+                                       MAX_TRACE_DEVS - 1);
+                                return -1;
+                        }
+
+                        tdev = &trace->devs[trace->nr_devs];
+                        tdev->devno = atoi(entry);
+                        tdev->dev = replay_dev_get(end + 1);
+                        if (tdev->dev < 0)
+                                return -1;
+                        trace->nr_devs++;
+                }
+        }
+
+        for (i = 0; i < trace->nr_devs; i++)
+                if (trace_dev_first(trace, i) == i)
+                        replay_devs[trace->devs[i].dev].nr_traces++;
+        return 0;
 }
 
-#ifdef USE_RAND_BUF
-void fill_rand_buf()
+/* each trace gets the next equal part of every device it uses */
+static void trace_devs_partition(struct trace_info_t *trace)
 {
+        struct trace_dev *tdev, *first;
+        struct replay_dev *rdev;
         int i;
 
-        g_buf = allocate_aligned_buffer(io_size);
-        if (g_buf == NULL) {
-                printf(" Malloc error \n");
-                exit(0);
-        }
+        for (i = 0; i < trace->nr_devs; i++) {
+                tdev = &trace->devs[i];
+                first = &trace->devs[trace_dev_first(trace, i)];
+                if (first != tdev) {
+                        tdev->total_pages = first->total_pages;
+                        tdev->start_partition = first->start_partition;
+                        continue;
+                }
 
-        for (i = 0; i < io_size; i += sizeof(int)) {
-                unsigned int *p = &g_buf[i];
-                *p = RND(io_size);
-                if (i <= 12)
-                        printf(" %u %u\n", *p, io_size);
+                rdev = &replay_devs[tdev->dev];
+                tdev->total_pages =
+                        rdev->capacity / PAGE_SIZE / rdev->nr_traces;
+                tdev->start_partition =
+                        tdev->total_pages * PAGE_SIZE * rdev->nr_parts++;
         }
 }
-#endif
 
-void *trace_loader(void *data)
+/* returns the number of arguments consumed by options */
+int parse_options(int argc, char **argv)
 {
-        struct trace_info_t *trace = (struct trace_info_t *)data;
-        char line[201];
-
-        while (1) {
-                if (fgets(line, 200, trace->trace_fp) == NULL) {
+        int opt;
+
+        while ((opt = getopt_long(argc, argv, "+", long_options, NULL)) != -1) {
+                switch (opt) {
+                case 'e':
+                        if (!strcmp(optarg, "libaio")) {
+                                io_engine = IO_ENGINE_LIBAIO;
+                        } else if (!strcmp(optarg, "io_uring")) {
+                                io_engine = IO_ENGINE_URING;
+                        } else {
+                                printf(" invalid engine %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 's':
+                        uring_flags |= URING_SQPOLL;
+                        break;
+                case 'p':
+                        uring_flags |= URING_IOPOLL;
+                        break;
+                case 'H':
+                        use_hugepage = 1;
+                        break;
+                case 'N':
+                        use_trace_cache = 0;
+                        break;
+                case 'c':
+                        convert_mode = 1;
+                        break;
+                case 'S':
+                        stream_mb = optarg ? atoi(optarg) :
+                                             TRACE_STREAM_DEFAULT_MB;
+                        if (stream_mb <= 0) {
+                                printf(" invalid stream buffer %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 'P':
+                        parse_threads = atoi(optarg);
+                        if (parse_threads < 1) {
+                                printf(" invalid parse threads %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 'T':
+                        use_tsc = 1;
+                        break;
+                case 'i':
+                        pace_spin_us = atoi(optarg);
+                        if (pace_spin_us < 0) {
+                                printf(" invalid spin %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 'F':
+                        sched_fifo_prio = optarg ? atoi(optarg) : 1;
+                        if (sched_fifo_prio <
+                                    sched_get_priority_min(SCHED_FIFO) ||
+                            sched_fifo_prio >
+                                    sched_get_priority_max(SCHED_FIFO)) {
+                                printf(" invalid fifo priority %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 'L':
+                        use_mlock = 1;
+                        break;
+                case 'u':
+                        user_reap = 1;
+                        break;
+                case 'C':
+                        completer = 1;
+                        break;
+                case 'A':
+                        cpus_opt = optarg;
+                        break;
+                case 'z':
+                case 'd':
+                case 'R':
+                        if (payload_compress < 0)
+                                payload_compress = 0;
+                        if (opt == 'z')
+                                payload_compress = atoi(optarg);
+                        else if (opt == 'd')
+                                payload_dedupe = atoi(optarg);
+                        else
+                                payload_refill = atoi(optarg);
+                        if (payload_compress > 100 || payload_compress < 0 ||
+                            payload_dedupe > 100 || payload_dedupe < 0 ||
+                            payload_refill < 1) {
+                                printf(" invalid payload option %s \n",
+                                       optarg);
+                                return -1;
+                        }
+                        break;
+                case 'k':
+                        skew_opt = optarg;
+                        break;
+                case 'a':
+                        arrival_opt = optarg;
+                        break;
+                case 'r':
+                        rate_opt = optarg;
+                        break;
+                case 'j':
+                        thread_rate_opt = optarg;
+                        break;
+                case 'g':
+                        hist_log_opt = optarg ? optarg : "";
+                        break;
+                case 'I':
+                        io_log_opt = optarg ? optarg : "";
+                        break;
+                case 'D':
+                        dev_opt = optarg;
+                        break;
+                case 'M':
+                        devno_map_opt = optarg;
+                        break;
+                case 'f':
+                        file_size_mb = atoi(optarg);
+                        if (file_size_mb < 1) {
+                                printf(" invalid file size %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 'W':
+                        prewrite = 1;
+                        break;
+                case 'm':
+                        io_log_sample = atoi(optarg);
+                        if (io_log_sample < 1) {
+                                printf(" invalid io log sample %s \n",
+                                       optarg);
+                                return -1;
+                        }
+                        break;
+                case 'V':
+#ifdef USE_RAND_BUF
+                        printf(" --verify needs a buffer per request \n");
+                        return -1;
+#endif
+                        verify = 1;
+                        break;
+                case 'l':
+                        if (!strcmp(optarg, "burst")) {
+                                lag_policy = LAG_BURST;
+                        } else if (!strcmp(optarg, "shift")) {
+                                lag_policy = LAG_SHIFT;
+                        } else if (!strcmp(optarg, "drop")) {
+                                lag_policy = LAG_DROP;
+                        } else if (!strncmp(optarg, "rate:", 5) &&
+                                   atoi(optarg + 5) > 0) {
+                                lag_policy = LAG_RATE;
+                                lag_rate = atoi(optarg + 5);
+                        } else {
+                                printf(" invalid lag policy %s \n", optarg);
+                                return -1;
+                        }
+                        break;
+                case 't':
+                        lag_threshold_us = atoi(optarg);
+                        if (lag_threshold_us < 0) {
+                                printf(" invalid lag threshold %s \n",
+                                       optarg);
+                                return -1;
+                        }
+                        break;
+                case 'O':
+                        open_loop = optarg ? atoi(optarg) : MAX_QDEPTH;
+                        if (open_loop < 1) {
+                                printf(" invalid outstanding limit %s \n",
+                                       optarg);
+                                return -1;
+                        }
+                        break;
+                case 'w':
+                        convert_window = atoi(optarg);
+                        if (convert_window < 0) {
+                                printf(" invalid window %s \n", optarg);
+                                return -1;
+                        }
                         break;
+                default:
+                        return -1;
                 }
-                if (trace_io_put(line, trace, qdepth))
-                        continue;
         }
 
-        return NULL;
+        return optind - 1;
 }
 
 #define EXT_ARG_NUM 4
@@ -1297,13 +3023,32 @@ int main(int argc, char **argv)
 {
         pthread_t trace_loader_thread[MAX_THREADS];
         int rc;
-        int i;
+        int i, k, d;
         long t;
         int open_flags;
         int argc_offset = ARG_TRACE;
+        const char *synth_op;
+        int dist;
         int per_thread;
         int repeat;
         char line[201];
+        pthread_condattr_t cond_attr;
+
+        rc = parse_options(argc, argv);
+        if (rc < 0) {
+                usage_help();
+                return -1;
+        }
+        argc -= rc;
+        argv += rc;
+
+        if (convert_mode) {
+                if (argc != 3) {
+                        usage_help();
+                        return -1;
+                }
+                return trace_convert(argv[1], argv[2], convert_window);
+        }
 
         if ((argc - argc_offset) % EXT_ARG_NUM != 0) {
                 usage_help();
@@ -1349,6 +3094,32 @@ int main(int argc, char **argv)
                 return -1;
         }
 
+        if (hist_log_opt) {
+                if (hist_log_opt[0])
+                        snprintf(line, sizeof(line), "%s", hist_log_opt);
+                else
+                        snprintf(line, sizeof(line), "%s.hist",
+                                 argv[ARG_OUTPUT]);
+                hist_log = hist_log_create(line, nr_trace);
+                if (hist_log == NULL) {
+                        printf(" open file %s error \n", line);
+                        return -1;
+                }
+        }
+
+        if (io_log_opt) {
+                if (io_log_opt[0])
+                        snprintf(line, sizeof(line), "%s", io_log_opt);
+                else
+                        snprintf(line, sizeof(line), "%s.io", argv[ARG_OUTPUT]);
+                io_log = io_log_create(line, nr_thread, per_thread,
+                                       io_log_sample);
+                if (io_log == NULL) {
+                        printf(" open file %s error \n", line);
+                        return -1;
+                }
+        }
+
         total_results.config.qdepth = qdepth;
         total_results.config.timeout = timeout;
         total_results.config.nr_trace = nr_trace;
@@ -1356,33 +3127,39 @@ int main(int argc, char **argv)
         total_results.config.per_thread = per_thread;
         sprintf(total_results.config.result_file, "%s", argv[ARG_OUTPUT]);
 
+        /* the devices have to be known before they are split */
         for (i = 0; i < nr_trace; i++) {
-                struct trace_info_t *trace = &traces[i];
+                memset(&traces[i], 0x00, sizeof(struct trace_info_t));
+                if (trace_devs_init(&traces[i], i, argv[ARG_DEV]))
+                        return -1;
+        }
+        total_results.config.nr_dev = nr_dev;
 
-                memset(trace, 0x00, sizeof(struct trace_info_t));
+        for (i = 0; i < nr_trace; i++) {
+                struct trace_info_t *trace = &traces[i];
 
                 strcpy(trace->tracename, argv[argc_offset + i * EXT_ARG_NUM]);
-                strcpy(trace->filename, argv[ARG_DEV]);
 
-                open_flags = O_RDWR | O_DIRECT;
+                open_flags = replay_devs[trace->devs[0].dev].open_flags;
                 trace->fd = disk_open(trace->filename, open_flags);
                 if (trace->fd < 0)
                         return -1;
 
-                pthread_spin_init(&trace->trace_lock, 0);
-                ioctl(trace->fd, BLKGETSIZE64, &trace->total_capacity);
-                trace->total_pages = trace->total_capacity / PAGE_SIZE;
-                trace->total_pages = trace->total_pages / nr_trace;
+                trace_reset(trace);
+                trace_devs_partition(trace);
+                trace->total_pages = trace->devs[0].total_pages;
                 trace->total_sectors = trace->total_pages * SPP;
                 trace->total_capacity = trace->total_pages * PAGE_SIZE;
-                trace->start_partition = trace->total_capacity * i;
+                trace->start_partition = trace->devs[0].start_partition;
                 trace->start_page = trace->start_partition / PAGE_SIZE;
                 trace->timeout = timeout;
-                trace->trace_repeat_count = 1;
                 trace->trace_repeat_num = repeat;
 
                 // synthetic workload
-                if (!strcmp(argv[argc_offset + i * EXT_ARG_NUM], "rand") ||
+                dist = synth_dist_type(argv[argc_offset + i * EXT_ARG_NUM],
+                                       &synth_op);
+                if (dist > 0 ||
+                    !strcmp(argv[argc_offset + i * EXT_ARG_NUM], "rand") ||
                     !strcmp(argv[argc_offset + i * EXT_ARG_NUM],
                             "rand_write") ||
                     !strcmp(argv[argc_offset + i * EXT_ARG_NUM], "rand_read") ||
@@ -1444,7 +3221,22 @@ int main(int argc, char **argv)
                                 trace->synth_read = 0;
                                 trace->synth_mixed = 1;
                                 printf(" Synthetic workload: Sequential Mixed Read Write\n");
+                        } else if (dist > 0) {
+                                trace->synth_rand = 1;
+                                trace->synth_write = !strcmp(synth_op, "write");
+                                trace->synth_read = !strcmp(synth_op, "read");
+                                trace->synth_mixed = !strcmp(synth_op, "mixed");
+                                trace->synth_dist = dist;
+                                if (skew_opt != NULL)
+                                        trace_opt(skew_opt, i,
+                                                  trace->synth_skew,
+                                                  sizeof(trace->synth_skew));
+                                printf(" Synthetic workload: %s\n",
+                                       argv[argc_offset + i * EXT_ARG_NUM]);
                         }
+                        if (arrival_opt != NULL)
+                                trace_opt(arrival_opt, i, trace->synth_arrival,
+                                          sizeof(trace->synth_arrival));
 
                         trace->io_size = atoi(
                                 argv[argc_offset + i * EXT_ARG_NUM + 3]); // KB
@@ -1493,7 +3285,8 @@ int main(int argc, char **argv)
                         trace->wanted_io_count = trace->working_set_pages /
                                                  trace->io_pages * repeat;
                         wanted_io_count = trace->wanted_io_count;
-                        synthetic_gen(trace);
+                        if (synthetic_gen(trace))
+                                return -1;
 
                         printf(" WSS (Working Set Size) = %dMB\n",
                                (int)trace->working_set_size);
@@ -1510,24 +3303,22 @@ int main(int argc, char **argv)
                                (int)trace->io_size / KB);
 
                 } else {
-                        trace->trace_buf_size = 1024;
-                        trace->trace_buf =
-                                malloc(sizeof(struct trace_io_req) * 1024);
-                        trace->trace_io_cnt = 0;
-                        trace->trace_io_cur = 0;
                         trace->trace_timescale =
                                 atof(argv[argc_offset + i * EXT_ARG_NUM + 1]);
+                        trace->trace_window = qdepth * nr_thread;
 
-                        trace->trace_fp =
-                                fopen(argv[argc_offset + i * EXT_ARG_NUM], "r");
-                        if (trace->trace_fp == NULL) {
-                                printf("file open error %s\n",
-                                       argv[argc_offset + i * EXT_ARG_NUM]);
+                        if (trace_open(trace))
                                 return -1;
-                        }
 
-                        rc = pthread_create(&trace_loader_thread[i], NULL,
-                                            trace_loader, (void *)trace);
+                        rc = 0;
+                        if (trace->trace_fp && stream_mb)
+                                rc = trace_stream_start(trace,
+                                                        (size_t)stream_mb * MB,
+                                                        use_trace_cache);
+                        else if (trace->trace_fp)
+                                rc = pthread_create(&trace_loader_thread[i],
+                                                    NULL, trace_loader,
+                                                    (void *)trace);
                         if (rc) {
                                 printf("ERROR; return code from pthread_create( is %d\n",
                                        rc);
@@ -1540,28 +3331,68 @@ int main(int argc, char **argv)
                 total_results.config.traces[i].total_size =
                         (double)trace->total_capacity / 1024 / 1024 / 1024;
                 total_results.config.traces[i].start_page = trace->start_page;
+                strcpy(total_results.config.traces[i].device, trace->filename);
+                if (devno_map_opt)
+                        snprintf(total_results.config.traces[i].devno_map,
+                                 STR_SIZE, "%s", devno_map_opt);
                 total_results.config.traces[i].total_pages =
                         trace->start_page + trace->total_pages;
+
+                if (trace_place(trace, i))
+                        return -1;
+                if (trace->cpus[0])
+                        printf(" Trace %d: workers on cpus %s, buffers on node %d\n",
+                               i, trace->cpus, trace->numa_node);
+                strcpy(total_results.config.traces[i].cpus, trace->cpus);
+                total_results.config.traces[i].numa_node = trace->numa_node;
+
+                if (rate_limit_opt(rate_opt, i, &trace->rate_limit,
+                                   total_results.config.traces[i].rate_limit,
+                                   STR_SIZE))
+                        return -1;
         }
 
         for (i = 0; i < nr_trace; i++) {
                 struct trace_info_t *trace = &traces[i];
-                if (!trace->synthetic)
+                if (trace->stream) {
+                        /* the largest request is not known yet */
+                        trace->max_bytes = TRACE_STREAM_MAX_BYTES;
+                        trace->buf_classes = ~0u;
+                        continue;
+                }
+                if (!trace->synthetic && trace->trace_fp) {
                         pthread_join(trace_loader_thread[i], NULL);
+                        trace_cache_write(trace);
+                }
+                trace->max_bytes = trace_max_bytes(trace);
+                trace->buf_classes = trace_buf_classes(trace);
+                /* an arrival process already counts the repeats */
+                if (!trace->synth && trace->trace_io_cnt)
+                        trace->trace_period =
+                                trace->trace_buf[trace->trace_io_cnt - 1]
+                                        .arrival_time;
         }
 
+        /* the open loop reaps on a thread of its own as well */
+        if (open_loop || completer)
+                uring_flags |= URING_REAPER;
         for (t = 0; t < nr_thread; t++) {
                 struct thread_info_t *t_info = &th_info[t];
                 struct trace_info_t *trace = &traces[t / per_thread];
                 t_info->trace = trace;
 
                 pthread_mutex_init(&t_info->mutex, NULL);
-                pthread_cond_init(&t_info->cond_sub, NULL);
+                /* open_loop_wait() sleeps on it until a CLOCK_MONOTONIC time */
+                pthread_condattr_init(&cond_attr);
+                pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+                pthread_cond_init(&t_info->cond_sub, &cond_attr);
+                pthread_condattr_destroy(&cond_attr);
                 pthread_cond_init(&t_info->cond_main, NULL);
 
                 memset(&t_info->io_ctx, 0, sizeof(io_context_t));
 
                 t_info->tid = (int)t;
+                t_info->engine = io_engine;
                 t_info->queue_depth = qdepth;
                 t_info->queue_count = 0;
                 t_info->active_count = 0;
@@ -1569,25 +3400,84 @@ int main(int argc, char **argv)
 
                 t_info->fsync_period = 0;
 
-                open_flags = O_RDWR | O_DIRECT;
-                t_info->fd = disk_open(trace->filename, open_flags);
-                if (t_info->fd < 0)
-                        return -1;
+                for (k = 0; k < trace->nr_devs; k++) {
+                        d = trace_dev_first(trace, k);
+                        if (d != k) {
+                                t_info->fds[k] = t_info->fds[d];
+                                continue;
+                        }
+                        d = trace->devs[k].dev;
+                        t_info->fds[k] = disk_open(replay_devs[d].path,
+                                                   replay_devs[d].open_flags);
+                        if (t_info->fds[k] < 0)
+                                return -1;
+                }
+                t_info->fd = t_info->fds[0];
 
-                for (i = 0; i < qdepth; i++) {
-                        t_info->th_buf[i] = allocate_aligned_buffer(MAX_BYTES);
-                        t_info->th_jobs[i] = malloc(sizeof(struct io_job));
+                t_info->pool = io_pool_create(qdepth, trace->max_bytes,
+                                              use_hugepage);
+                if (t_info->pool == NULL)
+                        return -1;
+                if (trace->numa_node >= 0 &&
+                    io_pool_bind(t_info->pool, trace->numa_node))
+                        perror("mbind");
+                t_info->payload = NULL;
+                if (payload_compress >= 0) {
+                        t_info->payload =
+                                payload_create((int)t, payload_compress,
+                                               payload_dedupe, payload_refill);
+                        if (t_info->payload == NULL)
+                                return -1;
                 }
-                t_info->buf_cur = 0;
+                if (rate_limit_opt(thread_rate_opt, t / per_thread,
+                                   &t_info->rate_limit,
+                                   total_results.config.traces[t / per_thread]
+                                           .thread_rate_limit,
+                                   STR_SIZE))
+                        return -1;
+                t_info->lat_hist = calloc(1, sizeof(struct latency_hist));
+                t_info->pace_hist = calloc(1, sizeof(struct latency_hist));
+                if (t_info->lat_hist == NULL || t_info->pace_hist == NULL)
+                        return -1;
 
                 memset(&t_info->io_stat, 0x00, sizeof(struct io_stat_t));
-                pthread_spin_init(&t_info->io_stat.stat_lock, 0);
+                memset(&t_info->io_stat_last, 0x00, sizeof(struct io_stat_t));
+
+                if (t_info->engine == IO_ENGINE_URING) {
+                        if (uring_io_init(t_info, uring_flags))
+                                return -1;
+                } else {
+                        io_queue_init(t_info->queue_depth, &t_info->io_ctx);
+                        t_info->aio_ring =
+                                user_reap && aio_ring_usable(t_info->io_ctx);
+                        if (user_reap && !t_info->aio_ring)
+                                printf(" no user space completion ring, reap with io_getevents() \n");
+                }
 
-                io_queue_init(t_info->queue_depth, &t_info->io_ctx);
+                /* the completer of a libaio context sleeps on an eventfd */
+                t_info->efd = -1;
+                if (completer && t_info->engine == IO_ENGINE_LIBAIO) {
+                        t_info->efd = eventfd(0, EFD_CLOEXEC);
+                        if (t_info->efd < 0)
+                                perror("eventfd");
+                }
         }
 
+        if (io_engine == IO_ENGINE_URING && uring_io_pinned())
+                printf(" io_uring: %lldKB of registered buffers pinned \n",
+                       uring_io_pinned() >> 10);
+        if (nstime_init(use_tsc))
+                printf(" no invariant TSC, timestamps use %s \n",
+                       nstime_source());
+        /* after the traces and buffers are in, page faults stall the replay */
+        if (use_mlock && mlockall(MCL_CURRENT | MCL_FUTURE))
+                perror("mlockall");
+        start_ns = nstime_now();
+        end_ns = start_ns;
+        verify_seed = (uint32_t)(start_ns ^ getpid());
+
         for (t = 0; t < nr_thread; t++) {
-                rc = pthread_create(&threads[t], NULL, sub_worker, (void *)t);
+                rc = create_worker(&threads[t], th_info[t].trace, t);
                 if (rc) {
                         printf("ERROR; return code from pthread_create( is %d\n",
                                rc);
@@ -1595,15 +3485,12 @@ int main(int argc, char **argv)
                 }
         }
 
-        gettimeofday(&tv_start, NULL);
-        gettimeofday(&tv_start2, NULL);
-
         signal(SIGINT, sig_handler);
 
         /* json file for real time results */
         main_worker();
 
-        destroy(threads, qdepth);
+        destroy(threads);
 
         return 0;
 }
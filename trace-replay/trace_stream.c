@@ -0,0 +1,425 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Streaming trace loader
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <trace_replay.h>
+#include <trace_bin.h>
+#include <trace_stream.h>
+#include <trace_index.h>
+
+#define TRACE_STREAM_WAIT_NS (10 * 1000 * 1000)
+
+static void cond_wait_ns(pthread_cond_t *cond, pthread_mutex_t *lock,
+                         long ns)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += ns;
+        if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(cond, lock, &ts);
+}
+
+static int trace_closed(struct trace_info_t *trace)
+{
+        return __atomic_load_n(&trace->trace_ticket_end, __ATOMIC_ACQUIRE) !=
+               LLONG_MAX;
+}
+
+static void trace_stream_open_spill(struct trace_info_t *trace,
+                                    struct trace_stream *stream, int use_cache)
+{
+        struct trace_bin_header hdr;
+
+        if (stream->seekable && use_cache) {
+                snprintf(stream->cache_path, sizeof(stream->cache_path),
+                         "%s" TRACE_BIN_SUFFIX, trace->tracename);
+                snprintf(stream->spill_path, sizeof(stream->spill_path),
+                         "%s.%d.tmp", stream->cache_path, getpid());
+                stream->spill = fopen(stream->spill_path, "w+");
+                if (stream->spill == NULL)
+                        stream->spill_path[0] = '\0';
+        } else if (!stream->seekable &&
+                   (trace->timeout > 0.0 || trace->wanted_io_count ||
+                    trace->trace_repeat_num > 1)) {
+                /* a pipe can only be repeated from a copy */
+                stream->spill = tmpfile();
+        }
+
+        if (stream->spill == NULL)
+                return;
+
+        /* the header is rewritten once the first pass is complete */
+        trace_bin_header_init(&hdr, 0, trace->trace_window, 0, 0);
+        if (fwrite(&hdr, sizeof(hdr), 1, stream->spill) != 1)
+                stream->spill_failed = 1;
+}
+
+static void trace_stream_close_spill(struct trace_stream *stream)
+{
+        fclose(stream->spill);
+        stream->spill = NULL;
+        if (stream->spill_path[0])
+                unlink(stream->spill_path);
+        stream->spill_path[0] = '\0';
+}
+
+static void trace_stream_finish_spill(struct trace_info_t *trace,
+                                      struct trace_stream *stream)
+{
+        struct trace_bin_header hdr;
+
+        if (stream->spill == NULL)
+                return;
+
+        trace_bin_header_init(&hdr, stream->produced, trace->trace_window,
+                              trace->trace_src_size, trace->trace_src_mtime);
+        if (!stream->spill_failed &&
+            (fseek(stream->spill, 0, SEEK_SET) ||
+             fwrite(&hdr, sizeof(hdr), 1, stream->spill) != 1 ||
+             fflush(stream->spill)))
+                stream->spill_failed = 1;
+
+        if (stream->spill_failed) {
+                printf(" cannot keep a copy of %s: %s\n", trace->tracename,
+                       strerror(errno));
+                trace_stream_close_spill(stream);
+                return;
+        }
+
+        if (stream->spill_path[0]) {
+                if (rename(stream->spill_path, stream->cache_path))
+                        printf(" cannot write trace cache %s: %s\n",
+                               stream->cache_path, strerror(errno));
+                else
+                        stream->spill_path[0] = '\0';
+        }
+}
+
+/* makes [published, upto) visible to the workers */
+static void trace_stream_publish(struct trace_stream *stream, long long upto)
+{
+        long long published = stream->published;
+        long long mask = stream->ring_size - 1;
+        long long i;
+
+        if (upto <= published)
+                return;
+
+        if (!stream->pass && stream->spill && !stream->spill_failed) {
+                for (i = published; i < upto; i++) {
+                        if (fwrite(&stream->ring[i & mask],
+                                   sizeof(struct trace_io_req), 1,
+                                   stream->spill) != 1) {
+                                stream->spill_failed = 1;
+                                break;
+                        }
+                }
+        }
+
+        __atomic_store_n(&stream->published, upto, __ATOMIC_RELEASE);
+
+        if (upto / TRACE_STREAM_CHUNK != published / TRACE_STREAM_CHUNK) {
+                pthread_mutex_lock(&stream->lock);
+                pthread_cond_broadcast(&stream->loaded);
+                pthread_mutex_unlock(&stream->lock);
+        }
+}
+
+/* waits until the chunk of the next slot has been read by the workers */
+static int trace_stream_slot(struct trace_info_t *trace,
+                             struct trace_stream *stream)
+{
+        long long slot = stream->produced;
+        unsigned int *consumed;
+
+        if (slot < stream->ring_size || slot % TRACE_STREAM_CHUNK)
+                return 0;
+
+        consumed = &stream->consumed[(slot & (stream->ring_size - 1)) /
+                                     TRACE_STREAM_CHUNK];
+        pthread_mutex_lock(&stream->lock);
+        while (__atomic_load_n(consumed, __ATOMIC_ACQUIRE) <
+               TRACE_STREAM_CHUNK) {
+                if (stream->stop || trace_closed(trace)) {
+                        pthread_mutex_unlock(&stream->lock);
+                        return -1;
+                }
+                cond_wait_ns(&stream->freed, &stream->lock,
+                             TRACE_STREAM_WAIT_NS);
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        __atomic_store_n(consumed, 0, __ATOMIC_RELAXED);
+        return 0;
+}
+
+/* returns 1 with the next record in req, 0 at the end of the pass */
+static int trace_stream_next(struct trace_info_t *trace,
+                             struct trace_stream *stream,
+                             struct trace_io_req *req, int *trim)
+{
+        char line[201];
+
+        if (stream->pass && stream->spill) {
+                *trim = 0;
+                return fread(req, sizeof(*req), 1, stream->spill) == 1;
+        }
+
+        *trim = 1;
+        while (fgets(line, 200, trace->trace_fp) != NULL) {
+                if (!trace_io_parse(line, req))
+                        return 1;
+        }
+        return 0;
+}
+
+/* returns 1 when no more passes are needed */
+static int trace_stream_end_pass(struct trace_info_t *trace,
+                                 struct trace_stream *stream)
+{
+        long long nr_req = stream->produced - stream->pass_start;
+
+        trace_stream_publish(stream, stream->produced);
+        if (!stream->pass) {
+                /* the next passes start where this one ends */
+                if (nr_req)
+                        trace->trace_period =
+                                stream->ring[(stream->produced - 1) &
+                                             (stream->ring_size - 1)]
+                                        .arrival_time;
+                __atomic_store_n(&trace->trace_io_cnt, (int)nr_req,
+                                 __ATOMIC_RELEASE);
+                trace_stream_finish_spill(trace, stream);
+        }
+
+        stream->pass++;
+        stream->pass_start = stream->produced;
+        /* every pass is trimmed on its own, as the loaded trace would be */
+        if (stream->index)
+                trace_index_reset(stream->index);
+
+        if (!nr_req || __atomic_load_n(&stream->stop, __ATOMIC_RELAXED) ||
+            trace_closed(trace))
+                return 1;
+        if (trace->timeout == 0.0) {
+                if (trace->wanted_io_count &&
+                    stream->produced >= trace->wanted_io_count)
+                        return 1;
+                if (!trace->wanted_io_count &&
+                    stream->pass >= trace->trace_repeat_num)
+                        return 1;
+        }
+
+        if (stream->spill &&
+            !fseek(stream->spill, sizeof(struct trace_bin_header), SEEK_SET))
+                return 0;
+        if (stream->seekable && !fseek(trace->trace_fp, 0, SEEK_SET))
+                return 0;
+
+        printf(" %s cannot be repeated\n", trace->tracename);
+        return 1;
+}
+
+static void *trace_stream_loader(void *data)
+{
+        struct trace_info_t *trace = (struct trace_info_t *)data;
+        struct trace_stream *stream = trace->stream;
+        long long mask = stream->ring_size - 1;
+
+        while (1) {
+                struct trace_io_req req;
+                int trim;
+
+                if (!trace_stream_next(trace, stream, &req, &trim)) {
+                        if (trace_stream_end_pass(trace, stream))
+                                break;
+                        continue;
+                }
+
+                if (trim && trace_index_trim(stream->index, stream->ring, mask,
+                                             &req))
+                        continue;
+
+                if (trace_stream_slot(trace, stream))
+                        break;
+                stream->ring[stream->produced & mask] = req;
+                if (trim)
+                        trace_index_add(stream->index, stream->produced, &req);
+                stream->produced++;
+
+                trace_stream_publish(stream, trim ? stream->produced -
+                                                            trace->trace_window :
+                                                    stream->produced);
+        }
+
+        pthread_mutex_lock(&stream->lock);
+        __atomic_store_n(&stream->done, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&stream->loaded);
+        pthread_mutex_unlock(&stream->lock);
+
+        return NULL;
+}
+
+/*
+ * Replaces the loader of an opened text trace. The ring takes up to
+ * max_mem bytes, but always holds the trimming window and two chunks.
+ */
+int trace_stream_start(struct trace_info_t *trace, size_t max_mem,
+                       int use_cache)
+{
+        struct trace_stream *stream;
+        struct stat st;
+        long long min_size;
+        int rc;
+
+        stream = calloc(1, sizeof(struct trace_stream));
+        if (stream == NULL)
+                return -1;
+
+        stream->ring_size = TRACE_STREAM_CHUNK;
+        while (stream->ring_size * 2 * sizeof(struct trace_io_req) <= max_mem)
+                stream->ring_size *= 2;
+        min_size = (long long)trace->trace_window + 2 * TRACE_STREAM_CHUNK;
+        while (stream->ring_size < min_size)
+                stream->ring_size *= 2;
+
+        stream->nr_chunks = stream->ring_size / TRACE_STREAM_CHUNK;
+        stream->ring = malloc(sizeof(struct trace_io_req) * stream->ring_size);
+        stream->consumed = calloc(stream->nr_chunks, sizeof(unsigned int));
+        if (trace->trace_window)
+                stream->index = trace_index_create(trace->trace_window);
+        if (stream->ring == NULL || stream->consumed == NULL ||
+            (trace->trace_window && stream->index == NULL)) {
+                trace_index_destroy(stream->index);
+                free(stream->ring);
+                free(stream->consumed);
+                free(stream);
+                return -1;
+        }
+
+        stream->seekable = !fstat(fileno(trace->trace_fp), &st) &&
+                           S_ISREG(st.st_mode);
+        trace_stream_open_spill(trace, stream, use_cache);
+
+        pthread_mutex_init(&stream->lock, NULL);
+        pthread_cond_init(&stream->loaded, NULL);
+        pthread_cond_init(&stream->freed, NULL);
+
+        /* the records live in the ring from now on */
+        free(trace->trace_buf);
+        trace->trace_buf = NULL;
+        trace->trace_buf_size = 0;
+        trace->trace_io_cnt = 0;
+        trace->stream = stream;
+
+        rc = pthread_create(&stream->thread, NULL, trace_stream_loader, trace);
+        if (rc) {
+                trace->stream = NULL;
+                if (stream->spill)
+                        trace_stream_close_spill(stream);
+                trace_index_destroy(stream->index);
+                free(stream->ring);
+                free(stream->consumed);
+                free(stream);
+                return -1;
+        }
+
+        printf(" streaming %s through %lld records\n", trace->tracename,
+               stream->ring_size);
+        return 0;
+}
+
+/* 1 if ticket can be read, 0 if it is not loaded yet, -1 if it never will */
+int trace_stream_ready(struct trace_stream *stream, long long ticket)
+{
+        if (ticket < __atomic_load_n(&stream->published, __ATOMIC_ACQUIRE))
+                return 1;
+        if (!__atomic_load_n(&stream->done, __ATOMIC_ACQUIRE))
+                return 0;
+        /* done is set after the last publish */
+        return ticket < __atomic_load_n(&stream->published, __ATOMIC_ACQUIRE) ?
+                       1 :
+                       -1;
+}
+
+/* called by a worker which has run out of loaded tickets */
+void trace_stream_wait(struct trace_stream *stream, long long ticket)
+{
+        pthread_mutex_lock(&stream->lock);
+        if (!trace_stream_ready(stream, ticket))
+                cond_wait_ns(&stream->loaded, &stream->lock,
+                             TRACE_STREAM_WAIT_NS);
+        pthread_mutex_unlock(&stream->lock);
+}
+
+/* hands the slots of [ticket, ticket + nr) back to the loader */
+void trace_stream_release(struct trace_stream *stream, long long ticket,
+                          int nr)
+{
+        long long mask = stream->ring_size - 1;
+
+        while (nr > 0) {
+                int chunk = (ticket & mask) / TRACE_STREAM_CHUNK;
+                int n = TRACE_STREAM_CHUNK - (ticket % TRACE_STREAM_CHUNK);
+
+                if (n > nr)
+                        n = nr;
+                if (__atomic_add_fetch(&stream->consumed[chunk], n,
+                                       __ATOMIC_RELEASE) ==
+                    TRACE_STREAM_CHUNK) {
+                        pthread_mutex_lock(&stream->lock);
+                        pthread_cond_broadcast(&stream->freed);
+                        pthread_mutex_unlock(&stream->lock);
+                }
+                ticket += n;
+                nr -= n;
+        }
+}
+
+void trace_stream_destroy(struct trace_info_t *trace)
+{
+        struct trace_stream *stream = trace->stream;
+
+        pthread_mutex_lock(&stream->lock);
+        __atomic_store_n(&stream->stop, 1, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&stream->freed);
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(stream->thread, NULL);
+
+        if (stream->spill)
+                trace_stream_close_spill(stream);
+        pthread_mutex_destroy(&stream->lock);
+        pthread_cond_destroy(&stream->loaded);
+        pthread_cond_destroy(&stream->freed);
+        trace_index_destroy(stream->index);
+        free(stream->ring);
+        free(stream->consumed);
+        free(stream);
+        trace->stream = NULL;
+}
@@ -0,0 +1,297 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * io_uring submission/completion engine
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include <trace_replay.h>
+#include <io_pool.h>
+#include <uring_io.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+
+#define URING_SQ_THREAD_IDLE 2000 /* ms */
+/* registered buffers are pinned, so keep all of them below this */
+#define URING_FIXED_BUF_LIMIT (1024LL * 1024 * 1024)
+
+static long long uring_pinned; // bytes registered by all the workers
+static int uring_over_limit;
+
+struct uring_io {
+        struct io_uring ring;
+        int fixed_file;
+        int reaper; // the SQ is entered only by the submitter then
+        unsigned int fixed_bufs; // bit k when class k is registered
+        long long pinned;
+};
+
+/*
+ * Registering faults in and pins the whole arena, so only the classes the
+ * requests of the trace fall into are registered, while they fit below the
+ * limit. The others in between get a page of their arena, so a class
+ * number stays its buffer index, and go without fixed buffers.
+ */
+static void uring_io_register_buffers(struct thread_info_t *t_info,
+                                      struct uring_io *uring)
+{
+        struct iovec iovecs[IO_POOL_MAX_CLASSES];
+        unsigned int classes = t_info->trace->buf_classes;
+        unsigned int fixed = 0;
+        long long pinned = __atomic_load_n(&uring_pinned, __ATOMIC_RELAXED);
+        long long total = 0;
+        int nr, i;
+
+        nr = io_pool_iovecs(t_info->pool, iovecs, IO_POOL_MAX_CLASSES);
+        for (i = 0; i < nr; i++) {
+                if (!(classes & (1u << i)))
+                        continue;
+                if (pinned + total + (long long)iovecs[i].iov_len >
+                    URING_FIXED_BUF_LIMIT) {
+                        if (!__atomic_exchange_n(&uring_over_limit, 1,
+                                                 __ATOMIC_RELAXED))
+                                printf(" io_uring: registered buffers reach %lldMB, the rest go unregistered\n",
+                                       URING_FIXED_BUF_LIMIT >> 20);
+                        continue;
+                }
+                fixed |= 1u << i;
+                total += iovecs[i].iov_len;
+        }
+        if (!fixed)
+                return;
+
+        nr = 32 - __builtin_clz(fixed);
+        total = 0;
+        for (i = 0; i < nr; i++) {
+                if (!(fixed & (1u << i)))
+                        iovecs[i].iov_len = PAGE_SIZE;
+                total += iovecs[i].iov_len;
+        }
+
+        if (io_uring_register_buffers(&uring->ring, iovecs, nr)) {
+                printf(" io_uring: cannot register buffers, fall back to unregistered I/O\n");
+                return;
+        }
+
+        uring->fixed_bufs = fixed;
+        uring->pinned = total;
+        __atomic_add_fetch(&uring_pinned, total, __ATOMIC_RELAXED);
+}
+
+long long uring_io_pinned(void)
+{
+        return __atomic_load_n(&uring_pinned, __ATOMIC_RELAXED);
+}
+
+int uring_io_init(struct thread_info_t *t_info, unsigned int flags)
+{
+        struct io_uring_params params;
+        struct uring_io *uring;
+        int ret;
+
+        uring = calloc(1, sizeof(struct uring_io));
+        if (uring == NULL)
+                return -ENOMEM;
+
+        memset(&params, 0, sizeof(struct io_uring_params));
+        if (flags & URING_SQPOLL) {
+                params.flags |= IORING_SETUP_SQPOLL;
+                params.sq_thread_idle = URING_SQ_THREAD_IDLE;
+        }
+        if (flags & URING_IOPOLL)
+                params.flags |= IORING_SETUP_IOPOLL;
+        uring->reaper = !!(flags & URING_REAPER);
+
+        ret = io_uring_queue_init_params(t_info->queue_depth, &uring->ring,
+                                         &params);
+        if (ret < 0) {
+                fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
+                free(uring);
+                return ret;
+        }
+
+        /* registered fds save the fget/fput pair on every request */
+        uring->fixed_file = !io_uring_register_files(
+                &uring->ring, t_info->fds, t_info->trace->nr_devs);
+
+        /* registered buffers skip the page pinning on every request */
+        uring_io_register_buffers(t_info, uring);
+
+        t_info->uring = uring;
+        return 0;
+}
+
+/* the io_uring_enter() errors after which the SQ can be entered again */
+static int uring_io_retry(int ret)
+{
+        return ret == -EAGAIN || ret == -EBUSY || ret == -EINTR;
+}
+
+/*
+ * Returns the number of jobs which got an SQE, and they are in flight from
+ * then on: the kernel took them or they wait in the SQ for the
+ * io_uring_submit_and_wait() of the next uring_io_reap(), or for a retry
+ * here when another thread reaps. Only a job left without an SQE comes
+ * back unsubmitted, so nothing in the ring points at a job the caller
+ * releases.
+ */
+int uring_io_submit(struct thread_info_t *t_info, struct io_job **jobq,
+                    int cnt)
+{
+        struct uring_io *uring = t_info->uring;
+        struct io_uring_sqe *sqe;
+        int i, ret;
+
+        for (i = 0; i < cnt; i++) {
+                struct io_job *job = jobq[i];
+                int fd = uring->fixed_file ? job->dev : t_info->fds[job->dev];
+
+                sqe = io_uring_get_sqe(&uring->ring);
+                if (sqe == NULL) {
+                        /* SQPOLL thread has not consumed the ring yet */
+                        ret = io_uring_submit(&uring->ring);
+                        if (ret < 0 && !uring_io_retry(ret))
+                                break;
+                        io_uring_sqring_wait(&uring->ring);
+                        sqe = io_uring_get_sqe(&uring->ring);
+                        if (sqe == NULL)
+                                break;
+                }
+
+                if (job->buf_class >= 0 &&
+                    (uring->fixed_bufs & (1u << job->buf_class))) {
+                        if (job->rw)
+                                io_uring_prep_read_fixed(sqe, fd, job->buf,
+                                                         job->bytes,
+                                                         job->offset,
+                                                         job->buf_class);
+                        else
+                                io_uring_prep_write_fixed(sqe, fd, job->buf,
+                                                          job->bytes,
+                                                          job->offset,
+                                                          job->buf_class);
+                } else {
+                        if (job->rw)
+                                io_uring_prep_read(sqe, fd, job->buf,
+                                                   job->bytes, job->offset);
+                        else
+                                io_uring_prep_write(sqe, fd, job->buf,
+                                                    job->bytes, job->offset);
+                }
+
+                if (uring->fixed_file)
+                        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+                io_uring_sqe_set_data(sqe, job);
+        }
+
+        ret = io_uring_submit(&uring->ring);
+        /* the reaper empties the CQ meanwhile, so EBUSY clears as well */
+        while (uring->reaper && ret < 0 && uring_io_retry(ret) &&
+               io_uring_sq_ready(&uring->ring))
+                ret = io_uring_submit(&uring->ring);
+        if (ret < 0 && !uring_io_retry(ret))
+                fprintf(stderr, "io_uring_submit: %s\n", strerror(-ret));
+
+        return i;
+}
+
+int uring_io_reap(struct thread_info_t *t_info, struct io_job **jobq, int min,
+                  int max)
+{
+        struct uring_io *uring = t_info->uring;
+        struct io_uring_cqe *cqe;
+        unsigned int head;
+        int nr = 0;
+        int ret;
+
+        /* SQEs the kernel did not take at the submission go with the wait */
+        if (!uring->reaper && io_uring_sq_ready(&uring->ring))
+                ret = io_uring_submit_and_wait(&uring->ring, min);
+        else
+                ret = io_uring_wait_cqe_nr(&uring->ring, &cqe, min);
+        if (ret < 0 && !uring_io_retry(ret))
+                return ret;
+
+        io_uring_for_each_cqe(&uring->ring, head, cqe)
+        {
+                struct io_job *job =
+                        (struct io_job *)io_uring_cqe_get_data(cqe);
+
+                job->res = cqe->res;
+                jobq[nr++] = job;
+                if (nr == max)
+                        break;
+        }
+        io_uring_cq_advance(&uring->ring, nr);
+
+        return nr;
+}
+
+void uring_io_exit(struct thread_info_t *t_info)
+{
+        struct uring_io *uring = t_info->uring;
+
+        if (uring == NULL)
+                return;
+
+        if (uring->fixed_bufs) {
+                io_uring_unregister_buffers(&uring->ring);
+                __atomic_sub_fetch(&uring_pinned, uring->pinned,
+                                   __ATOMIC_RELAXED);
+        }
+        if (uring->fixed_file)
+                io_uring_unregister_files(&uring->ring);
+
+        io_uring_queue_exit(&uring->ring);
+        free(uring);
+        t_info->uring = NULL;
+}
+
+#else /* !HAVE_LIBURING */
+
+int uring_io_init(struct thread_info_t *t_info, unsigned int flags)
+{
+        fprintf(stderr, "io_uring engine is not available (built without liburing)\n");
+        return -ENOSYS;
+}
+
+int uring_io_submit(struct thread_info_t *t_info, struct io_job **jobq,
+                    int cnt)
+{
+        return -ENOSYS;
+}
+
+int uring_io_reap(struct thread_info_t *t_info, struct io_job **jobq, int min,
+                  int max)
+{
+        return -ENOSYS;
+}
+
+void uring_io_exit(struct thread_info_t *t_info)
+{
+}
+
+long long uring_io_pinned(void)
+{
+        return 0;
+}
+
+#endif
@@ -0,0 +1,249 @@
+/****************************************************************************
+ * Block I/O Trace Replayer
+ * Sector stamps and CRC32C checks of the verify mode
+
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; under version 2 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include <verify.h>
+
+#define VERIFY_STREAMS 4 // sectors summed at once, covers the crc latency
+#define CRC32C_POLY 0x82f63b78 // reflected Castagnoli
+
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static int crc32c_hw;
+
+static void crc32c_init(void)
+{
+        uint32_t crc;
+        int i, j;
+
+        for (i = 0; i < 256; i++) {
+                crc = i;
+                for (j = 0; j < 8; j++)
+                        crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+                crc32c_table[0][i] = crc;
+        }
+        for (i = 0; i < 256; i++) {
+                crc = crc32c_table[0][i];
+                for (j = 1; j < 8; j++) {
+                        crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+                        crc32c_table[j][i] = crc;
+                }
+        }
+#if defined(__x86_64__)
+        crc32c_hw = __builtin_cpu_supports("sse4.2");
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+        crc32c_hw = 1;
+#endif
+}
+
+/* slicing by 8, the crc is not inverted on the way in or out */
+static uint32_t crc32c_sw_raw(uint32_t crc, const unsigned char *p,
+                              size_t len)
+{
+        uint64_t w;
+
+        for (; len >= 8; len -= 8, p += 8) {
+                memcpy(&w, p, 8);
+                w ^= crc;
+                crc = crc32c_table[7][w & 0xff] ^
+                      crc32c_table[6][(w >> 8) & 0xff] ^
+                      crc32c_table[5][(w >> 16) & 0xff] ^
+                      crc32c_table[4][(w >> 24) & 0xff] ^
+                      crc32c_table[3][(w >> 32) & 0xff] ^
+                      crc32c_table[2][(w >> 40) & 0xff] ^
+                      crc32c_table[1][(w >> 48) & 0xff] ^
+                      crc32c_table[0][w >> 56];
+        }
+        while (len--)
+                crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        return crc;
+}
+
+#if defined(__x86_64__)
+#define CRC32C_HW_ATTR __attribute__((target("sse4.2")))
+#define crc32c_u64(crc, w) ((uint32_t)_mm_crc32_u64(crc, w))
+#define crc32c_u8(crc, b) _mm_crc32_u8(crc, b)
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32C_HW_ATTR
+#define crc32c_u64(crc, w) __crc32cd(crc, w)
+#define crc32c_u8(crc, b) __crc32cb(crc, b)
+#endif
+
+#ifdef CRC32C_HW_ATTR
+CRC32C_HW_ATTR static uint32_t crc32c_hw_raw(uint32_t crc,
+                                             const unsigned char *p,
+                                             size_t len)
+{
+        uint64_t w;
+
+        for (; len >= 8; len -= 8, p += 8) {
+                memcpy(&w, p, 8);
+                crc = crc32c_u64(crc, w);
+        }
+        while (len--)
+                crc = crc32c_u8(crc, *p++);
+        return crc;
+}
+
+/*
+ * The crc instruction has a latency of about three cycles and issues every
+ * cycle, so the sectors are summed VERIFY_STREAMS at a time.
+ */
+CRC32C_HW_ATTR static void crc32c_hw_sectors(const char *buf, int nr,
+                                             uint32_t *crc)
+{
+        uint32_t c[VERIFY_STREAMS];
+        uint64_t w;
+        size_t off;
+        int i, s;
+
+        for (i = 0; i + VERIFY_STREAMS <= nr; i += VERIFY_STREAMS) {
+                const char *p = buf + (size_t)i * VERIFY_SECTOR;
+
+                for (s = 0; s < VERIFY_STREAMS; s++)
+                        c[s] = ~0U;
+                for (off = 0; off + 8 <= VERIFY_CRC_LEN; off += 8) {
+                        for (s = 0; s < VERIFY_STREAMS; s++) {
+                                memcpy(&w, p + s * VERIFY_SECTOR + off, 8);
+                                c[s] = crc32c_u64(c[s], w);
+                        }
+                }
+                for (s = 0; s < VERIFY_STREAMS; s++)
+                        crc[i + s] = ~crc32c_hw_raw(c[s],
+                                                    (const unsigned char *)p +
+                                                            s * VERIFY_SECTOR +
+                                                            off,
+                                                    VERIFY_CRC_LEN - off);
+        }
+        for (; i < nr; i++)
+                crc[i] = ~crc32c_hw_raw(~0U,
+                                        (const unsigned char *)buf +
+                                                (size_t)i * VERIFY_SECTOR,
+                                        VERIFY_CRC_LEN);
+}
+#endif
+
+/* zlib style, start with 0 and chain the results */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+        pthread_once(&crc32c_once, crc32c_init);
+#ifdef CRC32C_HW_ATTR
+        if (crc32c_hw)
+                return ~crc32c_hw_raw(~crc, buf, len);
+#endif
+        return ~crc32c_sw_raw(~crc, buf, len);
+}
+
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len)
+{
+        pthread_once(&crc32c_once, crc32c_init);
+        return ~crc32c_sw_raw(~crc, buf, len);
+}
+
+/* the crc of every sector, up to the crc field */
+static void crc32c_sectors(const char *buf, int nr, uint32_t *crc)
+{
+        int i;
+
+        pthread_once(&crc32c_once, crc32c_init);
+#ifdef CRC32C_HW_ATTR
+        if (crc32c_hw) {
+                crc32c_hw_sectors(buf, nr, crc);
+                return;
+        }
+#endif
+        for (i = 0; i < nr; i++)
+                crc[i] = ~crc32c_sw_raw(~0U,
+                                        (const unsigned char *)buf +
+                                                (size_t)i * VERIFY_SECTOR,
+                                        VERIFY_CRC_LEN);
+}
+
+/* offset is where buf goes on the device, in bytes */
+void verify_stamp(char *buf, size_t bytes, long long offset,
+                  uint32_t generation, uint32_t seed)
+{
+        uint32_t crc[VERIFY_STREAMS * 16];
+        int nr = (int)(bytes / VERIFY_SECTOR);
+        int i, j, n, batch;
+
+        for (i = 0; i < nr; i++) {
+                struct verify_tail *tail =
+                        verify_tail(buf + (size_t)i * VERIFY_SECTOR);
+
+                tail->lba = (uint64_t)(offset / VERIFY_SECTOR + i);
+                tail->generation = generation;
+                tail->seed = seed;
+                tail->magic = VERIFY_MAGIC;
+        }
+
+        batch = (int)(sizeof(crc) / sizeof(crc[0]));
+        for (i = 0; i < nr; i += n) {
+                n = nr - i < batch ? nr - i : batch;
+                crc32c_sectors(buf + (size_t)i * VERIFY_SECTOR, n, crc);
+                for (j = 0; j < n; j++)
+                        verify_tail(buf + (size_t)(i + j) * VERIFY_SECTOR)
+                                ->crc = crc[j];
+        }
+}
+
+/*
+ * Returns the number of bad sectors: a stamped sector whose crc does not
+ * match, or which was written to another sector. bad_offset is the device
+ * offset of the first one, nr_checked the stamped sectors.
+ */
+int verify_check(const char *buf, size_t bytes, long long offset,
+                 int *nr_checked, long long *bad_offset)
+{
+        uint32_t crc[VERIFY_STREAMS * 16];
+        int nr = (int)(bytes / VERIFY_SECTOR);
+        int nr_bad = 0;
+        int i, j, n, batch;
+
+        *nr_checked = 0;
+        *bad_offset = -1;
+        batch = (int)(sizeof(crc) / sizeof(crc[0]));
+        for (i = 0; i < nr; i += n) {
+                n = nr - i < batch ? nr - i : batch;
+                crc32c_sectors(buf + (size_t)i * VERIFY_SECTOR, n, crc);
+                for (j = 0; j < n; j++) {
+                        const char *sector =
+                                buf + (size_t)(i + j) * VERIFY_SECTOR;
+                        struct verify_tail *tail = verify_tail(sector);
+
+                        if (tail->magic != VERIFY_MAGIC)
+                                continue;
+                        (*nr_checked)++;
+                        if (tail->crc == crc[j] &&
+                            tail->lba == (uint64_t)(offset / VERIFY_SECTOR +
+                                                    i + j))
+                                continue;
+                        if (!nr_bad++)
+                                *bad_offset = offset + (long long)(i + j) *
+                                                               VERIFY_SECTOR;
+                }
+        }
+
+        return nr_bad;
+}